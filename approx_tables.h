@@ -0,0 +1,151 @@
+// generated by scripts/approx_tables.py -- do not edit
+
+#ifndef _LSEA_APPROX_TABLES
+#define _LSEA_APPROX_TABLES 1
+
+#define APPROX_TABLE_BITS 8
+
+// 2^f ~ sum_k APPROX_EXP2_Pk f^k on [0, 1). max relative error 2.9e-06
+#define APPROX_EXP2_P0 (1)
+#define APPROX_EXP2_P1 (0.69304400828831725)
+#define APPROX_EXP2_P2 (0.2412826881000264)
+#define APPROX_EXP2_P3 (0.052240896924384474)
+#define APPROX_EXP2_P4 (0.013426551134972967)
+
+// exp: 2^m ~ APPROX_EXP_TABLE[j] * (1 + m) for m in [j, j + 1) / 2^APPROX_TABLE_BITS
+static const double APPROX_EXP_TABLE[256] = {
+    0.99940448294960071, 0.99822242774774472, 0.99705680785872353, 0.99590745296689742,
+    0.99477419542502088, 0.99365687020336457, 0.99255531484000203, 0.99146936939222741,
+    0.99039887638907709, 0.98934368078492163, 0.98830362991410758, 0.98727857344661363,
+    0.98626836334469814, 0.98527285382051344, 0.98429190129466126, 0.98332536435566265,
+    0.98237310372032161, 0.98143498219495851, 0.9805108646374916, 0.9796006179203437,
+    0.97870411089415665, 0.97782121435228719, 0.97695180099606982, 0.97609574540082822,
+    0.9752529239826081, 0.97442321496562623, 0.97360649835040669, 0.97280265588259274,
+    0.97201157102241853, 0.97123312891482061, 0.97046721636017741, 0.96971372178565785,
+    0.96897253521716908, 0.96824354825188308, 0.96752665403133253, 0.96682174721506053,
+    0.96612872395481186, 0.96544748186925167, 0.96477792001919793, 0.96411993888336101,
+    0.96347344033457138, 0.9628383276164878, 0.96221450532077524, 0.96160187936473929,
+    0.96100035696940678, 0.96040984663804563, 0.95983025813510814, 0.95926150246559305,
+    0.95870349185481285, 0.95815613972856184, 0.95761936069366782, 0.95709307051892922,
+    0.95657718611641962, 0.95607162552315639, 0.95557630788312342, 0.9550911534296409,
+    0.95461608346807403, 0.95415102035887356, 0.95369588750093803, 0.95325060931529559,
+    0.9528151112290939, 0.95238931965989371, 0.95197316200025739, 0.95156656660262906,
+    0.95116946276449743, 0.95078178071383468, 0.95040345159480877, 0.95003440745375978,
+    0.94967458122543558, 0.94932390671948352, 0.94898231860718807, 0.94864975240845339,
+    0.94832614447902508, 0.94801143199794158, 0.94770555295521741, 0.94740844613974817,
+    0.94712005112743303, 0.9468403082695136, 0.94656915868112024, 0.94630654423002547,
+    0.94605240752559605, 0.94580669190794431, 0.94556934143726989, 0.94534030088339216,
+    0.94511951571546615, 0.94490693209187937, 0.94470249685032759, 0.94450615749806255,
+    0.94431786220231106, 0.94413755978085989, 0.94396519969280535, 0.94380073202946169,
+    0.94364410750542671, 0.94349527744980222, 0.94335419379756369, 0.94322080908107797,
+    0.94309507642176571, 0.94297694952190725, 0.94286638265658507, 0.94276333066576368,
+    0.94266774894650374, 0.94257959344530717, 0.94249882065058865, 0.94242538758527694,
+    0.94235925179953595, 0.94230037136360856, 0.94224870486078149, 0.94220421138046129,
+    0.94216685051137039, 0.9421365823348512, 0.942113367418282, 0.94209716680860134,
+    0.94208794202593582, 0.94208546699914553, 0.94209026835060139, 0.94210174480823439,
+    0.94212004778145464, 0.94214514106433689, 0.94217698888803358, 0.94221555591508988,
+    0.94226080723385208, 0.94231270835296366, 0.94237122519594907, 0.94243632409588352,
+    0.94250797179014834, 0.94258613541526781, 0.94267078250182801, 0.94276188096947522,
+    0.94285939912199257, 0.94296330564245467, 0.94307356958845656, 0.94319016038741865,
+    0.9433130478319619, 0.94344220207535656, 0.9435775936270413, 0.94371919334821064,
+    0.94386697244747009, 0.94402090247655857, 0.94418095532613522, 0.94434710322163262,
+    0.94451931871917005, 0.94469757470153148, 0.94488184437420319, 0.94507210126147123,
+    0.94526831920257826, 0.94547047234793891, 0.94567853515540856, 0.94589248238661328,
+    0.94611228910332967, 0.9463379306639208, 0.94656938271982627, 0.94680662121210146,
+    0.94704962236801093, 0.94729836269766921, 0.94755281899073418, 0.94781296831314643,
+    0.94807878800391743, 0.94835025567196496, 0.94862734919299441, 0.94891004670642509,
+    0.94919832661236192, 0.94949216756861121, 0.94979154848773806, 0.95009644853416697,
+    0.95040684712132661, 0.95072272390883084, 0.95104405879970433, 0.95137083193764582,
+    0.95170302370433035, 0.95204061471675172, 0.95238358582460048, 0.95273191810767976,
+    0.95308559287335892, 0.95344459165406092, 0.95380889620478759, 0.95417848850067777,
+    0.95455335073460035, 0.95493346531478085, 0.95531881486246195, 0.955709382209595,
+    0.95610515039656552, 0.95650610266994818, 0.95691222248029595, 0.95732349347995582,
+    0.95773989952091754, 0.95816142465269172, 0.958588053120216, 0.95901976936178979,
+    0.95945655800703955, 0.95989840387490832, 0.96034529197167584, 0.96079720748900377,
+    0.96125413580200803, 0.96171606246735686, 0.96218297322139523, 0.96265485397829464,
+    0.96313169082822614, 0.96361347003556008, 0.96410017803708936, 0.96459180144027523,
+    0.96508832702151792, 0.96558974172444967, 0.96609603265825217, 0.96660718709599158,
+    0.96712319247298251, 0.96764403638516805, 0.96816970658752322, 0.96870019099247995,
+    0.96923547766837215, 0.96977555483790123, 0.97032041087662191, 0.97087003431144747,
+    0.97142441381917577, 0.97198353822503147, 0.97254739650123168, 0.97311597776556624,
+    0.97368927127999871, 0.97426726644928452, 0.97484995281960696, 0.97543732007723172,
+    0.97602935804717739, 0.97662605669190417, 0.97722740611001835, 0.97783339653499513,
+    0.97844401833391437, 0.97905926200621818, 0.97967911818247722, 0.98030357762317888,
+    0.98093263121752794, 0.98156626998226082, 0.98220448506047997, 0.98284726772049757,
+    0.98349460935469701, 0.98414650147840776, 0.98480293572879407, 0.98546390386375859,
+    0.98612939776085851, 0.9867994094162359, 0.98747393094356239, 0.98815295457299512,
+    0.98883647265014618, 0.98952447763506624, 0.99021696210123977, 0.99091391873459234,
+    0.99161534033251064, 0.9923212198028748, 0.99303155016310263, 0.99374632453920575,
+    0.99446553616485611, 0.99518917838046561, 0.99591724463227682, 0.99664972847146271,
+    0.99738662355324181, 0.99812792363599756, 0.99887362258041656, 0.99962371434863018,
+};
+
+// log: log(1 + m) ~ m * ln2 + APPROX_LOG_TABLE[j] for m in [j, j + 1) / 2^APPROX_TABLE_BITS
+static const double APPROX_LOG_TABLE[256] = {
+    0.00059551712079751831, 0.0017789811677627065, 0.0029473633958593962, 0.0041007802687522627,
+    0.0052393469062678062, 0.0063631771049900828, 0.0074723833584633675, 0.0085670768770107347,
+    0.0096473676071772776, 0.010713364250806448, 0.011765174283757823, 0.012802903974274337,
+    0.013826658401006841, 0.014836541470703596, 0.015832655935572204, 0.016815103410321195,
+    0.017783984388888324, 0.018739398260862492, 0.019681443327605987, 0.020610216818083591,
+    0.021525814904404906, 0.022428332717086146, 0.023317864360037428, 0.024194502925281421,
+    0.025058340507409196, 0.025909468217778897, 0.026747976198462545, 0.027573953635946481,
+    0.028387488774590644, 0.029188668929851634, 0.029977580501274637, 0.030754308985259021,
+    0.031518938987602267, 0.032271554235826873, 0.033012237591294763, 0.033741071061113487,
+    0.034458135809838593, 0.035163512170976241, 0.035857279658290227, 0.036539516976917319,
+    0.037210302034294922, 0.037869711950904675, 0.038517823070835795, 0.039154710972171811,
+    0.039780450477204167, 0.04039511566247618, 0.040998779868660601, 0.041591515710274349,
+    0.042173395085233309, 0.042744489184250542, 0.043304868500081029, 0.043854602836615603,
+    0.044393761317827463, 0.044922412396573908, 0.045440623863255966, 0.045948462854338887,
+    0.046445995860736125, 0.046933288736059342, 0.047410406704736993, 0.04787741437000409,
+    0.048334375721765563, 0.048781354144335626, 0.049218412424055336, 0.049645612756790761,
+    0.050063016755314105, 0.050470685456569853, 0.050868679328827909, 0.051257058278726161,
+    0.051635881658204347, 0.052005208271331191, 0.052365096381026863, 0.05271560371568261,
+    0.053056787475679573, 0.053388704339808399, 0.053711410471591614, 0.054024961525510617,
+    0.054329412653138787, 0.054624818509182452, 0.054911233257431469, 0.055188710576621086,
+    0.055457303666206451, 0.055717065252051445, 0.055968047592033415, 0.056210302481565277,
+    0.05644388125903628, 0.056668834811173019, 0.056885213578322297, 0.057093067559656624,
+    0.057292446318304255, 0.057483398986404921, 0.057665974270092346, 0.057840220454405095,
+    0.058006185408126798, 0.058163916588557019, 0.058313461046214071, 0.058454865429470648,
+    0.058588175989123831, 0.058713438582900235, 0.058830698679897458, 0.058940001364963163,
+    0.059041391343012506, 0.059134912943285156, 0.059220610123542794, 0.059298526474208191,
+    0.059368705222446916, 0.059431189236192311, 0.059486021028114927, 0.059533242759537447,
+    0.059572896244295542, 0.059605022952546077, 0.059629664014523187, 0.059646860224243231,
+    0.059656652043159397, 0.059659279222633949, 0.059654182713158366, 0.059642000856534289,
+    0.059622573200662221, 0.059595938597292647, 0.059562135586527981, 0.059521202400146994,
+    0.059473176964884661, 0.05941809690566896, 0.059355999548814486, 0.059286921925174069,
+    0.059210900773249087, 0.059127972542258683, 0.059038173395168925, 0.058941539211682464,
+    0.058838105591189266, 0.058727907855678968, 0.058610981052615474, 0.058487359957774515,
+    0.058357079078044494, 0.058220172654191521, 0.058076674663588956, 0.057926618822911863,
+    0.057770038590797324, 0.057606967170470674, 0.057437437512338679, 0.057261482316549789,
+    0.057079134035521811, 0.056890424876438112, 0.056695386803712333, 0.056494051541422174,
+    0.056286450575712743, 0.056072615157169992, 0.055852576303164619, 0.055626364800166861,
+    0.055394011206032656, 0.055155545852261623, 0.054910998846227244, 0.054660400073379495,
+    0.054403779199420577, 0.054141165672454167, 0.053872588725108334, 0.053598077376632525,
+    0.053317660434969327, 0.053031366498801025, 0.05273922395957148, 0.052441261003483619,
+    0.052137505613472912, 0.05182798557115717, 0.051512728458763035, 0.051191761661029594,
+    0.050865112367089155, 0.050532807572325755, 0.050194874080211727, 0.049851338504122433,
+    0.049502227269129562, 0.049147566613773591, 0.048787382591815198, 0.048421701073966095,
+    0.048050547749599992, 0.047673948128443389, 0.047291927542246537, 0.046904511146435346,
+    0.046511723921744103, 0.046113590675829097, 0.045710136044863903, 0.045301384495116337,
+    0.044887360324507075, 0.044468087664150668, 0.044043590479878991, 0.043613892573747093,
+    0.043179017585522117, 0.042738988994155458, 0.042293830119237985, 0.041843564122439003,
+    0.041388214008929058, 0.04092780262878648, 0.040462352678388491, 0.039991886701786716,
+    0.039516427092067152, 0.039035996092695036, 0.038550615798844778, 0.038060308158715306,
+    0.037565094974830848, 0.037064997905326968, 0.036560038465222877, 0.036050238027679649,
+    0.035535617825244503, 0.035016198951081656, 0.034492002360189566, 0.033963048870605195,
+    0.033429359164594663, 0.032890953789831423, 0.032347853160561879, 0.0318000775587578,
+    0.031247647135256629, 0.030690581910889636, 0.030128901777597861, 0.029562626499536004,
+    0.028991775714164725, 0.028416368933331215, 0.027836425544338128, 0.027251964811001395,
+    0.026663005874696721, 0.026069567755394984, 0.025471669352686854, 0.024869329446796373,
+    0.024262566699584098, 0.023651399655539751, 0.023035846742764432, 0.022415926273942455,
+    0.021791656447303132, 0.021163055347572735, 0.020530140946916187, 0.019892931105869538,
+    0.019251443574262506, 0.018605695992131244, 0.017955705890622287, 0.017301490692886723,
+    0.016643067714965543, 0.015980454166665881, 0.015313667152427879, 0.0146427236721835,
+    0.013967640622205957, 0.013288434795950821, 0.012605122884888631, 0.011917721479328847,
+    0.011226247069235806, 0.010530716045036248, 0.0098311446984188922, 0.0091275492231259747,
+    0.0084199457157367874, 0.0077083501764432238, 0.0069927785098181094, 0.0062732465255755376,
+    0.0055497699393236011, 0.0048223643733098509, 0.0040910453571592065, 0.0033558283286050372,
+    0.0026167286342125839, 0.0018737615300951083, 0.0011269421826236581, 0.00037628566912950578,
+};
+
+#endif
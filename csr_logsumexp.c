@@ -0,0 +1,232 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fast_approx.h"
+#include "simd_approx.h"
+#include "csr_logsumexp.h"
+#include "lse_instrument.h"
+
+
+// slices at most this wide keep their terms in registers/stack between the
+// max pass and the exp pass; wider slices gather twice.
+#define CSR_MAX_BUFFERED 32
+
+
+int make_csr_slices(const csr_matrix_t *a, csr_slices_t *s) {
+    // returns 0 on success, 1 if a is malformed, 2 on allocation failure.
+    int i, j, k, l, r, w, p, max_nnz, n_slices, n_lanes, total, count;
+    int *counts, *order;
+
+    memset(s, 0, sizeof(csr_slices_t));
+
+    if (a->n_rows < 0 || a->row_start[0] != 0) {
+        return 1;
+    }
+    max_nnz = 0;
+    for (i = 0; i < a->n_rows; ++i) {
+        w = a->row_start[i + 1] - a->row_start[i];
+        if (w < 0) {
+            return 1;
+        }
+        if (w > max_nnz) {
+            max_nnz = w;
+        }
+    }
+    for (p = 0; p < a->row_start[a->n_rows]; ++p) {
+        if (a->col[p] < 0 || a->col[p] >= a->n_cols) {
+            return 1;
+        }
+    }
+
+    counts = malloc((max_nnz + 1) * sizeof(int));
+    order = malloc(a->n_rows * sizeof(int) + 1);
+    if (counts == NULL || order == NULL) {
+        free(counts);
+        free(order);
+        return 2;
+    }
+
+    // counting sort of rows by nnz
+    memset(counts, 0, (max_nnz + 1) * sizeof(int));
+    for (i = 0; i < a->n_rows; ++i) {
+        counts[a->row_start[i + 1] - a->row_start[i]] += 1;
+    }
+    // each nnz bucket starts a fresh slice, so a slice never mixes widths
+    n_slices = 0;
+    n_lanes = 0;
+    for (w = 0; w <= max_nnz; ++w) {
+        k = (counts[w] + CSR_SLICE_HEIGHT - 1) / CSR_SLICE_HEIGHT;
+        n_slices += k;
+        n_lanes += k * w;
+    }
+    total = 0;
+    for (w = 0; w <= max_nnz; ++w) {
+        count = counts[w];
+        counts[w] = total;
+        total += count;
+    }
+    for (i = 0; i < a->n_rows; ++i) {
+        order[counts[a->row_start[i + 1] - a->row_start[i]]++] = i;
+    }
+    free(counts);
+
+    s->slice_start = malloc((n_slices + 1) * sizeof(int));
+    s->row = malloc(n_slices * CSR_SLICE_HEIGHT * sizeof(int) + 1);
+    s->col = malloc(n_lanes * CSR_SLICE_HEIGHT * sizeof(int) + 1);
+    s->val = malloc(n_lanes * CSR_SLICE_HEIGHT * sizeof(double) + 1);
+    if (s->slice_start == NULL || s->row == NULL || s->col == NULL || s->val == NULL) {
+        free(order);
+        release_csr_slices(s);
+        return 2;
+    }
+    s->n_rows = a->n_rows;
+    s->n_slices = n_slices;
+
+    i = 0;
+    p = 0;
+    for (k = 0; k < n_slices; ++k) {
+        // take up to CSR_SLICE_HEIGHT rows of the same width
+        w = a->row_start[order[i] + 1] - a->row_start[order[i]];
+        s->slice_start[k] = p;
+        for (l = 0; l < CSR_SLICE_HEIGHT; ++l) {
+            if (i < a->n_rows && a->row_start[order[i] + 1] - a->row_start[order[i]] == w) {
+                s->row[k * CSR_SLICE_HEIGHT + l] = order[i];
+                ++i;
+            } else {
+                s->row[k * CSR_SLICE_HEIGHT + l] = -1;
+            }
+        }
+        for (j = 0; j < w; ++j) {
+            for (l = 0; l < CSR_SLICE_HEIGHT; ++l) {
+                r = s->row[k * CSR_SLICE_HEIGHT + l];
+                if (r >= 0) {
+                    s->col[p] = a->col[a->row_start[r] + j];
+                    s->val[p] = (a->val != NULL) ? a->val[a->row_start[r] + j] : 0.0;
+                } else {
+                    // padding lane: any valid column, contributes exp(-inf) = 0
+                    s->col[p] = 0;
+                    s->val[p] = -INFINITY;
+                }
+                ++p;
+            }
+        }
+    }
+    s->slice_start[n_slices] = p;
+
+    free(order);
+    return 0;
+}
+
+
+void release_csr_slices(csr_slices_t *s) {
+    free(s->slice_start);
+    free(s->row);
+    free(s->col);
+    free(s->val);
+    memset(s, 0, sizeof(csr_slices_t));
+}
+
+
+static inline double csr_row_log_sum_exp(const int *col, const double *val, int n, int stride, const double *x) {
+    // preconditions:
+    // -inf <= val[j] + x[col[j]] <= 0.0 for all j
+    double a_max, acc, t;
+    int j;
+    a_max = -INFINITY;
+    for (j = 0; j < n; ++j) {
+        t = ((val != NULL) ? val[j * stride] : 0.0) + x[col[j * stride]];
+        a_max = fmax(t, a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        return a_max;
+    }
+    acc = 0.0;
+    for (j = 0; j < n; ++j) {
+        t = ((val != NULL) ? val[j * stride] : 0.0) + x[col[j * stride]];
+        acc += fast_exp(t - a_max);
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+void csr_log_sum_exp_rows(const csr_matrix_t *a, const double *x, double *out) {
+    int i, p0;
+    LSE_INSTRUMENT_START(t0);
+    for (i = 0; i < a->n_rows; ++i) {
+        p0 = a->row_start[i];
+        out[i] = csr_row_log_sum_exp(a->col + p0, (a->val != NULL) ? a->val + p0 : NULL,
+            a->row_start[i + 1] - p0, 1, x);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_CSR_ROWS, t0);
+}
+
+
+#ifdef LSEA_HAVE_SIMD
+
+static inline __m256d csr_slice_log_sum_exp(const int *col, const double *val, int w, const double *x) {
+    // one lane per row. all rows in the slice have w terms.
+    __m256d buf[CSR_MAX_BUFFERED];
+    __m256d t, a_max, shift, acc, is_ninf;
+    int j;
+
+    a_max = _mm256_set1_pd(-INFINITY);
+    for (j = 0; j < w; ++j) {
+        t = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i *)(col + j * CSR_SLICE_HEIGHT)), 8);
+        t = _mm256_add_pd(t, _mm256_loadu_pd(val + j * CSR_SLICE_HEIGHT));
+        a_max = _mm256_max_pd(a_max, t);
+        if (j < CSR_MAX_BUFFERED) {
+            buf[j] = t;
+        }
+    }
+    if (w <= 1) {
+        return a_max;
+    }
+    // lanes whose terms are all -inf: shift by 0 so exp gives 0, not nan
+    is_ninf = _mm256_cmp_pd(a_max, _mm256_set1_pd(-INFINITY), _CMP_EQ_OQ);
+    shift = _mm256_andnot_pd(is_ninf, a_max);
+
+    acc = _mm256_setzero_pd();
+    for (j = 0; j < w; ++j) {
+        if (j < CSR_MAX_BUFFERED) {
+            t = buf[j];
+        } else {
+            t = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i *)(col + j * CSR_SLICE_HEIGHT)), 8);
+            t = _mm256_add_pd(t, _mm256_loadu_pd(val + j * CSR_SLICE_HEIGHT));
+        }
+        acc = _mm256_add_pd(acc, fast_exp_pd(_mm256_sub_pd(t, shift)));
+    }
+    return _mm256_add_pd(fast_log_pd(acc), shift);
+}
+
+#endif
+
+
+void csr_log_sum_exp_slices(const csr_slices_t *s, const double *x, double *out) {
+    int k, l, w, p0, i;
+#ifdef LSEA_HAVE_SIMD
+    double r[CSR_SLICE_HEIGHT];
+#endif
+    LSE_INSTRUMENT_START(t0);
+    for (k = 0; k < s->n_slices; ++k) {
+        p0 = s->slice_start[k];
+        w = (s->slice_start[k + 1] - p0) / CSR_SLICE_HEIGHT;
+#ifdef LSEA_HAVE_SIMD
+        _mm256_storeu_pd(r, csr_slice_log_sum_exp(s->col + p0, s->val + p0, w, x));
+        for (l = 0; l < CSR_SLICE_HEIGHT; ++l) {
+            i = s->row[k * CSR_SLICE_HEIGHT + l];
+            if (i >= 0) {
+                out[i] = r[l];
+            }
+        }
+#else
+        for (l = 0; l < CSR_SLICE_HEIGHT; ++l) {
+            i = s->row[k * CSR_SLICE_HEIGHT + l];
+            if (i >= 0) {
+                out[i] = csr_row_log_sum_exp(s->col + p0 + l, s->val + p0 + l, w, CSR_SLICE_HEIGHT, x);
+            }
+        }
+#endif
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_CSR_SLICES, t0);
+}
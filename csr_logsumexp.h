@@ -0,0 +1,48 @@
+#ifndef _LSEA_CSR_LOGSUMEXP
+#define _LSEA_CSR_LOGSUMEXP 1
+
+// log-sum-exp over arbitrary index sets: a sparse matrix-vector product in
+// the log semiring,
+//
+//     out[i] = logsumexp_j(val[j] + x[col[j]])  for j in row i
+//
+// with the same fast_exp / fast_log approximations as the range kernels.
+
+
+// compressed sparse row input. val may be NULL, meaning all weights are 0.
+typedef struct {
+    int n_rows;
+    int n_cols;
+    const int *row_start;   // n_rows + 1 entries
+    const int *col;         // row_start[n_rows] entries
+    const double *val;      // row_start[n_rows] entries, or NULL
+} csr_matrix_t;
+
+
+#define CSR_SLICE_HEIGHT 4
+
+
+// sliced ell layout prepared from a csr matrix. rows are sorted by number
+// of nonzeros (the analogue of sorting ranges by width) and packed
+// CSR_SLICE_HEIGHT at a time, so element j of each row in a slice sits
+// in adjacent lanes. short rows are padded with weight -inf.
+typedef struct {
+    int n_rows;
+    int n_slices;
+    int *slice_start;   // slice s holds lanes [slice_start[s], slice_start[s+1]) of col and val
+    int *row;           // CSR_SLICE_HEIGHT entries per slice: original row, -1 for padding
+    int *col;
+    double *val;
+} csr_slices_t;
+
+
+int make_csr_slices(const csr_matrix_t *a, csr_slices_t *s);
+void release_csr_slices(csr_slices_t *s);
+
+// reference: one row at a time straight from the csr arrays
+void csr_log_sum_exp_rows(const csr_matrix_t *a, const double *x, double *out);
+
+// bucketed and, where available, AVX2 gather based
+void csr_log_sum_exp_slices(const csr_slices_t *s, const double *x, double *out);
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef _LSEA_FAST_APPROX
+#define _LSEA_FAST_APPROX 1
+
+#include <math.h>
+
+#include "approx_tables.h"
+
+// ref: Curioni -- Fast Exponential Computation on SIMD Architectures
+// ref: Schraudolph -- A Fast, Compact Approximation of the Exponential Function
+
+#define APPROX_LN2 (0.6931471805599453)
+// APPROX_S0 can be set to 0 if loading into a 32 bit int,
+// as per Schraudolph, or 32 if loading into a 64 bit int.
+#define APPROX_S0 (32l)
+#define APPROX_S (1l << (20l + APPROX_S0))
+#define APPROX_A (APPROX_S / APPROX_LN2)
+#define APPROX_B (APPROX_S * 1023l)
+#define APPROX_C (60801l * (1l << APPROX_S0))
+#define APPROX_A_INV (1.0 / APPROX_A)
+
+#define FAST_EXP_MIN_ARG -706.0
+
+#define APPROX_MANTISSA_BITS 52
+#define APPROX_TABLE_MASK ((1l << APPROX_TABLE_BITS) - 1)
+#define APPROX_LOG2E (1.4426950408889634)
+#define APPROX_SQRT2 (1.4142135623730951)
+
+
+// accuracy tiers. each buys accuracy for a few more instructions:
+//
+//  tier    fast_exp rel. error    fast_log abs. error    extra cost
+//  raw     ~4e-2                  ~4e-2                  -
+//  table   ~6e-4                  ~6e-4                  one table load
+//  poly    ~3e-6                  ~3e-8                  4 fma (exp), a divide + 4 fma (log)
+//
+// the tables are small (2 x 2kB) and stay cache resident.
+#define APPROX_TIER_RAW 0
+#define APPROX_TIER_TABLE 1
+#define APPROX_TIER_POLY 2
+
+// compile time choice of tier for fast_exp and fast_log, and so for every
+// kernel built on them, e.g. -DAPPROX_TIER=APPROX_TIER_POLY. the tiered
+// functions below can also be called directly, or chosen at run time.
+#ifndef APPROX_TIER
+#define APPROX_TIER APPROX_TIER_RAW
+#endif
+
+
+static inline double reinterpret_long_as_double(long int x) {
+    // type pun: reinterpret the bits of x as a 64 bit float.
+    // this is expected to compile to a no-op.
+    // with C++ we'd use "reinterpret cast".
+    union {
+        long int i;
+        double d;
+    } b;
+    b.i = x;
+    return b.d;
+}
+
+
+static inline long int reinterpret_double_as_long(double x) {
+    // type pun: reinterpret the bits of x as a 64 bit int.
+    // this is expected to compile to a no-op.
+    // with C++ we'd use "reinterpret cast".
+    union {
+        long int i;
+        double d;
+    } b;
+    b.d = x;
+    return b.i;
+}
+
+
+static inline double fast_exp_raw(double x) {
+    double z;
+    z = reinterpret_long_as_double((long int)(fma(APPROX_A, x, + (APPROX_B - APPROX_C))));
+    // above approximation gives bad results where x < -706.0
+    return (x >= FAST_EXP_MIN_ARG) ? z : 0.0;
+}
+
+
+static inline double fast_exp_table(double x) {
+    // untuned schraudolph (no APPROX_C) reads mantissa m as 2^m ~ 1 + m.
+    // correct by a factor looked up on the top mantissa bits.
+    long int i;
+    double z;
+    i = (long int)(fma(APPROX_A, x, + APPROX_B));
+    z = reinterpret_long_as_double(i) *
+        APPROX_EXP_TABLE[(i >> (APPROX_MANTISSA_BITS - APPROX_TABLE_BITS)) & APPROX_TABLE_MASK];
+    return (x >= FAST_EXP_MIN_ARG) ? z : 0.0;
+}
+
+
+static inline double fast_exp_poly(double x) {
+    // exp(x) = 2^n * 2^f with n = floor(x / ln2), f in [0, 1).
+    // 2^f by polynomial, 2^n by writing n straight into the exponent bits.
+    double t, n, f, p, z;
+    t = fmax(x, FAST_EXP_MIN_ARG) * APPROX_LOG2E;
+    n = floor(t);
+    f = t - n;
+    p = fma(fma(fma(fma(APPROX_EXP2_P4, f, APPROX_EXP2_P3), f, APPROX_EXP2_P2), f, APPROX_EXP2_P1), f, APPROX_EXP2_P0);
+    z = p * reinterpret_long_as_double((long int)(n + 1023.0) << APPROX_MANTISSA_BITS);
+    return (x >= FAST_EXP_MIN_ARG) ? z : 0.0;
+}
+
+
+static inline double fast_log_raw(double x) {
+    // precondition: x >= 0.0
+    //
+    // naively invert fast_exp
+    // y = (a * x) + b
+    // x = (y - b) / a
+    // x = (1/a) * y + (1/a) * (-b)  // distribute multiply for fma
+    double z;
+    z = (double)reinterpret_double_as_long(x);
+    z = fma(APPROX_A_INV, z, APPROX_A_INV * (- APPROX_B + APPROX_C));
+    return (x > 0.0) ? z : -INFINITY;
+}
+
+
+static inline double fast_log_table(double x) {
+    // precondition: x >= 0.0
+    //
+    // untuned inverse reads x = 2^e (1 + m) as (e + m) ln2. add a
+    // correction looked up on the top mantissa bits.
+    long int i;
+    double z;
+    i = reinterpret_double_as_long(x);
+    z = fma(APPROX_A_INV, (double)i, - APPROX_A_INV * APPROX_B);
+    z += APPROX_LOG_TABLE[(i >> (APPROX_MANTISSA_BITS - APPROX_TABLE_BITS)) & APPROX_TABLE_MASK];
+    return (x > 0.0) ? z : -INFINITY;
+}
+
+
+static inline double fast_log_poly(double x) {
+    // precondition: x >= 0.0
+    //
+    // x = 2^e y with y in [sqrt(1/2), sqrt(2)), then
+    // log(y) = 2 atanh(s) = 2 (s + s^3/3 + s^5/5 + s^7/7 + ...), s = (y-1)/(y+1).
+    // |s| < 0.172, so the first four terms suffice.
+    long int i, e;
+    double y, s, s2, p, z;
+    i = reinterpret_double_as_long(x);
+    e = (i >> APPROX_MANTISSA_BITS) - 1023l;
+    y = reinterpret_long_as_double((i & ((1l << APPROX_MANTISSA_BITS) - 1)) | (1023l << APPROX_MANTISSA_BITS));
+    e += (y > APPROX_SQRT2) ? 1 : 0;
+    y = (y > APPROX_SQRT2) ? y * 0.5 : y;
+    s = (y - 1.0) / (y + 1.0);
+    s2 = s * s;
+    p = fma(fma(fma(2.0 / 7.0, s2, 2.0 / 5.0), s2, 2.0 / 3.0), s2, 2.0) * s;
+    z = fma((double)e, APPROX_LN2, p);
+    return (x > 0.0) ? z : -INFINITY;
+}
+
+
+static inline double fast_exp(double x) {
+#if APPROX_TIER == APPROX_TIER_TABLE
+    return fast_exp_table(x);
+#elif APPROX_TIER == APPROX_TIER_POLY
+    return fast_exp_poly(x);
+#else
+    return fast_exp_raw(x);
+#endif
+}
+
+
+static inline double fast_log(double x) {
+#if APPROX_TIER == APPROX_TIER_TABLE
+    return fast_log_table(x);
+#elif APPROX_TIER == APPROX_TIER_POLY
+    return fast_log_poly(x);
+#else
+    return fast_log_raw(x);
+#endif
+}
+
+
+// run time choice of tier. with a constant tier this folds to one of the
+// above, so kernels can be specialised per tier by inlining.
+static inline double fast_exp_tier(double x, int tier) {
+    return (tier == APPROX_TIER_POLY) ? fast_exp_poly(x) :
+        (tier == APPROX_TIER_TABLE) ? fast_exp_table(x) : fast_exp_raw(x);
+}
+
+
+static inline double fast_log_tier(double x, int tier) {
+    return (tier == APPROX_TIER_POLY) ? fast_log_poly(x) :
+        (tier == APPROX_TIER_TABLE) ? fast_log_table(x) : fast_log_raw(x);
+}
+
+#endif
@@ -0,0 +1,168 @@
+
+#ifndef JIT_APPROX_TEMPLATES_H
+#define JIT_APPROX_TEMPLATES_H 1
+
+
+const unsigned char CODE_ACC_FAST_EXP_HEADER_TABLE[] = {
+	0xc5, 0xe9, 0x57, 0xd2, //vxorpd %xmm2,%xmm2,%xmm2
+	0x48, 0xb9, 0xfe, 0x82, 0x2b, 0x65, 0x47, //movabs $0x43371547652b82fe,%rcx
+	0x15, 0x37, 0x43,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe1, //vmovq  %rcx,%xmm4
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x43cff80000000000,%rcx
+	0xf8, 0xcf, 0x43,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm5
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xc086100000000000,%rcx
+	0x10, 0x86, 0xc0,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1 //vmovq  %rcx,%xmm6
+};
+
+const unsigned char CODE_ACC_FAST_EXP_CYCLE_TABLE[] = {
+	0xc5, 0xe3, 0x5c, 0xd9, //vsubsd %xmm1,%xmm3,%xmm3
+	0xc5, 0xf9, 0x28, 0xfc, //vmovapd %xmm4,%xmm7
+	0xc4, 0xe2, 0xe1, 0xa9, 0xfd, //vfmadd213sd %xmm5,%xmm3,%xmm7
+	0xc5, 0xcb, 0xc2, 0xdb, 0x02, //vcmplesd %xmm3,%xmm6,%xmm3
+	0xc4, 0xe1, 0xfb, 0x2c, 0xcf, //vcvttsd2si %xmm7,%rcx
+	0x48, 0x89, 0xc8, //mov    %rcx,%rax
+	0x48, 0xc1, 0xe8, 0x2c, //shr    $0x2c,%rax
+	0x25, 0xff, 0x00, 0x00, 0x00, //and    $0xff,%eax
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf9, //vmovq  %rcx,%xmm7
+	0xc4, 0xc1, 0x43, 0x59, 0x3c, 0xc0, //vmulsd (%r8,%rax,8),%xmm7,%xmm7
+	0xc5, 0xe1, 0x54, 0xdf, //vandpd %xmm7,%xmm3,%xmm3
+	0xc5, 0xeb, 0x58, 0xd3 //vaddsd %xmm3,%xmm2,%xmm2
+};
+
+const unsigned char CODE_FAST_LOG_TABLE[] = {
+	0xc5, 0xc1, 0x57, 0xff, //vxorpd %xmm7,%xmm7,%xmm7
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xfff0000000000000,%rcx
+	0x00, 0xf0, 0xff,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe1, //vmovq  %rcx,%xmm4
+	0x48, 0xb9, 0xef, 0x39, 0xfa, 0xfe, 0x42, //movabs $0x3ca62e42fefa39ef,%rcx
+	0x2e, 0xa6, 0x3c,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm5
+	0x48, 0xb9, 0x61, 0x7b, 0x3a, 0x6e, 0xb7, //movabs $0xc08628b76e3a7b61,%rcx
+	0x28, 0x86, 0xc0,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc4, 0xe1, 0xf9, 0x7e, 0xd0, //vmovq  %xmm2,%rax
+	0xc4, 0xe1, 0xc3, 0x2a, 0xd8, //vcvtsi2sd %rax,%xmm7,%xmm3
+	0xc4, 0xe2, 0xd1, 0xa9, 0xde, //vfmadd213sd %xmm6,%xmm5,%xmm3
+	0x48, 0xc1, 0xe8, 0x2c, //shr    $0x2c,%rax
+	0x25, 0xff, 0x00, 0x00, 0x00, //and    $0xff,%eax
+	0xc4, 0xc1, 0x63, 0x58, 0x1c, 0xc1, //vaddsd (%r9,%rax,8),%xmm3,%xmm3
+	0xc5, 0xc3, 0xc2, 0xd2, 0x01, //vcmpltsd %xmm2,%xmm7,%xmm2
+	0xc4, 0xe3, 0x59, 0x4b, 0xd3, 0x20, //vblendvpd %xmm2,%xmm3,%xmm4,%xmm2
+	0xc5, 0xf3, 0x58, 0xd2, //vaddsd %xmm2,%xmm1,%xmm2
+	0xc5, 0xfb, 0x58, 0xc2 //vaddsd %xmm2,%xmm0,%xmm0
+};
+
+const unsigned char CODE_ACC_FAST_EXP_HEADER_POLY[] = {
+	0xc5, 0xe9, 0x57, 0xd2, //vxorpd %xmm2,%xmm2,%xmm2
+	0x48, 0xb9, 0xfe, 0x82, 0x2b, 0x65, 0x47, //movabs $0x3ff71547652b82fe,%rcx
+	0x15, 0xf7, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe1, //vmovq  %rcx,%xmm4
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xc086100000000000,%rcx
+	0x10, 0x86, 0xc0,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm5
+	0x48, 0xb9, 0x95, 0xa7, 0x2e, 0x30, 0x61, //movabs $0x3f8b7f61302ea795,%rcx
+	0x7f, 0x8b, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0x48, 0xb9, 0xcd, 0x9d, 0x9b, 0x9f, 0x51, //movabs $0x3faabf519f9b9dcd,%rcx
+	0xbf, 0xaa, 0x3f,
+	0xc4, 0x61, 0xf9, 0x6e, 0xc1, //vmovq  %rcx,%xmm8
+	0x48, 0xb9, 0xb4, 0x83, 0x3d, 0xe3, 0x59, //movabs $0x3fcee259e33d83b4,%rcx
+	0xe2, 0xce, 0x3f,
+	0xc4, 0x61, 0xf9, 0x6e, 0xc9, //vmovq  %rcx,%xmm9
+	0x48, 0xb9, 0xb9, 0x2f, 0xc9, 0xa0, 0x6a, //movabs $0x3fe62d6aa0c92fb9,%rcx
+	0x2d, 0xe6, 0x3f,
+	0xc4, 0x61, 0xf9, 0x6e, 0xd1, //vmovq  %rcx,%xmm10
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3ff0000000000000,%rcx
+	0x00, 0xf0, 0x3f,
+	0xc4, 0x61, 0xf9, 0x6e, 0xd9, //vmovq  %rcx,%xmm11
+	0x48, 0xb9, 0xff, 0x03, 0x00, 0x00, 0x00, //movabs $0x43300000000003ff,%rcx
+	0x00, 0x30, 0x43,
+	0xc4, 0x61, 0xf9, 0x6e, 0xe1 //vmovq  %rcx,%xmm12
+};
+
+const unsigned char CODE_ACC_FAST_EXP_CYCLE_POLY[] = {
+	0xc5, 0xe3, 0x5c, 0xd9, //vsubsd %xmm1,%xmm3,%xmm3
+	0xc5, 0xe3, 0x5f, 0xfd, //vmaxsd %xmm5,%xmm3,%xmm7
+	0xc5, 0xc3, 0x59, 0xfc, //vmulsd %xmm4,%xmm7,%xmm7
+	0xc4, 0x63, 0x41, 0x0b, 0xef, 0x09, //vroundsd $0x9,%xmm7,%xmm7,%xmm13
+	0xc4, 0xc1, 0x43, 0x5c, 0xfd, //vsubsd %xmm13,%xmm7,%xmm7
+	0xc5, 0x79, 0x28, 0xf6, //vmovapd %xmm6,%xmm14
+	0xc4, 0x42, 0xc1, 0xa9, 0xf0, //vfmadd213sd %xmm8,%xmm7,%xmm14
+	0xc4, 0x42, 0xc1, 0xa9, 0xf1, //vfmadd213sd %xmm9,%xmm7,%xmm14
+	0xc4, 0x42, 0xc1, 0xa9, 0xf2, //vfmadd213sd %xmm10,%xmm7,%xmm14
+	0xc4, 0x42, 0xc1, 0xa9, 0xf3, //vfmadd213sd %xmm11,%xmm7,%xmm14
+	0xc4, 0x41, 0x13, 0x58, 0xec, //vaddsd %xmm12,%xmm13,%xmm13
+	0xc4, 0xc1, 0x11, 0x73, 0xf5, 0x34, //vpsllq $0x34,%xmm13,%xmm13
+	0xc4, 0x41, 0x0b, 0x59, 0xf5, //vmulsd %xmm13,%xmm14,%xmm14
+	0xc5, 0xd3, 0xc2, 0xdb, 0x02, //vcmplesd %xmm3,%xmm5,%xmm3
+	0xc4, 0xc1, 0x61, 0x54, 0xde, //vandpd %xmm14,%xmm3,%xmm3
+	0xc5, 0xeb, 0x58, 0xd3 //vaddsd %xmm3,%xmm2,%xmm2
+};
+
+const unsigned char CODE_FAST_LOG_POLY[] = {
+	0xc5, 0xc1, 0x57, 0xff, //vxorpd %xmm7,%xmm7,%xmm7
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xfff0000000000000,%rcx
+	0x00, 0xf0, 0xff,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe1, //vmovq  %rcx,%xmm4
+	0xc4, 0xe1, 0xf9, 0x7e, 0xd0, //vmovq  %xmm2,%rax
+	0x49, 0x89, 0xc2, //mov    %rax,%r10
+	0x49, 0xc1, 0xea, 0x34, //shr    $0x34,%r10
+	0x49, 0x81, 0xea, 0xff, 0x03, 0x00, 0x00, //sub    $0x3ff,%r10
+	0x48, 0xba, 0xff, 0xff, 0xff, 0xff, 0xff, //movabs $0xfffffffffffff,%rdx
+	0xff, 0x0f, 0x00,
+	0x48, 0x21, 0xd0, //and    %rdx,%rax
+	0x48, 0xba, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3ff0000000000000,%rdx
+	0x00, 0xf0, 0x3f,
+	0x48, 0x09, 0xd0, //or     %rdx,%rax
+	0xc4, 0xe1, 0xf9, 0x6e, 0xd8, //vmovq  %rax,%xmm3
+	0x48, 0xb9, 0xcd, 0x3b, 0x7f, 0x66, 0x9e, //movabs $0x3ff6a09e667f3bcd,%rcx
+	0xa0, 0xf6, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm5
+	0xc5, 0xd3, 0xc2, 0xeb, 0x01, //vcmpltsd %xmm3,%xmm5,%xmm5
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3fe0000000000000,%rcx
+	0x00, 0xe0, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc5, 0xe3, 0x59, 0xf6, //vmulsd %xmm6,%xmm3,%xmm6
+	0xc4, 0xe3, 0x61, 0x4b, 0xde, 0x50, //vblendvpd %xmm5,%xmm6,%xmm3,%xmm3
+	0xc4, 0xe1, 0xf9, 0x7e, 0xea, //vmovq  %xmm5,%rdx
+	0x83, 0xe2, 0x01, //and    $0x1,%edx
+	0x49, 0x01, 0xd2, //add    %rdx,%r10
+	0xc4, 0xc1, 0xc3, 0x2a, 0xea, //vcvtsi2sd %r10,%xmm7,%xmm5
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3ff0000000000000,%rcx
+	0x00, 0xf0, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc5, 0x63, 0x5c, 0xee, //vsubsd %xmm6,%xmm3,%xmm13
+	0xc5, 0xe3, 0x58, 0xde, //vaddsd %xmm6,%xmm3,%xmm3
+	0xc5, 0x13, 0x5e, 0xeb, //vdivsd %xmm3,%xmm13,%xmm13
+	0xc4, 0x41, 0x13, 0x59, 0xf5, //vmulsd %xmm13,%xmm13,%xmm14
+	0x48, 0xb9, 0x92, 0x24, 0x49, 0x92, 0x24, //movabs $0x3fd2492492492492,%rcx
+	0x49, 0xd2, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xd9, //vmovq  %rcx,%xmm3
+	0x48, 0xb9, 0x9a, 0x99, 0x99, 0x99, 0x99, //movabs $0x3fd999999999999a,%rcx
+	0x99, 0xd9, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc4, 0xe2, 0x89, 0xa9, 0xde, //vfmadd213sd %xmm6,%xmm14,%xmm3
+	0x48, 0xb9, 0x55, 0x55, 0x55, 0x55, 0x55, //movabs $0x3fe5555555555555,%rcx
+	0x55, 0xe5, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc4, 0xe2, 0x89, 0xa9, 0xde, //vfmadd213sd %xmm6,%xmm14,%xmm3
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x4000000000000000,%rcx
+	0x00, 0x00, 0x40,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc4, 0xe2, 0x89, 0xa9, 0xde, //vfmadd213sd %xmm6,%xmm14,%xmm3
+	0xc4, 0xc1, 0x63, 0x59, 0xdd, //vmulsd %xmm13,%xmm3,%xmm3
+	0x48, 0xb9, 0xef, 0x39, 0xfa, 0xfe, 0x42, //movabs $0x3fe62e42fefa39ef,%rcx
+	0x2e, 0xe6, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc4, 0xe2, 0xd1, 0xb9, 0xde, //vfmadd231sd %xmm6,%xmm5,%xmm3
+	0xc5, 0xc3, 0xc2, 0xd2, 0x01, //vcmpltsd %xmm2,%xmm7,%xmm2
+	0xc4, 0xe3, 0x59, 0x4b, 0xd3, 0x20, //vblendvpd %xmm2,%xmm3,%xmm4,%xmm2
+	0xc5, 0xf3, 0x58, 0xd2, //vaddsd %xmm2,%xmm1,%xmm2
+	0xc5, 0xfb, 0x58, 0xc2 //vaddsd %xmm2,%xmm0,%xmm0
+};
+
+
+
+#endif
@@ -7,13 +7,19 @@
 
 
 #include "types.h"
+#include "fast_approx.h"
+#include "jit_logsumexp.h"
+#include "lse_instrument.h"
 #include "jit_compare_tree.h"
+#include "jit_softmax_templates.h"
+#include "jit_approx_templates.h"
+#include "jit_multi_templates.h"
 
 
 int allocate_jit_reduction_func(size_t size, jit_reduction_func_t *jf) {
     size_t alloc_size = ((size / 1024) + 1) * 1024;
 	void* m = mmap(0, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // RW
-    if (m == 0) {
+    if (m == MAP_FAILED) {
         jf->f = NULL;
         jf->m = NULL;
         jf->size = 0;
@@ -22,6 +28,7 @@ int allocate_jit_reduction_func(size_t size, jit_reduction_func_t *jf) {
     jf->f = NULL;
     jf->m = m;
     jf->size = alloc_size;
+    LSE_INSTRUMENT_JIT(size);
     return 0;
 }
 
@@ -49,6 +56,7 @@ int release_jit_reduction_func(jit_reduction_func_t *jf) {
     if (status != 0) {
         return status;
     }
+    jf->m = NULL;
     jf->size = 0;
     return 0;
 }
@@ -327,13 +335,55 @@ void encode_literal_int64(unsigned char *code, long x) {
 }
 
 
-int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit_reduction_func_t *jf) {
+// exp / log templates per accuracy tier, indexed by APPROX_TIER_*
+
+const unsigned char* CODE_ACC_FAST_EXP_HEADER_TIER[] = {
+    CODE_ACC_FAST_EXP_HEADER,
+    CODE_ACC_FAST_EXP_HEADER_TABLE,
+    CODE_ACC_FAST_EXP_HEADER_POLY
+};
+
+const size_t CODESIZE_ACC_FAST_EXP_HEADER_TIER[] = {
+    sizeof(CODE_ACC_FAST_EXP_HEADER),
+    sizeof(CODE_ACC_FAST_EXP_HEADER_TABLE),
+    sizeof(CODE_ACC_FAST_EXP_HEADER_POLY)
+};
+
+const unsigned char* CODE_ACC_FAST_EXP_CYCLE_TIER[] = {
+    CODE_ACC_FAST_EXP_CYCLE,
+    CODE_ACC_FAST_EXP_CYCLE_TABLE,
+    CODE_ACC_FAST_EXP_CYCLE_POLY
+};
+
+const size_t CODESIZE_ACC_FAST_EXP_CYCLE_TIER[] = {
+    sizeof(CODE_ACC_FAST_EXP_CYCLE),
+    sizeof(CODE_ACC_FAST_EXP_CYCLE_TABLE),
+    sizeof(CODE_ACC_FAST_EXP_CYCLE_POLY)
+};
+
+const unsigned char* CODE_FAST_LOG_TIER[] = {
+    CODE_FAST_LOG,
+    CODE_FAST_LOG_TABLE,
+    CODE_FAST_LOG_POLY
+};
+
+const size_t CODESIZE_FAST_LOG_TIER[] = {
+    sizeof(CODE_FAST_LOG),
+    sizeof(CODE_FAST_LOG_TABLE),
+    sizeof(CODE_FAST_LOG_POLY)
+};
+
+
+int make_batch_log_sum_exp_jit_reduction_func_tier(range_t *ranges, int n_ranges, int tier, jit_reduction_func_t *jf) {
     // batched variant of make_log_sum_exp_jit_reduction_func
     // x86-64 system V ABI
     // first three integer/pointer parameters are passed as rdi, rsi, rdx
     // rdi : pointer to data (array of doubles)
     // rsi : pointer to ranges (array of range_t). ignored at runtime. we use given ranges at jit-time
     // rdx : number of ranges. ignored at runtime. we use n_ranges at jit-time.
+    //
+    // tier is one of APPROX_TIER_*. the table tier keeps the addresses of
+    // its tables in r8 and r9.
   
     int total_size = 0, iota, i, n, range_i, offset, prev_offset, delta_offset, status;
     unsigned char *code = NULL;
@@ -344,7 +394,21 @@ int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit
         0x48, 0x01, 0xcf // add %rcx,%rdi
     };
 
+    unsigned char code_load_tables[20] = {
+        0x49, 0xb8, // movabs $<64bit-int-literal>,%r8
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // <64bit-int-literal>
+        0x49, 0xb9, // movabs $<64bit-int-literal>,%r9
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // <64bit-int-literal>
+    };
+
+    if (tier < APPROX_TIER_RAW || tier > APPROX_TIER_POLY) {
+        return 1;
+    }
+
     total_size += sizeof(CODE_LOG_SUM_EXP_HEADER);
+    if (tier == APPROX_TIER_TABLE) {
+        total_size += sizeof(code_load_tables);
+    }
 
     for (range_i = 0; range_i < n_ranges; ++range_i) {
         offset = ranges[range_i].offset;
@@ -361,12 +425,184 @@ int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit
             total_size += CODESIZE_MAX_OF_N[n];
             total_size += sizeof(CODE_MOVE_XMM3_XMM1);
 
+            total_size += CODESIZE_ACC_FAST_EXP_HEADER_TIER[tier];
+            for (i = 0; i < n; ++i) {
+                total_size += CODESIZE_LOAD_A_XMM3[i] + CODESIZE_ACC_FAST_EXP_CYCLE_TIER[tier];
+            }
+            total_size += CODESIZE_FAST_LOG_TIER[tier];
+        }
+    }
+
+    total_size += sizeof(CODE_LOG_SUM_EXP_FOOTER);
+
+    status = allocate_jit_reduction_func(total_size * sizeof(unsigned char), jf);
+    if (status != 0) {
+        return status;
+    }
+    code = (unsigned char*)jf->m;
+
+    iota = 0;
+
+    memcpy(code + iota, CODE_LOG_SUM_EXP_HEADER, sizeof(CODE_LOG_SUM_EXP_HEADER)); iota += sizeof(CODE_LOG_SUM_EXP_HEADER);
+    if (tier == APPROX_TIER_TABLE) {
+        encode_literal_int64(code_load_tables + 2, (long)APPROX_EXP_TABLE);
+        encode_literal_int64(code_load_tables + 12, (long)APPROX_LOG_TABLE);
+        memcpy(code + iota, code_load_tables, sizeof(code_load_tables)); iota += sizeof(code_load_tables);
+    }
+
+    prev_offset = 0;
+
+    for (range_i = 0; range_i < n_ranges; ++range_i) {
+        offset = ranges[range_i].offset;
+        n = ranges[range_i].width;
+
+        // move rdi by delta_offset * sizeof(double)
+        delta_offset = offset - prev_offset;
+        prev_offset = offset;
+
+        encode_literal_int64(code_shift_rdi + 2, (long)(sizeof(double) * delta_offset)); // overwrite int64 literal with delta_offset
+        memcpy(code + iota, code_shift_rdi, sizeof(code_shift_rdi)); iota += sizeof(code_shift_rdi);
+
+        if (n == 1) {
+            // special case: log_sum_exp([x]) is x
+            memcpy(code + iota, CODE_LOAD_A_XMM3[0], CODESIZE_LOAD_A_XMM3[0]);
+            iota += CODESIZE_LOAD_A_XMM3[0];
+            memcpy(code + iota, CODE_ACCUMULATE_XMM3_XMM0, sizeof(CODE_ACCUMULATE_XMM3_XMM0));
+            iota += sizeof(CODE_ACCUMULATE_XMM3_XMM0);
+        } else {
+            memcpy(code + iota, CODE_MAX_OF_N[n], CODESIZE_MAX_OF_N[n]); iota += CODESIZE_MAX_OF_N[n];
+            memcpy(code + iota, CODE_MOVE_XMM3_XMM1, sizeof(CODE_MOVE_XMM3_XMM1)); iota += sizeof(CODE_MOVE_XMM3_XMM1);
+
+            memcpy(code + iota, CODE_ACC_FAST_EXP_HEADER_TIER[tier], CODESIZE_ACC_FAST_EXP_HEADER_TIER[tier]);
+            iota += CODESIZE_ACC_FAST_EXP_HEADER_TIER[tier];
+            for (i = 0; i < n; ++i) {
+                memcpy(code + iota, CODE_LOAD_A_XMM3[i], CODESIZE_LOAD_A_XMM3[i]);
+                iota += CODESIZE_LOAD_A_XMM3[i];
+                memcpy(code + iota, CODE_ACC_FAST_EXP_CYCLE_TIER[tier], CODESIZE_ACC_FAST_EXP_CYCLE_TIER[tier]);
+                iota += CODESIZE_ACC_FAST_EXP_CYCLE_TIER[tier];
+            }
+            memcpy(code + iota, CODE_FAST_LOG_TIER[tier], CODESIZE_FAST_LOG_TIER[tier]);
+            iota += CODESIZE_FAST_LOG_TIER[tier];
+        }
+    }
+    memcpy(code + iota, CODE_LOG_SUM_EXP_FOOTER, sizeof(CODE_LOG_SUM_EXP_FOOTER)); iota += sizeof(CODE_LOG_SUM_EXP_FOOTER);
+
+    return 0;
+}
+
+
+
+int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit_reduction_func_t *jf) {
+    return make_batch_log_sum_exp_jit_reduction_func_tier(ranges, n_ranges, APPROX_TIER_RAW, jf);
+}
+
+
+const unsigned char* CODE_STORE_E[] = {
+    CODE_STORE_E_0,
+    CODE_STORE_E_1,
+    CODE_STORE_E_2,
+    CODE_STORE_E_3,
+    CODE_STORE_E_4,
+    CODE_STORE_E_5,
+    CODE_STORE_E_6,
+    CODE_STORE_E_7,
+    CODE_STORE_E_8,
+    CODE_STORE_E_9
+};
+
+const size_t CODESIZE_STORE_E[] = {
+    sizeof(CODE_STORE_E_0),
+    sizeof(CODE_STORE_E_1),
+    sizeof(CODE_STORE_E_2),
+    sizeof(CODE_STORE_E_3),
+    sizeof(CODE_STORE_E_4),
+    sizeof(CODE_STORE_E_5),
+    sizeof(CODE_STORE_E_6),
+    sizeof(CODE_STORE_E_7),
+    sizeof(CODE_STORE_E_8),
+    sizeof(CODE_STORE_E_9)
+};
+
+const unsigned char* CODE_SCALE_OUT[] = {
+    CODE_SCALE_OUT_0,
+    CODE_SCALE_OUT_1,
+    CODE_SCALE_OUT_2,
+    CODE_SCALE_OUT_3,
+    CODE_SCALE_OUT_4,
+    CODE_SCALE_OUT_5,
+    CODE_SCALE_OUT_6,
+    CODE_SCALE_OUT_7,
+    CODE_SCALE_OUT_8,
+    CODE_SCALE_OUT_9
+};
+
+const size_t CODESIZE_SCALE_OUT[] = {
+    sizeof(CODE_SCALE_OUT_0),
+    sizeof(CODE_SCALE_OUT_1),
+    sizeof(CODE_SCALE_OUT_2),
+    sizeof(CODE_SCALE_OUT_3),
+    sizeof(CODE_SCALE_OUT_4),
+    sizeof(CODE_SCALE_OUT_5),
+    sizeof(CODE_SCALE_OUT_6),
+    sizeof(CODE_SCALE_OUT_7),
+    sizeof(CODE_SCALE_OUT_8),
+    sizeof(CODE_SCALE_OUT_9)
+};
+
+
+int make_batch_softmax_jit_reduction_func(range_t *ranges, int n_ranges, jit_reduction_func_t *jf) {
+    // fused variant of make_batch_log_sum_exp_jit_reduction_func.
+    // as well as returning the summed log-sum-exp, writes the softmax
+    // weights exp(a[i] - lse) of each range to consecutive slots of an
+    // output array. call the result as a fused_reduction_func_t.
+    // rdi : pointer to data (array of doubles)
+    // rsi : pointer to output (array of doubles, total width of ranges)
+    //
+    // each e[i] = fast_exp(a[i] - acc_max) is stored as soon as the exp
+    // cycle produces it, then rescaled in place by 1 / acc.
+
+    int total_size = 0, iota, i, n, range_i, offset, prev_offset, delta_offset, status;
+    unsigned char *code = NULL;
+
+    unsigned char code_shift_rdi[13] = {
+        0x48, 0xb9, // movabs $<64bit-int-literal>,%rcx
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // <64bit-int-literal>
+        0x48, 0x01, 0xcf // add %rcx,%rdi
+    };
+
+    unsigned char code_advance_rsi[4] = {
+        0x48, 0x83, 0xc6, 0x00 // add $<8bit-int-literal>,%rsi
+    };
+
+    total_size += sizeof(CODE_LOG_SUM_EXP_HEADER);
+
+    for (range_i = 0; range_i < n_ranges; ++range_i) {
+        n = ranges[range_i].width;
+        if (n < 1 || n > 10) {
+            return 1;
+        }
+
+        total_size += sizeof(code_shift_rdi);
+
+        if (n == 1) {
+            total_size += CODESIZE_LOAD_A_XMM3[0];
+            total_size += sizeof(CODE_ACCUMULATE_XMM3_XMM0);
+            total_size += sizeof(CODE_SOFTMAX_SINGLETON);
+        } else {
+            total_size += CODESIZE_MAX_OF_N[n];
+            total_size += sizeof(CODE_MOVE_XMM3_XMM1);
+
             total_size += sizeof(CODE_ACC_FAST_EXP_HEADER);
             for (i = 0; i < n; ++i) {
-                total_size += CODESIZE_LOAD_A_XMM3[i] + sizeof(CODE_ACC_FAST_EXP_CYCLE);
+                total_size += CODESIZE_LOAD_A_XMM3[i] + sizeof(CODE_ACC_FAST_EXP_CYCLE) + CODESIZE_STORE_E[i];
             }
+            total_size += sizeof(CODE_INV_ACC);
             total_size += sizeof(CODE_FAST_LOG);
+            for (i = 0; i < n; ++i) {
+                total_size += CODESIZE_SCALE_OUT[i];
+            }
         }
+        total_size += sizeof(code_advance_rsi);
     }
 
     total_size += sizeof(CODE_LOG_SUM_EXP_FOOTER);
@@ -395,11 +631,13 @@ int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit
         memcpy(code + iota, code_shift_rdi, sizeof(code_shift_rdi)); iota += sizeof(code_shift_rdi);
 
         if (n == 1) {
-            // special case: log_sum_exp([x]) is x
+            // special case: log_sum_exp([x]) is x, and its weight is 1
             memcpy(code + iota, CODE_LOAD_A_XMM3[0], CODESIZE_LOAD_A_XMM3[0]);
             iota += CODESIZE_LOAD_A_XMM3[0];
             memcpy(code + iota, CODE_ACCUMULATE_XMM3_XMM0, sizeof(CODE_ACCUMULATE_XMM3_XMM0));
             iota += sizeof(CODE_ACCUMULATE_XMM3_XMM0);
+            memcpy(code + iota, CODE_SOFTMAX_SINGLETON, sizeof(CODE_SOFTMAX_SINGLETON));
+            iota += sizeof(CODE_SOFTMAX_SINGLETON);
         } else {
             memcpy(code + iota, CODE_MAX_OF_N[n], CODESIZE_MAX_OF_N[n]); iota += CODESIZE_MAX_OF_N[n];
             memcpy(code + iota, CODE_MOVE_XMM3_XMM1, sizeof(CODE_MOVE_XMM3_XMM1)); iota += sizeof(CODE_MOVE_XMM3_XMM1);
@@ -410,12 +648,144 @@ int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit
                 iota += CODESIZE_LOAD_A_XMM3[i];
                 memcpy(code + iota, CODE_ACC_FAST_EXP_CYCLE, sizeof(CODE_ACC_FAST_EXP_CYCLE));
                 iota += sizeof(CODE_ACC_FAST_EXP_CYCLE);
+                memcpy(code + iota, CODE_STORE_E[i], CODESIZE_STORE_E[i]);
+                iota += CODESIZE_STORE_E[i];
             }
+            // 1 / acc must be taken before CODE_FAST_LOG overwrites acc
+            memcpy(code + iota, CODE_INV_ACC, sizeof(CODE_INV_ACC)); iota += sizeof(CODE_INV_ACC);
             memcpy(code + iota, CODE_FAST_LOG, sizeof(CODE_FAST_LOG)); iota += sizeof(CODE_FAST_LOG);
+            for (i = 0; i < n; ++i) {
+                memcpy(code + iota, CODE_SCALE_OUT[i], CODESIZE_SCALE_OUT[i]);
+                iota += CODESIZE_SCALE_OUT[i];
+            }
         }
+
+        code_advance_rsi[3] = (unsigned char)(sizeof(double) * n);
+        memcpy(code + iota, code_advance_rsi, sizeof(code_advance_rsi)); iota += sizeof(code_advance_rsi);
     }
     memcpy(code + iota, CODE_LOG_SUM_EXP_FOOTER, sizeof(CODE_LOG_SUM_EXP_FOOTER)); iota += sizeof(CODE_LOG_SUM_EXP_FOOTER);
 
     return 0;
 }
 
+
+static void encode_literal_int32(unsigned char *code, int x) {
+    int i;
+    for (i = 0; i < 4; ++i) {
+        code[i] = 0xff & x;
+        x >>= 8;
+    }
+}
+
+
+static int emit_multi_load(unsigned char *code, const unsigned char *template, size_t size, long disp) {
+    // copy a load template and patch its trailing 32 bit displacement.
+    // returns the number of bytes written.
+    memcpy(code, template, size);
+    encode_literal_int32(code + size - 4, (int)disp);
+    return (int)size;
+}
+
+
+static int emit_call(unsigned char *code, int iota, int target) {
+    // call rel32 from code + iota to code + target. returns 5.
+    code[iota] = 0xe8;
+    encode_literal_int32(code + iota + 1, target - (iota + 5));
+    return 5;
+}
+
+
+int make_multi_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, int k, jit_reduction_func_t *jf) {
+    // multi-vector variant of make_batch_log_sum_exp_jit_reduction_func.
+    // the data is k interleaved vectors, element i of vector v at
+    // data[i * k + v]. the generated code evaluates every range over 4 of
+    // them at once, one per ymm lane. call the result as a
+    // multi_reduction_func_t once per group of 4 vectors:
+    // rdi : pointer to the group's first vector, data + v
+    // rsi : pointer to the group's 4 totals, written not accumulated
+    //
+    // k is baked into the load displacements, so it must be a multiple
+    // of 4 and i * k * sizeof(double) must fit in 32 bits. returns 1 for
+    // an unsupported k or range width.
+    //
+    // the exp cycle and the log are subroutines placed after the final
+    // ret, so the code per range is loads and calls.
+
+    int total_size = 0, iota, i, n, range_i, offset, prev_offset, status, exp_at, log_at;
+    long stride, delta_offset;
+    unsigned char *code = NULL;
+
+    unsigned char code_shift_rdi[13] = {
+        0x48, 0xb9, // movabs $<64bit-int-literal>,%rcx
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // <64bit-int-literal>
+        0x48, 0x01, 0xcf // add %rcx,%rdi
+    };
+
+    if (k < 4 || k % 4 != 0 || (long)k * sizeof(double) * MAX_BB_WIDTH > 0x7fffffffl) {
+        return 1;
+    }
+    stride = (long)k * sizeof(double);
+
+    total_size += sizeof(CODE_MULTI_HEADER);
+    for (range_i = 0; range_i < n_ranges; ++range_i) {
+        n = ranges[range_i].width;
+        if (n < 1 || n > MAX_BB_WIDTH) {
+            return 1;
+        }
+        total_size += sizeof(code_shift_rdi);
+        total_size += sizeof(CODE_MULTI_LOAD_A_YMM1) + (n - 1) * sizeof(CODE_MULTI_MAX_A_YMM1);
+        if (n == 1) {
+            total_size += sizeof(CODE_MULTI_SINGLETON);
+        } else {
+            total_size += sizeof(CODE_MULTI_SHIFT);
+            total_size += n * (sizeof(CODE_MULTI_LOAD_A_YMM3) + 5);
+            total_size += 5;
+        }
+    }
+    total_size += sizeof(CODE_MULTI_FOOTER);
+    exp_at = total_size;
+    total_size += sizeof(CODE_MULTI_EXP_CYCLE);
+    log_at = total_size;
+    total_size += sizeof(CODE_MULTI_LOG);
+
+    status = allocate_jit_reduction_func(total_size * sizeof(unsigned char), jf);
+    if (status != 0) {
+        return status;
+    }
+    code = (unsigned char*)jf->m;
+
+    iota = 0;
+    memcpy(code + iota, CODE_MULTI_HEADER, sizeof(CODE_MULTI_HEADER)); iota += sizeof(CODE_MULTI_HEADER);
+
+    prev_offset = 0;
+    for (range_i = 0; range_i < n_ranges; ++range_i) {
+        offset = ranges[range_i].offset;
+        n = ranges[range_i].width;
+
+        // move rdi by delta_offset rows of k doubles
+        delta_offset = (long)(offset - prev_offset) * stride;
+        prev_offset = offset;
+        encode_literal_int64(code_shift_rdi + 2, delta_offset);
+        memcpy(code + iota, code_shift_rdi, sizeof(code_shift_rdi)); iota += sizeof(code_shift_rdi);
+
+        iota += emit_multi_load(code + iota, CODE_MULTI_LOAD_A_YMM1, sizeof(CODE_MULTI_LOAD_A_YMM1), 0);
+        for (i = 1; i < n; ++i) {
+            iota += emit_multi_load(code + iota, CODE_MULTI_MAX_A_YMM1, sizeof(CODE_MULTI_MAX_A_YMM1), i * stride);
+        }
+        if (n == 1) {
+            memcpy(code + iota, CODE_MULTI_SINGLETON, sizeof(CODE_MULTI_SINGLETON)); iota += sizeof(CODE_MULTI_SINGLETON);
+        } else {
+            memcpy(code + iota, CODE_MULTI_SHIFT, sizeof(CODE_MULTI_SHIFT)); iota += sizeof(CODE_MULTI_SHIFT);
+            for (i = 0; i < n; ++i) {
+                iota += emit_multi_load(code + iota, CODE_MULTI_LOAD_A_YMM3, sizeof(CODE_MULTI_LOAD_A_YMM3), i * stride);
+                iota += emit_call(code, iota, exp_at);
+            }
+            iota += emit_call(code, iota, log_at);
+        }
+    }
+    memcpy(code + iota, CODE_MULTI_FOOTER, sizeof(CODE_MULTI_FOOTER)); iota += sizeof(CODE_MULTI_FOOTER);
+    memcpy(code + iota, CODE_MULTI_EXP_CYCLE, sizeof(CODE_MULTI_EXP_CYCLE)); iota += sizeof(CODE_MULTI_EXP_CYCLE);
+    memcpy(code + iota, CODE_MULTI_LOG, sizeof(CODE_MULTI_LOG)); iota += sizeof(CODE_MULTI_LOG);
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef _LSEA_JIT_LOGSUMEXP
+#define _LSEA_JIT_LOGSUMEXP 1
+
+#include <stddef.h>
+
+#include "types.h"
+
+
+int allocate_jit_reduction_func(size_t size, jit_reduction_func_t *jf);
+int arm_jit_reduction_func(jit_reduction_func_t *jf);
+int release_jit_reduction_func(jit_reduction_func_t *jf);
+
+int make_log_sum_exp_jit_reduction_func(int n, jit_reduction_func_t *jf);
+int make_batch_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, jit_reduction_func_t *jf);
+int make_batch_log_sum_exp_jit_reduction_func_tier(range_t *ranges, int n_ranges, int tier, jit_reduction_func_t *jf);
+int make_batch_softmax_jit_reduction_func(range_t *ranges, int n_ranges, jit_reduction_func_t *jf);
+int make_multi_log_sum_exp_jit_reduction_func(range_t *ranges, int n_ranges, int k, jit_reduction_func_t *jf);
+
+#endif
@@ -0,0 +1,121 @@
+
+#ifndef JIT_MULTI_TEMPLATES_H
+#define JIT_MULTI_TEMPLATES_H 1
+
+
+const unsigned char CODE_MULTI_HEADER[] = {
+	0xc5, 0xfd, 0x57, 0xc0, //vxorpd %ymm0,%ymm0,%ymm0
+	0x48, 0xb9, 0xfe, 0x82, 0x2b, 0x65, 0x47, //movabs $0x43371547652b82fe,%rcx
+	0x15, 0x37, 0x43,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe1, //vmovq  %rcx,%xmm4
+	0xc4, 0xe2, 0x7d, 0x19, 0xe4, //vbroadcastsd %xmm4,%ymm4
+	0x48, 0xb9, 0x00, 0x00, 0x80, 0x3f, 0x89, //movabs $0x43cff7893f800000,%rcx
+	0xf7, 0xcf, 0x43,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm5
+	0xc4, 0xe2, 0x7d, 0x19, 0xed, //vbroadcastsd %xmm5,%ymm5
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xc086100000000000,%rcx
+	0x10, 0x86, 0xc0,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm6
+	0xc4, 0xe2, 0x7d, 0x19, 0xf6, //vbroadcastsd %xmm6,%ymm6
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xfff0000000000000,%rcx
+	0x00, 0xf0, 0xff,
+	0xc4, 0x61, 0xf9, 0x6e, 0xc1, //vmovq  %rcx,%xmm8
+	0xc4, 0x42, 0x7d, 0x19, 0xc0, //vbroadcastsd %xmm8,%ymm8
+	0xc4, 0x41, 0x35, 0x57, 0xc9, //vxorpd %ymm9,%ymm9,%ymm9
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3df0000000000000,%rcx
+	0x00, 0xf0, 0x3d,
+	0xc4, 0x61, 0xf9, 0x6e, 0xd1, //vmovq  %rcx,%xmm10
+	0xc4, 0x42, 0x7d, 0x19, 0xd2, //vbroadcastsd %xmm10,%ymm10
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x41f0000000000000,%rcx
+	0x00, 0xf0, 0x41,
+	0xc4, 0x61, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm13
+	0xc4, 0x42, 0x7d, 0x19, 0xed, //vbroadcastsd %xmm13,%ymm13
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x4330000000000000,%rcx
+	0x00, 0x30, 0x43,
+	0xc4, 0x61, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm14
+	0xc4, 0x42, 0x7d, 0x19, 0xf6, //vbroadcastsd %xmm14,%ymm14
+	0x48, 0xb9, 0xff, 0xff, 0xff, 0xff, 0x00, //movabs $0xffffffff,%rcx
+	0x00, 0x00, 0x00,
+	0xc4, 0x61, 0xf9, 0x6e, 0xf9, //vmovq  %rcx,%xmm15
+	0xc4, 0x42, 0x7d, 0x19, 0xff //vbroadcastsd %xmm15,%ymm15
+};
+
+const unsigned char CODE_MULTI_LOAD_A_YMM1[] = {
+	0xc5, 0xfd, 0x10, 0x8f, 0xf8, 0xff, 0xff, //vmovupd 0x7ffffff8(%rdi),%ymm1
+	0x7f
+};
+
+const unsigned char CODE_MULTI_MAX_A_YMM1[] = {
+	0xc5, 0xf5, 0x5f, 0x8f, 0xf8, 0xff, 0xff, //vmaxpd 0x7ffffff8(%rdi),%ymm1,%ymm1
+	0x7f
+};
+
+const unsigned char CODE_MULTI_LOAD_A_YMM3[] = {
+	0xc5, 0xfd, 0x10, 0x9f, 0xf8, 0xff, 0xff, //vmovupd 0x7ffffff8(%rdi),%ymm3
+	0x7f
+};
+
+const unsigned char CODE_MULTI_SINGLETON[] = {
+	0xc5, 0xfd, 0x58, 0xc1 //vaddpd %ymm1,%ymm0,%ymm0
+};
+
+const unsigned char CODE_MULTI_SHIFT[] = {
+	0xc4, 0xc1, 0x75, 0xc2, 0xd8, 0x00, //vcmpeqpd %ymm8,%ymm1,%ymm3
+	0xc5, 0xe5, 0x55, 0xc9, //vandnpd %ymm1,%ymm3,%ymm1
+	0xc5, 0xed, 0x57, 0xd2 //vxorpd %ymm2,%ymm2,%ymm2
+};
+
+const unsigned char CODE_MULTI_EXP_CYCLE[] = {
+	0xc5, 0xe5, 0x5c, 0xd9, //vsubpd %ymm1,%ymm3,%ymm3
+	0xc5, 0xfd, 0x28, 0xfd, //vmovapd %ymm5,%ymm7
+	0xc4, 0xe2, 0xe5, 0xb8, 0xfc, //vfmadd231pd %ymm4,%ymm3,%ymm7
+	0xc4, 0xc1, 0x45, 0x5f, 0xf9, //vmaxpd %ymm9,%ymm7,%ymm7
+	0xc4, 0x41, 0x45, 0x59, 0xda, //vmulpd %ymm10,%ymm7,%ymm11
+	0xc4, 0x43, 0x7d, 0x09, 0xdb, 0x01, //vroundpd $0x1,%ymm11,%ymm11
+	0xc5, 0x7d, 0x28, 0xe7, //vmovapd %ymm7,%ymm12
+	0xc4, 0x42, 0xa5, 0xbc, 0xe5, //vfnmadd231pd %ymm13,%ymm11,%ymm12
+	0xc4, 0x43, 0x7d, 0x09, 0xe4, 0x01, //vroundpd $0x1,%ymm12,%ymm12
+	0xc4, 0x41, 0x25, 0x58, 0xde, //vaddpd %ymm14,%ymm11,%ymm11
+	0xc4, 0xc1, 0x25, 0x73, 0xf3, 0x20, //vpsllq $0x20,%ymm11,%ymm11
+	0xc4, 0x41, 0x1d, 0x58, 0xe6, //vaddpd %ymm14,%ymm12,%ymm12
+	0xc4, 0x41, 0x1d, 0xdb, 0xe7, //vpand  %ymm15,%ymm12,%ymm12
+	0xc4, 0xc1, 0x25, 0xeb, 0xfc, //vpor   %ymm12,%ymm11,%ymm7
+	0xc5, 0xe5, 0xc2, 0xde, 0x1d, //vcmpge_oqpd %ymm6,%ymm3,%ymm3
+	0xc5, 0xe5, 0x54, 0xdf, //vandpd %ymm7,%ymm3,%ymm3
+	0xc5, 0xed, 0x58, 0xd3, //vaddpd %ymm3,%ymm2,%ymm2
+	0xc3 //ret
+};
+
+const unsigned char CODE_MULTI_LOG[] = {
+	0xc5, 0xa5, 0x73, 0xd2, 0x20, //vpsrlq $0x20,%ymm2,%ymm11
+	0xc4, 0x41, 0x25, 0xeb, 0xde, //vpor   %ymm14,%ymm11,%ymm11
+	0xc4, 0x41, 0x25, 0x5c, 0xde, //vsubpd %ymm14,%ymm11,%ymm11
+	0xc4, 0x41, 0x6d, 0xdb, 0xe7, //vpand  %ymm15,%ymm2,%ymm12
+	0xc4, 0x41, 0x1d, 0xeb, 0xe6, //vpor   %ymm14,%ymm12,%ymm12
+	0xc4, 0x41, 0x1d, 0x5c, 0xe6, //vsubpd %ymm14,%ymm12,%ymm12
+	0xc4, 0x42, 0x9d, 0x98, 0xdd, //vfmadd132pd %ymm13,%ymm12,%ymm11
+	0x48, 0xb9, 0xef, 0x39, 0xfa, 0xfe, 0x42, //movabs $0x3ca62e42fefa39ef,%rcx
+	0x2e, 0xa6, 0x3c,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xd9, //vmovq  %rcx,%xmm3
+	0xc4, 0xe2, 0x7d, 0x19, 0xdb, //vbroadcastsd %xmm3,%ymm3
+	0x48, 0xb9, 0x20, 0x24, 0x35, 0x1e, 0x65, //movabs $0xc08628651e352420,%rcx
+	0x28, 0x86, 0xc0,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xf9, //vmovq  %rcx,%xmm7
+	0xc4, 0xe2, 0x7d, 0x19, 0xff, //vbroadcastsd %xmm7,%ymm7
+	0xc4, 0x62, 0xc5, 0x98, 0xdb, //vfmadd132pd %ymm3,%ymm7,%ymm11
+	0xc4, 0x41, 0x6d, 0xc2, 0xe1, 0x1e, //vcmpgt_oqpd %ymm9,%ymm2,%ymm12
+	0xc4, 0xc3, 0x3d, 0x4b, 0xd3, 0xc0, //vblendvpd %ymm12,%ymm11,%ymm8,%ymm2
+	0xc5, 0xed, 0x58, 0xd1, //vaddpd %ymm1,%ymm2,%ymm2
+	0xc5, 0xfd, 0x58, 0xc2, //vaddpd %ymm2,%ymm0,%ymm0
+	0xc3 //ret
+};
+
+const unsigned char CODE_MULTI_FOOTER[] = {
+	0xc5, 0xfd, 0x11, 0x06, //vmovupd %ymm0,(%rsi)
+	0xc5, 0xf8, 0x77, //vzeroupper
+	0xc3 //ret
+};
+
+
+
+#endif
@@ -0,0 +1,121 @@
+
+#ifndef JIT_SOFTMAX_TEMPLATES_H
+#define JIT_SOFTMAX_TEMPLATES_H 1
+
+
+const unsigned char CODE_STORE_E_0[] = {
+	0xc5, 0xfb, 0x11, 0x1e //vmovsd %xmm3,(%rsi)
+};
+
+const unsigned char CODE_STORE_E_1[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x08 //vmovsd %xmm3,0x8(%rsi)
+};
+
+const unsigned char CODE_STORE_E_2[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x10 //vmovsd %xmm3,0x10(%rsi)
+};
+
+const unsigned char CODE_STORE_E_3[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x18 //vmovsd %xmm3,0x18(%rsi)
+};
+
+const unsigned char CODE_STORE_E_4[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x20 //vmovsd %xmm3,0x20(%rsi)
+};
+
+const unsigned char CODE_STORE_E_5[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x28 //vmovsd %xmm3,0x28(%rsi)
+};
+
+const unsigned char CODE_STORE_E_6[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x30 //vmovsd %xmm3,0x30(%rsi)
+};
+
+const unsigned char CODE_STORE_E_7[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x38 //vmovsd %xmm3,0x38(%rsi)
+};
+
+const unsigned char CODE_STORE_E_8[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x40 //vmovsd %xmm3,0x40(%rsi)
+};
+
+const unsigned char CODE_STORE_E_9[] = {
+	0xc5, 0xfb, 0x11, 0x5e, 0x48 //vmovsd %xmm3,0x48(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_0[] = {
+	0xc5, 0x13, 0x59, 0x36, //vmulsd (%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x36 //vmovsd %xmm14,(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_1[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x08, //vmulsd 0x8(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x08 //vmovsd %xmm14,0x8(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_2[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x10, //vmulsd 0x10(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x10 //vmovsd %xmm14,0x10(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_3[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x18, //vmulsd 0x18(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x18 //vmovsd %xmm14,0x18(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_4[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x20, //vmulsd 0x20(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x20 //vmovsd %xmm14,0x20(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_5[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x28, //vmulsd 0x28(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x28 //vmovsd %xmm14,0x28(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_6[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x30, //vmulsd 0x30(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x30 //vmovsd %xmm14,0x30(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_7[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x38, //vmulsd 0x38(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x38 //vmovsd %xmm14,0x38(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_8[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x40, //vmulsd 0x40(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x40 //vmovsd %xmm14,0x40(%rsi)
+};
+
+const unsigned char CODE_SCALE_OUT_9[] = {
+	0xc5, 0x13, 0x59, 0x76, 0x48, //vmulsd 0x48(%rsi),%xmm13,%xmm14
+	0xc5, 0x7b, 0x11, 0x76, 0x48 //vmovsd %xmm14,0x48(%rsi)
+};
+
+const unsigned char CODE_INV_ACC[] = {
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3ff0000000000000,%rcx
+	0x00, 0xf0, 0x3f,
+	0xc4, 0x61, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm13
+	0x48, 0xb9, 0x59, 0xf3, 0xf8, 0xc2, 0x1f, //movabs $0x1a56e1fc2f8f359,%rcx
+	0x6e, 0xa5, 0x01,
+	0xc4, 0x61, 0xf9, 0x6e, 0xf1, //vmovq  %rcx,%xmm14
+	0xc4, 0x41, 0x6b, 0x5f, 0xf6, //vmaxsd %xmm14,%xmm2,%xmm14
+	0xc4, 0x41, 0x13, 0x5e, 0xee //vdivsd %xmm14,%xmm13,%xmm13
+};
+
+const unsigned char CODE_SOFTMAX_SINGLETON[] = {
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0x3ff0000000000000,%rcx
+	0x00, 0xf0, 0x3f,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe1, //vmovq  %rcx,%xmm4
+	0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, //movabs $0xfff0000000000000,%rcx
+	0x00, 0xf0, 0xff,
+	0xc4, 0xe1, 0xf9, 0x6e, 0xe9, //vmovq  %rcx,%xmm5
+	0xc5, 0xd3, 0xc2, 0xeb, 0x01, //vcmpltsd %xmm3,%xmm5,%xmm5
+	0xc5, 0xd1, 0x54, 0xec, //vandpd %xmm4,%xmm5,%xmm5
+	0xc5, 0xfb, 0x11, 0x2e //vmovsd %xmm5,(%rsi)
+};
+
+
+
+#endif
@@ -0,0 +1,293 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fast_approx.h"
+#include "simd_approx.h"
+#include "log_gemm.h"
+#include "lse_instrument.h"
+
+
+// the blocked product factors the shift out of the sum:
+//
+//     C[i,j] = log(sum_k exp(A[i,k] - ra[i]) * exp(B[k,j] - cb[j])) + ra[i] + cb[j]
+//
+// where ra[i] = max_k A[i,k] and cb[j] = max_k B[k,j]. ra[i] + cb[j] bounds
+// every term of output (i,j) from above, so the inner sum never overflows,
+// and the exps are taken once per input entry rather than once per term:
+// what is left is an ordinary real-valued gemm.
+//
+// if the bound is loose enough that the inner sum underflows (the largest
+// A[i,k] and largest B[k,j] are at different k), the entry is recomputed
+// with its own max, as in log_gemm_fast_naive.
+
+// register tile (rows x columns of C) and cache blocks
+#define LOG_GEMM_MR 4
+#define LOG_GEMM_NR 8
+#define LOG_GEMM_MC 64
+#define LOG_GEMM_KC 256
+#define LOG_GEMM_NC 512
+
+// smallest inner sum trusted without recomputing the entry. terms dropped
+// by fast_exp's clamp are below exp(-706), so relative to this they are
+// below exp(-106).
+#define LOG_GEMM_MIN_SUM (1e-260)
+
+
+void log_gemm_exact_naive(int n, int p, int q, const double *a, const double *b, double *c) {
+    double t, a_max, acc;
+    int i, j, k;
+    LSE_INSTRUMENT_START(t0);
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < q; ++j) {
+            a_max = -INFINITY;
+            for (k = 0; k < p; ++k) {
+                a_max = fmax(a[i * p + k] + b[k * q + j], a_max);
+            }
+            if (a_max <= -INFINITY || p <= 1) {
+                c[i * q + j] = a_max;
+                continue;
+            }
+            acc = 0.0;
+            for (k = 0; k < p; ++k) {
+                t = a[i * p + k] + b[k * q + j];
+                acc += exp(t - a_max);
+            }
+            c[i * q + j] = log(acc) + a_max;
+        }
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_GEMM_EXACT_NAIVE, t0);
+}
+
+
+static double log_gemm_fast_entry(int p, int q, const double *a_row, const double *b_col) {
+    double t, a_max, acc;
+    int k;
+    a_max = -INFINITY;
+    for (k = 0; k < p; ++k) {
+        a_max = fmax(a_row[k] + b_col[k * q], a_max);
+    }
+    if (a_max <= -INFINITY || p <= 1) {
+        return a_max;
+    }
+    acc = 0.0;
+    for (k = 0; k < p; ++k) {
+        t = a_row[k] + b_col[k * q];
+        acc += fast_exp(t - a_max);
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+void log_gemm_fast_naive(int n, int p, int q, const double *a, const double *b, double *c) {
+    int i, j;
+    LSE_INSTRUMENT_START(t0);
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < q; ++j) {
+            c[i * q + j] = log_gemm_fast_entry(p, q, a + i * p, b + j);
+        }
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_GEMM_FAST_NAIVE, t0);
+}
+
+
+static void pack_a(const double *ea, int n, int p, int ic, int pc, int mc, int kc, double *pa) {
+    // LOG_GEMM_MR rows at a time, interleaved along k, zero padded
+    int ir, ii, kk, i;
+    for (ir = 0; ir < mc; ir += LOG_GEMM_MR) {
+        for (kk = 0; kk < kc; ++kk) {
+            for (ii = 0; ii < LOG_GEMM_MR; ++ii) {
+                i = ic + ir + ii;
+                *pa++ = (ir + ii < mc && i < n) ? ea[i * p + pc + kk] : 0.0;
+            }
+        }
+    }
+}
+
+
+static void pack_b(const double *eb, int q, int pc, int jc, int kc, int nc, double *pb) {
+    // LOG_GEMM_NR columns at a time, contiguous along k, zero padded
+    int jr, jj, kk;
+    for (jr = 0; jr < nc; jr += LOG_GEMM_NR) {
+        for (kk = 0; kk < kc; ++kk) {
+            for (jj = 0; jj < LOG_GEMM_NR; ++jj) {
+                *pb++ = (jr + jj < nc) ? eb[(pc + kk) * q + jc + jr + jj] : 0.0;
+            }
+        }
+    }
+}
+
+
+static void micro_kernel(int kc, const double *pa, const double *pb, double *c, int ldc, int mr, int nr) {
+    // c[0:mr, 0:nr] += pa panel (LOG_GEMM_MR x kc) * pb panel (kc x LOG_GEMM_NR)
+    double tile[LOG_GEMM_MR * LOG_GEMM_NR];
+    int i, j, kk;
+#ifdef LSEA_HAVE_SIMD
+    __m256d c00, c01, c10, c11, c20, c21, c30, c31, b0, b1, av;
+    c00 = c01 = c10 = c11 = c20 = c21 = c30 = c31 = _mm256_setzero_pd();
+    for (kk = 0; kk < kc; ++kk) {
+        b0 = _mm256_loadu_pd(pb);
+        b1 = _mm256_loadu_pd(pb + 4);
+        av = _mm256_broadcast_sd(pa + 0);
+        c00 = _mm256_fmadd_pd(av, b0, c00);
+        c01 = _mm256_fmadd_pd(av, b1, c01);
+        av = _mm256_broadcast_sd(pa + 1);
+        c10 = _mm256_fmadd_pd(av, b0, c10);
+        c11 = _mm256_fmadd_pd(av, b1, c11);
+        av = _mm256_broadcast_sd(pa + 2);
+        c20 = _mm256_fmadd_pd(av, b0, c20);
+        c21 = _mm256_fmadd_pd(av, b1, c21);
+        av = _mm256_broadcast_sd(pa + 3);
+        c30 = _mm256_fmadd_pd(av, b0, c30);
+        c31 = _mm256_fmadd_pd(av, b1, c31);
+        pa += LOG_GEMM_MR;
+        pb += LOG_GEMM_NR;
+    }
+    _mm256_storeu_pd(tile + 0, c00);
+    _mm256_storeu_pd(tile + 4, c01);
+    _mm256_storeu_pd(tile + 8, c10);
+    _mm256_storeu_pd(tile + 12, c11);
+    _mm256_storeu_pd(tile + 16, c20);
+    _mm256_storeu_pd(tile + 20, c21);
+    _mm256_storeu_pd(tile + 24, c30);
+    _mm256_storeu_pd(tile + 28, c31);
+#else
+    memset(tile, 0, sizeof(tile));
+    for (kk = 0; kk < kc; ++kk) {
+        for (i = 0; i < LOG_GEMM_MR; ++i) {
+            for (j = 0; j < LOG_GEMM_NR; ++j) {
+                tile[i * LOG_GEMM_NR + j] += pa[i] * pb[j];
+            }
+        }
+        pa += LOG_GEMM_MR;
+        pb += LOG_GEMM_NR;
+    }
+#endif
+    for (i = 0; i < mr; ++i) {
+        for (j = 0; j < nr; ++j) {
+            c[i * ldc + j] += tile[i * LOG_GEMM_NR + j];
+        }
+    }
+}
+
+
+static void finish_row(int p, int q, const double *a_row, const double *b, double shift_a,
+        const double *shift_b, double *c_row) {
+    // c_row holds the inner sums on entry and the results on exit
+    int j;
+#ifdef LSEA_HAVE_SIMD
+    __m256d s, z;
+    int l, mask;
+    j = 0;
+    for (; j + 4 <= q; j += 4) {
+        s = _mm256_loadu_pd(c_row + j);
+        z = _mm256_add_pd(fast_log_pd(s), _mm256_set1_pd(shift_a));
+        z = _mm256_add_pd(z, _mm256_loadu_pd(shift_b + j));
+        _mm256_storeu_pd(c_row + j, z);
+        mask = _mm256_movemask_pd(_mm256_cmp_pd(s, _mm256_set1_pd(LOG_GEMM_MIN_SUM), _CMP_LT_OQ));
+        if (mask != 0) {
+            // rare: recompute the underflowed lanes with their own max
+            for (l = 0; l < 4; ++l) {
+                if (mask & (1 << l)) {
+                    c_row[j + l] = log_gemm_fast_entry(p, q, a_row, b + j + l);
+                }
+            }
+        }
+    }
+#else
+    j = 0;
+#endif
+    for (; j < q; ++j) {
+        if (c_row[j] < LOG_GEMM_MIN_SUM) {
+            c_row[j] = log_gemm_fast_entry(p, q, a_row, b + j);
+        } else {
+            c_row[j] = fast_log(c_row[j]) + shift_a + shift_b[j];
+        }
+    }
+}
+
+
+int log_gemm_blocked(int n, int p, int q, const double *a, const double *b, double *c) {
+    double *shift_a, *shift_b, *ea, *eb, *pa, *pb;
+    double t;
+    int i, j, k, ic, jc, pc, ir, jr, mc, nc, kc;
+    LSE_INSTRUMENT_START(t0);
+
+    shift_a = malloc(n * sizeof(double) + 1);
+    shift_b = malloc(q * sizeof(double) + 1);
+    ea = malloc((size_t)n * p * sizeof(double) + 1);
+    eb = malloc((size_t)p * q * sizeof(double) + 1);
+    pa = malloc(LOG_GEMM_MC * LOG_GEMM_KC * sizeof(double));
+    pb = malloc(LOG_GEMM_KC * (LOG_GEMM_NC + LOG_GEMM_NR) * sizeof(double));
+    if (shift_a == NULL || shift_b == NULL || ea == NULL || eb == NULL || pa == NULL || pb == NULL) {
+        free(shift_a);
+        free(shift_b);
+        free(ea);
+        free(eb);
+        free(pa);
+        free(pb);
+        return 2;
+    }
+
+    // per row / column maxima. an all -inf row or column is shifted by 0
+    // so its exps are 0 rather than nan.
+    for (i = 0; i < n; ++i) {
+        t = -INFINITY;
+        for (k = 0; k < p; ++k) {
+            t = fmax(a[i * p + k], t);
+        }
+        shift_a[i] = (t <= -INFINITY) ? 0.0 : t;
+        for (k = 0; k < p; ++k) {
+            ea[i * p + k] = fast_exp(a[i * p + k] - shift_a[i]);
+        }
+    }
+    for (j = 0; j < q; ++j) {
+        shift_b[j] = -INFINITY;
+    }
+    for (k = 0; k < p; ++k) {
+        for (j = 0; j < q; ++j) {
+            shift_b[j] = fmax(b[k * q + j], shift_b[j]);
+        }
+    }
+    for (j = 0; j < q; ++j) {
+        shift_b[j] = (shift_b[j] <= -INFINITY) ? 0.0 : shift_b[j];
+    }
+    for (k = 0; k < p; ++k) {
+        for (j = 0; j < q; ++j) {
+            eb[k * q + j] = fast_exp(b[k * q + j] - shift_b[j]);
+        }
+    }
+
+    memset(c, 0, (size_t)n * q * sizeof(double));
+    for (jc = 0; jc < q; jc += LOG_GEMM_NC) {
+        nc = (q - jc < LOG_GEMM_NC) ? q - jc : LOG_GEMM_NC;
+        for (pc = 0; pc < p; pc += LOG_GEMM_KC) {
+            kc = (p - pc < LOG_GEMM_KC) ? p - pc : LOG_GEMM_KC;
+            pack_b(eb, q, pc, jc, kc, nc, pb);
+            for (ic = 0; ic < n; ic += LOG_GEMM_MC) {
+                mc = (n - ic < LOG_GEMM_MC) ? n - ic : LOG_GEMM_MC;
+                pack_a(ea, n, p, ic, pc, mc, kc, pa);
+                for (jr = 0; jr < nc; jr += LOG_GEMM_NR) {
+                    for (ir = 0; ir < mc; ir += LOG_GEMM_MR) {
+                        micro_kernel(kc, pa + ir * kc, pb + jr * kc, c + (ic + ir) * q + jc + jr, q,
+                            (mc - ir < LOG_GEMM_MR) ? mc - ir : LOG_GEMM_MR,
+                            (nc - jr < LOG_GEMM_NR) ? nc - jr : LOG_GEMM_NR);
+                    }
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        finish_row(p, q, a + i * p, b, shift_a[i], shift_b, c + i * q);
+    }
+
+    free(shift_a);
+    free(shift_b);
+    free(ea);
+    free(eb);
+    free(pa);
+    free(pb);
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_GEMM_BLOCKED, t0);
+    return 0;
+}
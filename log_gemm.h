@@ -0,0 +1,22 @@
+#ifndef _LSEA_LOG_GEMM
+#define _LSEA_LOG_GEMM 1
+
+// matrix product in the log semiring:
+//
+//     C[i,j] = logsumexp_k(A[i,k] + B[k,j])
+//
+// A is n x p, B is p x q, C is n x q, all dense and row-major. this is the
+// core of hmm forward / backward.
+
+
+// reference: per-entry max, glibc exp and log
+void log_gemm_exact_naive(int n, int p, int q, const double *a, const double *b, double *c);
+
+// reference: per-entry max, fast_exp and fast_log
+void log_gemm_fast_naive(int n, int p, int q, const double *a, const double *b, double *c);
+
+// cache blocked and register tiled. returns 0 on success, 2 on allocation
+// failure.
+int log_gemm_blocked(int n, int p, int q, const double *a, const double *b, double *c);
+
+#endif
@@ -0,0 +1,2022 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "logsumexp.h"
+#include "simd_approx.h"
+#include "lse_instrument.h"
+
+
+double sum(double *a, int n) {
+    // preconditions:
+    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
+    double acc;
+    int i;
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += a[i];
+    }
+    return acc;
+}
+
+
+double log_sum_exp(double *a, int n) {
+    // preconditions:
+    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
+    double a_max, acc;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i], a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        return a_max;
+    }
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += exp(a[i] - a_max);
+    }
+    return log(acc) + a_max;
+}
+
+
+double fast_log_sum_exp(double *a, int n) {
+    // preconditions:
+    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
+    double a_max, acc;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i], a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        return a_max;
+    }
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += fast_exp(a[i] - a_max);
+    }
+    return log(acc) + a_max;
+}
+
+
+double faster_log_sum_exp(double *a, int n) {
+    // preconditions:
+    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
+    double a_max, acc;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i], a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        if (a_max <= -INFINITY) {
+            LSE_INSTRUMENT_EARLY_EXIT();
+        }
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(n);
+    // TODO: consider trick of biasing a_max to push more information into ieee exponent bits
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += fast_exp(a[i] - a_max);
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+static inline double faster_log_sum_exp_tier_n(double *a, int n, int tier) {
+    // as faster_log_sum_exp, at the given accuracy tier. called with
+    // constant tier (and often constant n), so each call site specialises.
+    double a_max, acc;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i], a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        if (a_max <= -INFINITY) {
+            LSE_INSTRUMENT_EARLY_EXIT();
+        }
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(n);
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += fast_exp_tier(a[i] - a_max, tier);
+    }
+    return fast_log_tier(acc, tier) + a_max;
+}
+
+
+double faster_log_sum_exp_table(double *a, int n) {
+    return faster_log_sum_exp_tier_n(a, n, APPROX_TIER_TABLE);
+}
+
+
+double faster_log_sum_exp_poly(double *a, int n) {
+    return faster_log_sum_exp_tier_n(a, n, APPROX_TIER_POLY);
+}
+
+
+static inline double bb_tier(range_t *ranges, const range_buckets_t *buckets, double *logps, int tier) {
+    const int *b = buckets->start;
+    double acc = 0.0;
+    int i;
+
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += -INFINITY;
+    }
+
+#define TIER_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        acc += faster_log_sum_exp_tier_n(&(logps[ranges[i].offset]), N, tier); \
+    }
+
+    TIER_BB_BUCKET(1)
+    TIER_BB_BUCKET(2)
+    TIER_BB_BUCKET(3)
+    TIER_BB_BUCKET(4)
+    TIER_BB_BUCKET(5)
+    TIER_BB_BUCKET(6)
+    TIER_BB_BUCKET(7)
+    TIER_BB_BUCKET(8)
+    TIER_BB_BUCKET(9)
+    TIER_BB_BUCKET(10)
+
+#undef TIER_BB_BUCKET
+
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        acc += faster_log_sum_exp_tier_n(&(logps[ranges[i].offset]), ranges[i].width, tier);
+    }
+    return acc;
+}
+
+
+double faster_log_sum_exp_bb_tier(range_t *ranges, const range_buckets_t *buckets, double *logps, int tier) {
+    // as faster_log_sum_exp_bb_buckets with a run time accuracy tier.
+    // tier is hoisted out of the loops: each branch is its own kernel.
+    double total;
+    LSE_INSTRUMENT_START(t0);
+    LSE_INSTRUMENT_BUCKETS(buckets, 0, MAX_BB_WIDTH + 1);
+    if (tier == APPROX_TIER_POLY) {
+        total = bb_tier(ranges, buckets, logps, APPROX_TIER_POLY);
+    } else if (tier == APPROX_TIER_TABLE) {
+        total = bb_tier(ranges, buckets, logps, APPROX_TIER_TABLE);
+    } else {
+        total = bb_tier(ranges, buckets, logps, APPROX_TIER_RAW);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_BB_TIER, t0);
+    return total;
+}
+
+
+#ifdef LSEA_HAVE_SIMD
+
+static inline __m256d log_sum_exp_group_n(const range_t *r, const double *logps, int n) {
+    // log_sum_exp of four ranges of width n, one range per lane.
+    // the k-th element of every range is gathered into one register.
+    // preconditions: 1 <= n <= MAX_BB_WIDTH
+    __m256d t[MAX_BB_WIDTH];
+    __m256d a_max, shift, acc, is_ninf;
+    __m128i idx;
+    int k;
+
+    idx = _mm_set_epi32(r[3].offset, r[2].offset, r[1].offset, r[0].offset);
+    a_max = _mm256_set1_pd(-INFINITY);
+    for (k = 0; k < n; ++k) {
+        t[k] = _mm256_i32gather_pd(logps + k, idx, 8);
+        a_max = _mm256_max_pd(a_max, t[k]);
+    }
+    if (n <= 1) {
+        return a_max;
+    }
+    // lanes whose terms are all -inf: shift by 0 so exp gives 0, not nan
+    is_ninf = _mm256_cmp_pd(a_max, _mm256_set1_pd(-INFINITY), _CMP_EQ_OQ);
+    shift = _mm256_andnot_pd(is_ninf, a_max);
+
+    acc = _mm256_setzero_pd();
+    for (k = 0; k < n; ++k) {
+        acc = _mm256_add_pd(acc, exact_exp_pd(_mm256_sub_pd(t[k], shift)));
+    }
+    return _mm256_add_pd(exact_log_pd(acc), shift);
+}
+
+#endif
+
+
+double log_sum_exp_bb_buckets(range_t *ranges, const range_buckets_t *buckets, double *logps) {
+    // as log_sum_exp over every range, vectorised across the ranges of
+    // each width bucket: four ranges at a time take one vector exp per
+    // element and one vector log. ranges of width 0 and ranges wider than
+    // MAX_BB_WIDTH, and the last few ranges of each bucket, go through
+    // the scalar log_sum_exp.
+    const int *b = buckets->start;
+    double acc = 0.0;
+    int i;
+#ifdef LSEA_HAVE_SIMD
+    __m256d vacc = _mm256_setzero_pd();
+#endif
+    LSE_INSTRUMENT_START(t0);
+    LSE_INSTRUMENT_BUCKETS(buckets, 0, MAX_BB_WIDTH + 1);
+
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += log_sum_exp(&(logps[ranges[i].offset]), 0);
+    }
+
+#ifdef LSEA_HAVE_SIMD
+#define EXACT_BB_BUCKET(N) \
+    for (i = b[N]; i + 4 <= b[N + 1]; i += 4) { \
+        vacc = _mm256_add_pd(vacc, log_sum_exp_group_n(&(ranges[i]), logps, N)); \
+    } \
+    for (; i < b[N + 1]; ++i) { \
+        acc += log_sum_exp(&(logps[ranges[i].offset]), N); \
+    }
+#else
+#define EXACT_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        acc += log_sum_exp(&(logps[ranges[i].offset]), N); \
+    }
+#endif
+
+    EXACT_BB_BUCKET(1)
+    EXACT_BB_BUCKET(2)
+    EXACT_BB_BUCKET(3)
+    EXACT_BB_BUCKET(4)
+    EXACT_BB_BUCKET(5)
+    EXACT_BB_BUCKET(6)
+    EXACT_BB_BUCKET(7)
+    EXACT_BB_BUCKET(8)
+    EXACT_BB_BUCKET(9)
+    EXACT_BB_BUCKET(10)
+
+#undef EXACT_BB_BUCKET
+
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        acc += log_sum_exp(&(logps[ranges[i].offset]), ranges[i].width);
+    }
+#ifdef LSEA_HAVE_SIMD
+    acc += simd_hsum_pd(vacc);
+#endif
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_BASEBB, t0);
+    return acc;
+}
+
+
+double faster_log_sum_exp_bb(range_t *ranges, double *logps, int n) {
+    // this version only supports ranges of with 1 -- 10.
+    // pre-req: input ranges ordered with nondecreasing width
+
+    // method       running time (s)
+    // ------
+    // faster       0.532
+    // fasterbb     0.421
+
+    double acc = 0.0;
+
+    int i = 0.0;
+
+    for(; i < n && ranges[i].width == 1; ++i) {
+        acc += faster_log_sum_exp_1(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 2; ++i) {
+        acc += faster_log_sum_exp_2(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 3; ++i) {
+        acc += faster_log_sum_exp_3(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 4; ++i) {
+        acc += faster_log_sum_exp_4(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 5; ++i) {
+        acc += faster_log_sum_exp_5(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 6; ++i) {
+        acc += faster_log_sum_exp_6(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 7; ++i) {
+        acc += faster_log_sum_exp_7(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 8; ++i) {
+        acc += faster_log_sum_exp_8(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 9; ++i) {
+        acc += faster_log_sum_exp_9(&(logps[ranges[i].offset]));
+    }
+    for(; i < n && ranges[i].width == 10; ++i) {
+        acc += faster_log_sum_exp_10(&(logps[ranges[i].offset]));
+    }
+    return acc;
+}
+
+
+double faster_log_sum_exp_bb_buckets(range_t *ranges, const range_buckets_t *buckets, double *logps) {
+    // as faster_log_sum_exp_bb, but loop bounds come from the planner's
+    // bucket boundaries rather than from rescanning ranges[i].width.
+    // ranges wider than MAX_BB_WIDTH are ignored, as in the bb kernel.
+
+    const int *b = buckets->start;
+    double acc = 0.0;
+    int i;
+    LSE_INSTRUMENT_START(t0);
+    LSE_INSTRUMENT_BUCKETS(buckets, 1, MAX_BB_WIDTH);
+
+    for (i = b[1]; i < b[2]; ++i) {
+        acc += faster_log_sum_exp_1(&(logps[ranges[i].offset]));
+    }
+    for (i = b[2]; i < b[3]; ++i) {
+        acc += faster_log_sum_exp_2(&(logps[ranges[i].offset]));
+    }
+    for (i = b[3]; i < b[4]; ++i) {
+        acc += faster_log_sum_exp_3(&(logps[ranges[i].offset]));
+    }
+    for (i = b[4]; i < b[5]; ++i) {
+        acc += faster_log_sum_exp_4(&(logps[ranges[i].offset]));
+    }
+    for (i = b[5]; i < b[6]; ++i) {
+        acc += faster_log_sum_exp_5(&(logps[ranges[i].offset]));
+    }
+    for (i = b[6]; i < b[7]; ++i) {
+        acc += faster_log_sum_exp_6(&(logps[ranges[i].offset]));
+    }
+    for (i = b[7]; i < b[8]; ++i) {
+        acc += faster_log_sum_exp_7(&(logps[ranges[i].offset]));
+    }
+    for (i = b[8]; i < b[9]; ++i) {
+        acc += faster_log_sum_exp_8(&(logps[ranges[i].offset]));
+    }
+    for (i = b[9]; i < b[10]; ++i) {
+        acc += faster_log_sum_exp_9(&(logps[ranges[i].offset]));
+    }
+    for (i = b[10]; i < b[11]; ++i) {
+        acc += faster_log_sum_exp_10(&(logps[ranges[i].offset]));
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_BB, t0);
+    return acc;
+}
+
+
+double faster_log_sum_exp_bb_prefetch(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        int group, int distance) {
+    // as faster_log_sum_exp_bb_buckets, for data too large for the caches.
+    // ranges are taken in groups of group: before a group is computed,
+    // the first and last element of each range of the group distance
+    // ranges ahead are prefetched, so their misses overlap the work on
+    // this group rather than each stalling a range in turn.
+    // pre-req: group >= 1, distance >= 0.
+    const int *b = buckets->start;
+    double acc = 0.0;
+    int i, j, i_end, j_end;
+    LSE_INSTRUMENT_START(t0);
+
+#define PREFETCH_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; i = i_end) { \
+        i_end = (i + group < b[N + 1]) ? i + group : b[N + 1]; \
+        j_end = (i_end + distance < b[N + 1]) ? i_end + distance : b[N + 1]; \
+        for (j = i + distance; j < j_end; ++j) { \
+            __builtin_prefetch(&(logps[ranges[j].offset])); \
+            __builtin_prefetch(&(logps[ranges[j].offset + N - 1])); \
+        } \
+        for (j = i; j < i_end; ++j) { \
+            acc += faster_log_sum_exp_##N(&(logps[ranges[j].offset])); \
+        } \
+    }
+
+    PREFETCH_BB_BUCKET(1)
+    PREFETCH_BB_BUCKET(2)
+    PREFETCH_BB_BUCKET(3)
+    PREFETCH_BB_BUCKET(4)
+    PREFETCH_BB_BUCKET(5)
+    PREFETCH_BB_BUCKET(6)
+    PREFETCH_BB_BUCKET(7)
+    PREFETCH_BB_BUCKET(8)
+    PREFETCH_BB_BUCKET(9)
+    PREFETCH_BB_BUCKET(10)
+
+#undef PREFETCH_BB_BUCKET
+
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_PREFETCH, t0);
+    return acc;
+}
+
+
+// every non-empty width bucket is first sampled this many times (or in
+// full, if smaller), to estimate its variance.
+#define SAMPLE_PILOT 32
+
+typedef struct {
+    int k;          // ranges sampled so far
+    double mean;    // of their log-sum-exp
+    double m2;      // sum of squared deviations from mean (welford)
+} sample_stratum_t;
+
+
+static inline void sample_bucket_n(range_t *ranges, double *logps, int lo, int hi, int *perm,
+        sample_stratum_t *s, int count, unsigned long *x, int n) {
+    // draw count more ranges of width n from [lo, hi) without
+    // replacement: perm[lo .. lo + s->k) holds those drawn so far, as in
+    // a partial fisher-yates shuffle.
+    double v, delta;
+    int c, j, t;
+
+    for (c = 0; c < count; ++c) {
+        *x = *x * 6364136223846793005ul + 1442695040888963407ul;
+        j = lo + s->k + (int)(((*x >> 32) * (unsigned long)(hi - lo - s->k)) >> 32);
+        t = perm[lo + s->k];
+        perm[lo + s->k] = perm[j];
+        perm[j] = t;
+        v = faster_log_sum_exp_tier_n(&(logps[ranges[perm[lo + s->k]].offset]), n, APPROX_TIER_RAW);
+        ++(s->k);
+        delta = v - s->mean;
+        s->mean += delta / s->k;
+        s->m2 += delta * (v - s->mean);
+    }
+}
+
+
+static void sample_bucket(range_t *ranges, const range_buckets_t *buckets, double *logps, int *perm,
+        sample_stratum_t *s, int w, int count, unsigned long *x) {
+    // dispatch to a loop specialised for width w
+    const int *b = buckets->start;
+
+    switch (w) {
+#define SAMPLE_BB_BUCKET(N) \
+    case N: \
+        sample_bucket_n(ranges, logps, b[N], b[N + 1], perm, s, count, x, N); \
+        break;
+
+    SAMPLE_BB_BUCKET(1)
+    SAMPLE_BB_BUCKET(2)
+    SAMPLE_BB_BUCKET(3)
+    SAMPLE_BB_BUCKET(4)
+    SAMPLE_BB_BUCKET(5)
+    SAMPLE_BB_BUCKET(6)
+    SAMPLE_BB_BUCKET(7)
+    SAMPLE_BB_BUCKET(8)
+    SAMPLE_BB_BUCKET(9)
+    SAMPLE_BB_BUCKET(10)
+
+#undef SAMPLE_BB_BUCKET
+    }
+}
+
+
+int faster_log_sum_exp_bb_sample(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        double rel_err, double z, unsigned long seed, sample_estimate_t *est) {
+    // estimate the total of faster_log_sum_exp_bb_buckets from a sample of
+    // the ranges, stratified by width bucket. after a pilot sample of each
+    // bucket, the sample size that meets the target is estimated from the
+    // variances seen so far, and the shortfall is drawn, split over the
+    // buckets in proportion to size times standard deviation (neyman
+    // allocation). this repeats until z standard errors are within rel_err
+    // of the estimate. a bucket sampled in full is exact, so at worst every range
+    // is evaluated once. z = 1.96 gives a 95% confidence interval. stops
+    // early if the estimate is not finite.
+    // returns 0 on success, 1 on negative rel_err or z, 2 on allocation
+    // failure.
+    const int *b = buckets->start;
+    sample_stratum_t s[MAX_BB_WIDTH + 1];
+    double size, total, var, sd, weight, weights, weights2, target, batch, open;
+    unsigned long x = seed;
+    int *perm;
+    int i, w, count;
+    LSE_INSTRUMENT_START(t0);
+
+    if (!(rel_err >= 0.0) || !(z >= 0.0)) {
+        return 1;
+    }
+    // perm is indexed by position in ranges
+    perm = malloc(b[MAX_BB_WIDTH + 1] * sizeof(int) + 1);
+    if (perm == NULL) {
+        return 2;
+    }
+    for (i = b[1]; i < b[MAX_BB_WIDTH + 1]; ++i) {
+        perm[i] = i;
+    }
+
+    memset(s, 0, sizeof(s));
+    est->n_sampled = 0;
+    est->n_ranges = b[MAX_BB_WIDTH + 1] - b[1];
+    for (w = 1; w <= MAX_BB_WIDTH; ++w) {
+        count = b[w + 1] - b[w];
+        count = (count < SAMPLE_PILOT) ? count : SAMPLE_PILOT;
+        sample_bucket(ranges, buckets, logps, perm, &(s[w]), w, count, &x);
+        est->n_sampled += count;
+    }
+
+    for (;;) {
+        total = 0.0;
+        var = 0.0;
+        for (w = 1; w <= MAX_BB_WIDTH; ++w) {
+            size = (double)(b[w + 1] - b[w]);
+            if (s[w].k == 0) {
+                continue;
+            }
+            total += size * s[w].mean;
+            if (s[w].k > 1) {
+                // with the finite population correction, 0 once exhausted
+                var += size * size * (1.0 - s[w].k / size) * s[w].m2 / (s[w].k - 1) / s[w].k;
+            }
+        }
+        est->estimate = total;
+        est->half_width = z * sqrt(var);
+        if (!isfinite(total) || est->half_width <= rel_err * fabs(total)) {
+            break;
+        }
+
+        // over the buckets not yet exhausted, the neyman sample size for a
+        // variance of (rel_err * total / z)^2 is weights^2 / (that + weights2)
+        weights = 0.0;
+        weights2 = 0.0;
+        open = 0.0;
+        for (w = 1; w <= MAX_BB_WIDTH; ++w) {
+            if (s[w].k > 1 && s[w].k < b[w + 1] - b[w]) {
+                open += s[w].k;
+                sd = sqrt(s[w].m2 / (s[w].k - 1));
+                weights += (b[w + 1] - b[w]) * sd;
+                weights2 += (b[w + 1] - b[w]) * sd * sd;
+            }
+        }
+        if (!(weights > 0.0)) {
+            break;
+        }
+        sd = rel_err * fabs(total) / z;
+        target = weights * weights / (sd * sd + weights2);
+        // draw at least a little, in case the estimates still fall short
+        batch = target - open;
+        batch = (batch > open / 8 + 1) ? batch : open / 8 + 1;
+        for (w = 1; w <= MAX_BB_WIDTH; ++w) {
+            if (s[w].k <= 1 || s[w].k >= b[w + 1] - b[w]) {
+                continue;
+            }
+            sd = sqrt(s[w].m2 / (s[w].k - 1));
+            weight = (b[w + 1] - b[w]) * sd / weights;
+            count = (int)ceil(batch * weight);
+            count = (count < b[w + 1] - b[w] - s[w].k) ? count : b[w + 1] - b[w] - s[w].k;
+            sample_bucket(ranges, buckets, logps, perm, &(s[w]), w, count, &x);
+            est->n_sampled += count;
+        }
+    }
+
+    free(perm);
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_SAMPLE, t0);
+    return 0;
+}
+
+
+double faster_log_sum_exp_bb_tiled(range_t *ranges, const range_tiles_t *tiles, double *logps) {
+    // as faster_log_sum_exp_bb_buckets over a pattern from
+    // sort_ranges_tiled. each tile runs the width-specialised loops over a
+    // window of data small enough to stay cached, instead of each width
+    // sweeping all of logps and evicting what the next width rereads.
+    double acc = 0.0;
+    int t;
+    LSE_INSTRUMENT_START(t0);
+
+    for (t = 0; t < tiles->n_tiles; ++t) {
+        acc += faster_log_sum_exp_bb_buckets(ranges, &(tiles->buckets[t]), logps);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_TILED, t0);
+    return acc;
+}
+
+
+size_t encode_varint(unsigned char *p, unsigned int x) {
+    // LEB128-style: 7 bits per byte, high bit set on all but the last byte.
+    // returns number of bytes written. p may be NULL to only measure.
+    size_t k = 0;
+    while (x >= 0x80) {
+        if (p != NULL) {
+            p[k] = (unsigned char)(x | 0x80);
+        }
+        x >>= 7;
+        ++k;
+    }
+    if (p != NULL) {
+        p[k] = (unsigned char)x;
+    }
+    return k + 1;
+}
+
+
+static inline const unsigned char *decode_varint(const unsigned char *p, int *x) {
+    unsigned int v, b;
+    int shift;
+    b = *p++;
+    if (b < 0x80) {
+        // common case: delta fits in one byte
+        *x = (int)b;
+        return p;
+    }
+    v = b & 0x7f;
+    shift = 7;
+    do {
+        b = *p++;
+        v |= (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    *x = (int)v;
+    return p;
+}
+
+
+int make_compact_ranges(range_t *ranges, int n, compact_ranges_t *cr) {
+    // pre-req: input ranges ordered with nondecreasing width, and
+    // nondecreasing offset within each width. widths 1 -- 10 only.
+    // returns 0 on success, 1 if the input violates the pre-req, 2 on
+    // allocation failure.
+    int i, w, prev_w, prev_offset;
+    size_t size, iota;
+
+    memset(cr->count, 0, sizeof(cr->count));
+    cr->deltas = NULL;
+    cr->size = 0;
+
+    size = 0;
+    prev_w = 0;
+    prev_offset = 0;
+    for (i = 0; i < n; ++i) {
+        w = ranges[i].width;
+        if (w < 1 || w > MAX_BB_WIDTH || w < prev_w) {
+            return 1;
+        }
+        if (w != prev_w) {
+            prev_w = w;
+            prev_offset = 0;
+        }
+        if (ranges[i].offset < prev_offset) {
+            return 1;
+        }
+        size += encode_varint(NULL, (unsigned int)(ranges[i].offset - prev_offset));
+        prev_offset = ranges[i].offset;
+        cr->count[w] += 1;
+    }
+
+    // pad so the decoder never reads past the end of the allocation
+    cr->deltas = malloc(size + 1);
+    if (cr->deltas == NULL) {
+        memset(cr->count, 0, sizeof(cr->count));
+        return 2;
+    }
+
+    iota = 0;
+    prev_w = 0;
+    prev_offset = 0;
+    for (i = 0; i < n; ++i) {
+        if (ranges[i].width != prev_w) {
+            prev_w = ranges[i].width;
+            prev_offset = 0;
+        }
+        iota += encode_varint(cr->deltas + iota, (unsigned int)(ranges[i].offset - prev_offset));
+        prev_offset = ranges[i].offset;
+    }
+    cr->deltas[iota] = 0;
+    cr->size = size;
+    return 0;
+}
+
+
+void release_compact_ranges(compact_ranges_t *cr) {
+    free(cr->deltas);
+    cr->deltas = NULL;
+    cr->size = 0;
+    memset(cr->count, 0, sizeof(cr->count));
+}
+
+
+double faster_log_sum_exp_bb_compact(const compact_ranges_t *cr, double *logps) {
+    // as faster_log_sum_exp_bb, but walks the compact encoding of the
+    // ranges, decoding offsets on the fly. the range stream shrinks from
+    // 8 bytes per range to typically 1 byte per range.
+
+    const unsigned char *p = cr->deltas;
+    const double *a;
+    double acc = 0.0;
+    int k, delta;
+    LSE_INSTRUMENT_START(t0);
+
+    for (a = logps, k = 0; k < cr->count[1]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_1(a);
+    }
+    for (a = logps, k = 0; k < cr->count[2]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_2(a);
+    }
+    for (a = logps, k = 0; k < cr->count[3]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_3(a);
+    }
+    for (a = logps, k = 0; k < cr->count[4]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_4(a);
+    }
+    for (a = logps, k = 0; k < cr->count[5]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_5(a);
+    }
+    for (a = logps, k = 0; k < cr->count[6]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_6(a);
+    }
+    for (a = logps, k = 0; k < cr->count[7]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_7(a);
+    }
+    for (a = logps, k = 0; k < cr->count[8]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_8(a);
+    }
+    for (a = logps, k = 0; k < cr->count[9]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_9(a);
+    }
+    for (a = logps, k = 0; k < cr->count[10]; ++k) {
+        p = decode_varint(p, &delta); a += delta;
+        acc += faster_log_sum_exp_10(a);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_COMPACT, t0);
+    return acc;
+}
+
+
+static inline unsigned int zigzag(int x) {
+    // small signed deltas to small unsigned ones: 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+    return ((unsigned int)x << 1) ^ (unsigned int)(x >> 31);
+}
+
+
+static inline int unzigzag(int z) {
+    return (int)(((unsigned int)z >> 1) ^ -((unsigned int)z & 1));
+}
+
+
+int make_bytecode(range_t *ranges, int n, bytecode_t *bc) {
+    // compile ranges, in the given order, to bytecode. any order works,
+    // but ranges sorted as by compare_ranges keep the deltas small and the
+    // dispatch predictable.
+    // returns 0 on success, 1 on negative width, 2 on allocation failure.
+    int i, w, prev_offset;
+    size_t size, iota;
+
+    bc->code = NULL;
+    bc->size = 0;
+
+    size = 1;
+    prev_offset = 0;
+    for (i = 0; i < n; ++i) {
+        w = ranges[i].width;
+        if (w < 0) {
+            return 1;
+        }
+        size += 1;
+        if (w < 1 || w > MAX_BB_WIDTH) {
+            size += encode_varint(NULL, (unsigned int)w);
+        }
+        size += encode_varint(NULL, zigzag(ranges[i].offset - prev_offset));
+        prev_offset = ranges[i].offset;
+    }
+
+    bc->code = malloc(size);
+    if (bc->code == NULL) {
+        return 2;
+    }
+    iota = 0;
+    prev_offset = 0;
+    for (i = 0; i < n; ++i) {
+        w = ranges[i].width;
+        if (w < 1 || w > MAX_BB_WIDTH) {
+            bc->code[iota++] = BYTECODE_OP_WIDE;
+            iota += encode_varint(bc->code + iota, (unsigned int)w);
+        } else {
+            bc->code[iota++] = (unsigned char)w;
+        }
+        iota += encode_varint(bc->code + iota, zigzag(ranges[i].offset - prev_offset));
+        prev_offset = ranges[i].offset;
+    }
+    bc->code[iota++] = BYTECODE_OP_HALT;
+    bc->size = iota;
+    return 0;
+}
+
+
+void release_bytecode(bytecode_t *bc) {
+    free(bc->code);
+    bc->code = NULL;
+    bc->size = 0;
+}
+
+
+double faster_log_sum_exp_interp(const bytecode_t *bc, double *logps) {
+    // run the bytecode with a direct-threaded dispatcher: each handler is
+    // a faster_log_sum_exp_N body that ends by jumping straight to the
+    // handler of the next opcode, so every handler has its own indirect
+    // branch to predict. a middle ground between faster_log_sum_exp_bb and
+    // the jit that needs no executable memory, and whose code size does
+    // not grow with the pattern.
+    static void *dispatch[] = {
+        &&op_halt,
+        &&op_1, &&op_2, &&op_3, &&op_4, &&op_5,
+        &&op_6, &&op_7, &&op_8, &&op_9, &&op_10,
+        &&op_wide,
+    };
+    const unsigned char *p = bc->code;
+    const double *a = logps;
+    double acc = 0.0;
+    int delta, w;
+    LSE_INSTRUMENT_START(t0);
+
+    goto *dispatch[*p++];
+
+op_1:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_1(a);
+    goto *dispatch[*p++];
+op_2:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_2(a);
+    goto *dispatch[*p++];
+op_3:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_3(a);
+    goto *dispatch[*p++];
+op_4:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_4(a);
+    goto *dispatch[*p++];
+op_5:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_5(a);
+    goto *dispatch[*p++];
+op_6:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_6(a);
+    goto *dispatch[*p++];
+op_7:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_7(a);
+    goto *dispatch[*p++];
+op_8:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_8(a);
+    goto *dispatch[*p++];
+op_9:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_9(a);
+    goto *dispatch[*p++];
+op_10:
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp_10(a);
+    goto *dispatch[*p++];
+op_wide:
+    p = decode_varint(p, &w);
+    p = decode_varint(p, &delta); a += unzigzag(delta);
+    acc += faster_log_sum_exp((double *)a, w);
+    goto *dispatch[*p++];
+op_halt:
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_INTERP, t0);
+    return acc;
+}
+
+
+int make_block_maxima(const double *logps, int m, block_maxima_t *bm) {
+    // returns 0 on success, 2 on allocation failure.
+    bm->n_blocks = (m + (1 << BLOCK_MAX_SHIFT) - 1) >> BLOCK_MAX_SHIFT;
+    bm->max = malloc(bm->n_blocks * sizeof(double) + 1);
+    if (bm->max == NULL) {
+        bm->n_blocks = 0;
+        return 2;
+    }
+    update_block_maxima(logps, m, bm);
+    return 0;
+}
+
+
+void update_block_maxima(const double *logps, int m, block_maxima_t *bm) {
+    // call whenever logps changes. pre-req: bm made for the same m.
+    double a_max;
+    int k, i, i_end;
+    for (k = 0; k < bm->n_blocks; ++k) {
+        i_end = (k + 1) << BLOCK_MAX_SHIFT;
+        if (i_end > m) {
+            i_end = m;
+        }
+        a_max = -INFINITY;
+        for (i = k << BLOCK_MAX_SHIFT; i < i_end; ++i) {
+            a_max = fmax(logps[i], a_max);
+        }
+        bm->max[k] = a_max;
+    }
+}
+
+
+void release_block_maxima(block_maxima_t *bm) {
+    free(bm->max);
+    bm->max = NULL;
+    bm->n_blocks = 0;
+}
+
+
+// smallest shifted sum trusted by faster_log_sum_exp_bb_blockmax. below
+// this the range max is too far under its block max, and the range is
+// recomputed with its own max.
+#define BLOCK_MAX_MIN_SUM (1e-260)
+
+
+static inline double faster_log_sum_exp_shifted_n(double *a, int n, double shift) {
+    // as faster_log_sum_exp, but shifts by a given upper bound on max(a)
+    // rather than taking a pass to find max(a). called with constant n
+    // from the bucket loops, so each call site specialises.
+    double acc;
+    int i;
+    if (n <= 1) {
+        return (n == 1) ? a[0] : -INFINITY;
+    }
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += fast_exp(a[i] - shift);
+    }
+    // also catches all -inf ranges, and shift = -inf (nan exps are 0)
+    if (acc < BLOCK_MAX_MIN_SUM) {
+        return faster_log_sum_exp(a, n);
+    }
+    return fast_log(acc) + shift;
+}
+
+
+double faster_log_sum_exp_bb_blockmax(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        const block_maxima_t *bm) {
+    // as faster_log_sum_exp_bb_buckets, without the per-range max pass.
+    // pre-req: bm up to date with logps.
+    //
+    // the shift of a range is the largest max of the blocks it meets: an
+    // upper bound on the range max that is usually close to it.
+
+    const int *b = buckets->start;
+    const double *block_max = bm->max;
+    double acc = 0.0, shift;
+    int i, k, o;
+    LSE_INSTRUMENT_START(t0);
+
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += -INFINITY;
+    }
+
+#define BLOCKMAX_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        o = ranges[i].offset; \
+        shift = fmax(block_max[o >> BLOCK_MAX_SHIFT], block_max[(o + N - 1) >> BLOCK_MAX_SHIFT]); \
+        acc += faster_log_sum_exp_shifted_n(&(logps[o]), N, shift); \
+    }
+
+    for (i = b[1]; i < b[2]; ++i) {
+        acc += faster_log_sum_exp_1(&(logps[ranges[i].offset]));
+    }
+    BLOCKMAX_BB_BUCKET(2)
+    BLOCKMAX_BB_BUCKET(3)
+    BLOCKMAX_BB_BUCKET(4)
+    BLOCKMAX_BB_BUCKET(5)
+    BLOCKMAX_BB_BUCKET(6)
+    BLOCKMAX_BB_BUCKET(7)
+    BLOCKMAX_BB_BUCKET(8)
+    BLOCKMAX_BB_BUCKET(9)
+    BLOCKMAX_BB_BUCKET(10)
+
+#undef BLOCKMAX_BB_BUCKET
+
+    // wider ranges meet more blocks, still far fewer than elements
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        o = ranges[i].offset;
+        shift = -INFINITY;
+        for (k = o >> BLOCK_MAX_SHIFT; k <= (o + ranges[i].width - 1) >> BLOCK_MAX_SHIFT; ++k) {
+            shift = fmax(block_max[k], shift);
+        }
+        acc += faster_log_sum_exp_shifted_n(&(logps[o]), ranges[i].width, shift);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_BLOCKMAX, t0);
+    return acc;
+}
+
+
+// terms this far below the range max are dropped by the pruned kernels:
+// exp(-37) < 2^-53, so each would change the sum by under half an ulp of
+// its largest term. dropping them costs at most width * exp(-37) relative.
+#define PRUNE_MIN_ARG (-37.0)
+
+
+static double faster_log_sum_exp_pruned(const double *logps, int o, int w, const double *block_max) {
+    // faster_log_sum_exp of logps[o .. o + w), skipping every block whose
+    // max lies below the range max by more than -PRUNE_MIN_ARG. the max is
+    // exact: scanned over the partial blocks at the ends and read from the
+    // block maxima in between. so a wide range dominated by a few large
+    // entries costs little more than its significant blocks.
+    const int end = o + w;
+    double a_max, cutoff, acc;
+    int i, i_end, k, k0, k1;
+
+    if (w <= 1) {
+        return (w == 1) ? logps[o] : -INFINITY;
+    }
+    k0 = o >> BLOCK_MAX_SHIFT;
+    k1 = (end - 1) >> BLOCK_MAX_SHIFT;
+    a_max = -INFINITY;
+    i_end = (k0 == k1) ? end : (k0 + 1) << BLOCK_MAX_SHIFT;
+    for (i = o; i < i_end; ++i) {
+        a_max = fmax(logps[i], a_max);
+    }
+    for (k = k0 + 1; k < k1; ++k) {
+        a_max = fmax(block_max[k], a_max);
+    }
+    for (i = (k0 == k1) ? end : k1 << BLOCK_MAX_SHIFT; i < end; ++i) {
+        a_max = fmax(logps[i], a_max);
+    }
+    if (a_max <= -INFINITY) {
+        return a_max;
+    }
+
+    cutoff = a_max + PRUNE_MIN_ARG;
+    acc = 0.0;
+    for (k = k0; k <= k1; ++k) {
+        if (block_max[k] < cutoff) {
+            continue;
+        }
+        i = (k << BLOCK_MAX_SHIFT > o) ? k << BLOCK_MAX_SHIFT : o;
+        i_end = ((k + 1) << BLOCK_MAX_SHIFT < end) ? (k + 1) << BLOCK_MAX_SHIFT : end;
+        for (; i < i_end; ++i) {
+            acc += fast_exp(logps[i] - a_max);
+        }
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+double faster_log_sum_exp_bb_pruned(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        const block_maxima_t *bm) {
+    // as faster_log_sum_exp_bb_tier at the raw tier, but ranges wider than
+    // MAX_BB_WIDTH skip the blocks of negligible terms. narrower ranges
+    // meet at most two blocks, so gain nothing and run as usual.
+    // pre-req: bm up to date with logps.
+    const int *b = buckets->start;
+    double acc = 0.0;
+    int i;
+    LSE_INSTRUMENT_START(t0);
+
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += -INFINITY;
+    }
+    acc += faster_log_sum_exp_bb_buckets(ranges, buckets, logps);
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        acc += faster_log_sum_exp_pruned(logps, ranges[i].offset, ranges[i].width, bm->max);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_PRUNED, t0);
+    return acc;
+}
+
+
+int make_exp_cache(const double *logps, int m, exp_cache_t *ec) {
+    // returns 0 on success, 2 on allocation failure.
+    ec->e = malloc(m * sizeof(double) + 1);
+    if (ec->e == NULL || make_block_maxima(logps, m, &(ec->bm)) != 0) {
+        free(ec->e);
+        ec->e = NULL;
+        return 2;
+    }
+    update_exp_cache(logps, m, ec);
+    return 0;
+}
+
+
+void update_exp_cache(const double *logps, int m, exp_cache_t *ec) {
+    // call whenever logps changes: m exps, once, instead of one per
+    // element of every range per evaluation.
+    double shift;
+    int k, i, i_end;
+    update_block_maxima(logps, m, &(ec->bm));
+    for (k = 0; k < ec->bm.n_blocks; ++k) {
+        i_end = (k + 1) << BLOCK_MAX_SHIFT;
+        if (i_end > m) {
+            i_end = m;
+        }
+        // all -inf block: shift by 0 so e is 0 rather than nan
+        shift = (ec->bm.max[k] <= -INFINITY) ? 0.0 : ec->bm.max[k];
+        for (i = k << BLOCK_MAX_SHIFT; i < i_end; ++i) {
+            ec->e[i] = fast_exp(logps[i] - shift);
+        }
+    }
+}
+
+
+void release_exp_cache(exp_cache_t *ec) {
+    release_block_maxima(&(ec->bm));
+    free(ec->e);
+    ec->e = NULL;
+}
+
+
+static inline double faster_log_sum_exp_cached_n(double *a, const double *e, int o, int n,
+        const double *block_max) {
+    // log-sum-exp of a[o .. o+n) from the exp cache. the range meets
+    // blocks k1 <= k2; the sum over the block with the smaller max is
+    // rescaled onto the larger one with a single fast_exp.
+    double s1, s2, m1, m2, f;
+    int i, split;
+    if (n <= 1) {
+        return (n == 1) ? a[o] : -INFINITY;
+    }
+    m1 = block_max[o >> BLOCK_MAX_SHIFT];
+    m2 = block_max[(o + n - 1) >> BLOCK_MAX_SHIFT];
+    // elements before split are in block k1
+    split = (((o + n - 1) >> BLOCK_MAX_SHIFT) << BLOCK_MAX_SHIFT) - o;
+    if (split <= 0) {
+        split = n;
+    }
+    s1 = 0.0;
+    s2 = 0.0;
+    for (i = 0; i < n; ++i) {
+        s1 += (i < split) ? e[o + i] : 0.0;
+        s2 += (i < split) ? 0.0 : e[o + i];
+    }
+    // nan (both blocks -inf) and -inf differences give f = 0
+    f = fast_exp(-fabs(m1 - m2));
+    if (m1 >= m2) {
+        s1 += s2 * f;
+    } else {
+        s1 = s1 * f + s2;
+        m1 = m2;
+    }
+    if (s1 < BLOCK_MAX_MIN_SUM) {
+        return faster_log_sum_exp(a + o, n);
+    }
+    return fast_log(s1) + m1;
+}
+
+
+double faster_log_sum_exp_bb_expcache(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        const exp_cache_t *ec) {
+    // as faster_log_sum_exp_bb_buckets, reading exps from the cache.
+    // pre-req: ec up to date with logps.
+    //
+    // per range this is a sum, at most one fast_exp and one fast_log.
+
+    const int *b = buckets->start;
+    double acc = 0.0, shift, s, t;
+    int i, k, k_end, o, j, j_end;
+    LSE_INSTRUMENT_START(t0);
+
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += -INFINITY;
+    }
+
+#define EXPCACHE_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        acc += faster_log_sum_exp_cached_n(logps, ec->e, ranges[i].offset, N, ec->bm.max); \
+    }
+
+    EXPCACHE_BB_BUCKET(1)
+    EXPCACHE_BB_BUCKET(2)
+    EXPCACHE_BB_BUCKET(3)
+    EXPCACHE_BB_BUCKET(4)
+    EXPCACHE_BB_BUCKET(5)
+    EXPCACHE_BB_BUCKET(6)
+    EXPCACHE_BB_BUCKET(7)
+    EXPCACHE_BB_BUCKET(8)
+    EXPCACHE_BB_BUCKET(9)
+    EXPCACHE_BB_BUCKET(10)
+
+#undef EXPCACHE_BB_BUCKET
+
+    // wider ranges: rescale each block's partial sum onto the largest max
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        o = ranges[i].offset;
+        k_end = (o + ranges[i].width - 1) >> BLOCK_MAX_SHIFT;
+        shift = -INFINITY;
+        for (k = o >> BLOCK_MAX_SHIFT; k <= k_end; ++k) {
+            shift = fmax(ec->bm.max[k], shift);
+        }
+        s = 0.0;
+        j = o;
+        for (k = o >> BLOCK_MAX_SHIFT; k <= k_end; ++k) {
+            j_end = (k + 1) << BLOCK_MAX_SHIFT;
+            if (j_end > o + ranges[i].width) {
+                j_end = o + ranges[i].width;
+            }
+            t = 0.0;
+            for (; j < j_end; ++j) {
+                t += ec->e[j];
+            }
+            s += t * fast_exp(ec->bm.max[k] - shift);
+        }
+        acc += (s < BLOCK_MAX_MIN_SUM) ? faster_log_sum_exp(&(logps[o]), ranges[i].width) : fast_log(s) + shift;
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_EXPCACHE, t0);
+    return acc;
+}
+
+
+static inline double faster_log_sum_exp_strided(const double *a, int n, int stride) {
+    // faster_log_sum_exp of a[0], a[stride], ..., a[(n - 1) * stride]
+    double a_max, acc;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i * stride], a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        return a_max;
+    }
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        acc += fast_exp(a[i * stride] - a_max);
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+#ifdef LSEA_HAVE_SIMD
+
+static inline __m256d faster_log_sum_exp_multi_pd(const double *a, int n, int k) {
+    // faster_log_sum_exp of one range in 4 interleaved vectors, one per
+    // lane: a[i * k] .. a[i * k + 3] are element i of each. called with
+    // constant n from the bucket loops, so each call site specialises.
+    __m256d t[MAX_BB_WIDTH];
+    __m256d a_max, shift, acc, is_ninf, x;
+    int i;
+
+    a_max = _mm256_set1_pd(-INFINITY);
+    for (i = 0; i < n; ++i) {
+        x = _mm256_loadu_pd(a + i * k);
+        a_max = _mm256_max_pd(a_max, x);
+        if (i < MAX_BB_WIDTH) {
+            t[i] = x;
+        }
+    }
+    if (n <= 1) {
+        return a_max;
+    }
+    // lanes whose terms are all -inf: shift by 0 so exp gives 0, not nan
+    is_ninf = _mm256_cmp_pd(a_max, _mm256_set1_pd(-INFINITY), _CMP_EQ_OQ);
+    shift = _mm256_andnot_pd(is_ninf, a_max);
+
+    acc = _mm256_setzero_pd();
+    for (i = 0; i < n; ++i) {
+        x = (i < MAX_BB_WIDTH) ? t[i] : _mm256_loadu_pd(a + i * k);
+        acc = _mm256_add_pd(acc, fast_exp_pd(_mm256_sub_pd(x, shift)));
+    }
+    return _mm256_add_pd(fast_log_pd(acc), shift);
+}
+
+#endif
+
+
+static inline void faster_log_sum_exp_multi_n(const double *a, int n, int k, double *out) {
+    // out[v] += faster_log_sum_exp of the n elements a[i * k + v]
+    int v = 0;
+#ifdef LSEA_HAVE_SIMD
+    for (; v + 4 <= k; v += 4) {
+        _mm256_storeu_pd(out + v, _mm256_add_pd(_mm256_loadu_pd(out + v),
+            faster_log_sum_exp_multi_pd(a + v, n, k)));
+    }
+#endif
+    for (; v < k; ++v) {
+        out[v] += faster_log_sum_exp_strided(a + v, n, k);
+    }
+}
+
+
+void faster_log_sum_exp_multi(const double *a, int n, int k, double *out) {
+    // out[v] = faster_log_sum_exp of vector v of k interleaved vectors:
+    // a[v], a[k + v], ..., a[(n - 1) * k + v].
+    int v;
+    for (v = 0; v < k; ++v) {
+        out[v] = 0.0;
+    }
+    faster_log_sum_exp_multi_n(a, n, k, out);
+}
+
+
+void faster_log_sum_exp_bb_multi(range_t *ranges, const range_buckets_t *buckets, const double *logps,
+        int k, double *totals) {
+    // as faster_log_sum_exp_bb_tier over k data vectors at once.
+    // logps holds the vectors interleaved, element i of vector v at
+    // logps[i * k + v], so each range is walked once and read as a run of
+    // contiguous rows, 4 vectors per AVX2 register. totals[v] receives
+    // the sum of the log-sum-exp of every range of vector v.
+    const int *b = buckets->start;
+    int i, v;
+    LSE_INSTRUMENT_START(t0);
+
+    for (v = 0; v < k; ++v) {
+        totals[v] = 0.0;
+    }
+    for (i = b[0]; i < b[1]; ++i) {
+        for (v = 0; v < k; ++v) {
+            totals[v] += -INFINITY;
+        }
+    }
+
+#define MULTI_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        faster_log_sum_exp_multi_n(&(logps[(size_t)ranges[i].offset * k]), N, k, totals); \
+    }
+
+    MULTI_BB_BUCKET(1)
+    MULTI_BB_BUCKET(2)
+    MULTI_BB_BUCKET(3)
+    MULTI_BB_BUCKET(4)
+    MULTI_BB_BUCKET(5)
+    MULTI_BB_BUCKET(6)
+    MULTI_BB_BUCKET(7)
+    MULTI_BB_BUCKET(8)
+    MULTI_BB_BUCKET(9)
+    MULTI_BB_BUCKET(10)
+
+#undef MULTI_BB_BUCKET
+
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        faster_log_sum_exp_multi_n(&(logps[(size_t)ranges[i].offset * k]), ranges[i].width, k, totals);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_MULTI, t0);
+}
+
+
+int make_soa_logps(range_t *ranges, const range_buckets_t *buckets, const double *logps, soa_logps_t *soa) {
+    // lay out the buckets of width 1 to MAX_BB_WIDTH and fill them from
+    // logps. width 0 and wider ranges are left out, as in
+    // faster_log_sum_exp_bb_buckets.
+    // returns 0 on success, 2 on allocation failure.
+    const int *b = buckets->start;
+    size_t i;
+    int w, n_groups;
+
+    soa->count[0] = 0;
+    soa->start[0] = 0;
+    soa->size = 0;
+    for (w = 1; w <= MAX_BB_WIDTH; ++w) {
+        soa->count[w] = b[w + 1] - b[w];
+        soa->start[w] = soa->size;
+        n_groups = (soa->count[w] + SOA_LANES - 1) / SOA_LANES;
+        soa->size += (size_t)n_groups * w * SOA_LANES;
+    }
+    if (posix_memalign((void **)&(soa->values), 32, soa->size * sizeof(double) + 32) != 0) {
+        soa->values = NULL;
+        return 2;
+    }
+    // padding lanes are never rewritten by update_soa_logps
+    for (i = 0; i < soa->size; ++i) {
+        soa->values[i] = -INFINITY;
+    }
+    update_soa_logps(ranges, buckets, logps, soa);
+    return 0;
+}
+
+
+void update_soa_logps(range_t *ranges, const range_buckets_t *buckets, const double *logps, soa_logps_t *soa) {
+    // refresh the copied values after logps changes. costs one pass over
+    // the ranges' elements, independent of the size of logps.
+    // pre-req: soa was made from the same ranges and buckets.
+    const int *b = buckets->start;
+    double *v;
+    int i, j, k, w, n;
+
+    for (w = 1; w <= MAX_BB_WIDTH; ++w) {
+        v = soa->values + soa->start[w];
+        for (i = b[w]; i < b[w + 1]; i += SOA_LANES) {
+            n = (b[w + 1] - i < SOA_LANES) ? b[w + 1] - i : SOA_LANES;
+            for (k = 0; k < w; ++k) {
+                for (j = 0; j < n; ++j) {
+                    v[k * SOA_LANES + j] = logps[ranges[i + j].offset + k];
+                }
+            }
+            v += w * SOA_LANES;
+        }
+    }
+}
+
+
+void release_soa_logps(soa_logps_t *soa) {
+    free(soa->values);
+    soa->values = NULL;
+    soa->size = 0;
+}
+
+
+#ifdef LSEA_HAVE_SIMD
+
+static inline void faster_log_sum_exp_soa_pd(const double *a, int n, __m256d *lo, __m256d *hi) {
+    // faster_log_sum_exp of the SOA_LANES ranges of width n in one group,
+    // in two registers. called with constant n, so each bucket specialises.
+    __m256d t_lo[MAX_BB_WIDTH], t_hi[MAX_BB_WIDTH];
+    __m256d max_lo, max_hi, acc_lo, acc_hi, ninf;
+    int k;
+
+    ninf = _mm256_set1_pd(-INFINITY);
+    max_lo = ninf;
+    max_hi = ninf;
+    for (k = 0; k < n; ++k) {
+        t_lo[k] = _mm256_load_pd(a + k * SOA_LANES);
+        t_hi[k] = _mm256_load_pd(a + k * SOA_LANES + 4);
+        max_lo = _mm256_max_pd(max_lo, t_lo[k]);
+        max_hi = _mm256_max_pd(max_hi, t_hi[k]);
+    }
+    if (n <= 1) {
+        *lo = max_lo;
+        *hi = max_hi;
+        return;
+    }
+    // lanes whose terms are all -inf (padding, too): shift by 0 so exp
+    // gives 0, not nan
+    max_lo = _mm256_andnot_pd(_mm256_cmp_pd(max_lo, ninf, _CMP_EQ_OQ), max_lo);
+    max_hi = _mm256_andnot_pd(_mm256_cmp_pd(max_hi, ninf, _CMP_EQ_OQ), max_hi);
+
+    acc_lo = _mm256_setzero_pd();
+    acc_hi = _mm256_setzero_pd();
+    for (k = 0; k < n; ++k) {
+        acc_lo = _mm256_add_pd(acc_lo, fast_exp_pd(_mm256_sub_pd(t_lo[k], max_lo)));
+        acc_hi = _mm256_add_pd(acc_hi, fast_exp_pd(_mm256_sub_pd(t_hi[k], max_hi)));
+    }
+    *lo = _mm256_add_pd(fast_log_pd(acc_lo), max_lo);
+    *hi = _mm256_add_pd(fast_log_pd(acc_hi), max_hi);
+}
+
+#endif
+
+
+static inline double faster_log_sum_exp_soa_n(const double *v, int count, int n) {
+    // sum of faster_log_sum_exp over the count ranges of width n stored
+    // from v. full groups add all lanes; the padded lanes of the last
+    // group are dropped.
+    double tail[SOA_LANES] __attribute__((aligned(32)));
+    double acc = 0.0;
+    int g, j, n_full = count / SOA_LANES;
+#ifdef LSEA_HAVE_SIMD
+    __m256d lo, hi, sum_lo, sum_hi;
+
+    sum_lo = _mm256_setzero_pd();
+    sum_hi = _mm256_setzero_pd();
+    for (g = 0; g < n_full; ++g) {
+        faster_log_sum_exp_soa_pd(v, n, &lo, &hi);
+        sum_lo = _mm256_add_pd(sum_lo, lo);
+        sum_hi = _mm256_add_pd(sum_hi, hi);
+        v += n * SOA_LANES;
+    }
+    acc = simd_hsum_pd(_mm256_add_pd(sum_lo, sum_hi));
+    if (count > n_full * SOA_LANES) {
+        faster_log_sum_exp_soa_pd(v, n, &lo, &hi);
+        _mm256_store_pd(tail, lo);
+        _mm256_store_pd(tail + 4, hi);
+    }
+#else
+    for (g = 0; g < n_full; ++g) {
+        for (j = 0; j < SOA_LANES; ++j) {
+            acc += faster_log_sum_exp_strided(v + j, n, SOA_LANES);
+        }
+        v += n * SOA_LANES;
+    }
+    for (j = 0; j < count - n_full * SOA_LANES; ++j) {
+        tail[j] = faster_log_sum_exp_strided(v + j, n, SOA_LANES);
+    }
+#endif
+    for (j = 0; j < count - n_full * SOA_LANES; ++j) {
+        acc += tail[j];
+    }
+    return acc;
+}
+
+
+double faster_log_sum_exp_bb_soa(const soa_logps_t *soa) {
+    // as faster_log_sum_exp_bb_buckets, reading the values from soa.
+    // each range gives the same result; the sum runs in another order.
+    double acc = 0.0;
+    LSE_INSTRUMENT_START(t0);
+
+#define SOA_BB_BUCKET(N) \
+    acc += faster_log_sum_exp_soa_n(soa->values + soa->start[N], soa->count[N], N);
+
+    SOA_BB_BUCKET(1)
+    SOA_BB_BUCKET(2)
+    SOA_BB_BUCKET(3)
+    SOA_BB_BUCKET(4)
+    SOA_BB_BUCKET(5)
+    SOA_BB_BUCKET(6)
+    SOA_BB_BUCKET(7)
+    SOA_BB_BUCKET(8)
+    SOA_BB_BUCKET(9)
+    SOA_BB_BUCKET(10)
+
+#undef SOA_BB_BUCKET
+
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_SOA, t0);
+    return acc;
+}
+
+
+int make_quant_logps(const double *logps, int m, int bits, quant_logps_t *ql) {
+    // returns 0 on success, 1 if bits is not 8 or 16, 2 on allocation failure.
+    if ((bits != 8 && bits != 16) || m < 0) {
+        return 1;
+    }
+    ql->bits = bits;
+    ql->m = m;
+    ql->n_blocks = (m + (1 << BLOCK_MAX_SHIFT) - 1) >> BLOCK_MAX_SHIFT;
+    ql->codes = malloc(m * (bits / 8) + 1);
+    ql->scale = malloc(ql->n_blocks * sizeof(double) + 1);
+    if (ql->codes == NULL || ql->scale == NULL) {
+        release_quant_logps(ql);
+        return 2;
+    }
+    update_quant_logps(logps, m, ql);
+    return 0;
+}
+
+
+void update_quant_logps(const double *logps, int m, quant_logps_t *ql) {
+    // call whenever logps changes. pre-req: ql made for the same m.
+    // each block is scaled so that its smallest finite value takes the
+    // code -QUANT_MAX_CODE: the absolute error is at most half a step.
+    // preconditions: -inf <= logps[i] <= 0.0
+    int8_t *c8 = ql->codes;
+    int16_t *c16 = ql->codes;
+    double a_min, s, q;
+    int k, i, i_end, q_max, q_ninf;
+
+    q_max = QUANT_MAX_CODE(ql->bits);
+    q_ninf = QUANT_NINF_CODE(ql->bits);
+    for (k = 0; k < ql->n_blocks; ++k) {
+        i_end = (k + 1) << BLOCK_MAX_SHIFT;
+        if (i_end > m) {
+            i_end = m;
+        }
+        a_min = 0.0;
+        for (i = k << BLOCK_MAX_SHIFT; i < i_end; ++i) {
+            if (logps[i] > -INFINITY) {
+                a_min = fmin(logps[i], a_min);
+            }
+        }
+        // a block of zeros and -infs may take any scale
+        s = (a_min < 0.0) ? a_min / -q_max : 1.0;
+        ql->scale[k] = s;
+        for (i = k << BLOCK_MAX_SHIFT; i < i_end; ++i) {
+            if (logps[i] > -INFINITY) {
+                q = fmax(fmin(nearbyint(logps[i] / s), 0.0), -q_max);
+            } else {
+                q = q_ninf;
+            }
+            if (ql->bits == 8) {
+                c8[i] = (int8_t)q;
+            } else {
+                c16[i] = (int16_t)q;
+            }
+        }
+    }
+}
+
+
+void release_quant_logps(quant_logps_t *ql) {
+    free(ql->codes);
+    free(ql->scale);
+    ql->codes = NULL;
+    ql->scale = NULL;
+    ql->m = 0;
+    ql->n_blocks = 0;
+}
+
+
+static inline int quant_code(const void *codes, int i, int bits) {
+    return (bits == 8) ? ((const int8_t *)codes)[i] : ((const int16_t *)codes)[i];
+}
+
+
+static inline double dequant(int q, double s, int bits) {
+    return (q == QUANT_NINF_CODE(bits)) ? -INFINITY : q * s;
+}
+
+
+static inline double faster_log_sum_exp_quant_n(const quant_logps_t *ql, int o, int n, int bits) {
+    // faster_log_sum_exp of the n quantised elements from offset o. the
+    // max runs on the integer codes of each block the range meets and
+    // only its result is dequantised; each element is dequantised in
+    // registers on the way into fast_exp. called with constant n and
+    // bits from the bucket loops, so each call site specialises.
+    // preconditions: 1 <= n <= MAX_BB_WIDTH, so the range meets at most
+    // two blocks.
+    double s0, s1, s, a_max, acc;
+    int q0, q1, q, k, split;
+
+    split = (((o >> BLOCK_MAX_SHIFT) + 1) << BLOCK_MAX_SHIFT) - o;
+    if (split > n) {
+        split = n;
+    }
+    s0 = ql->scale[o >> BLOCK_MAX_SHIFT];
+    s1 = ql->scale[(o + n - 1) >> BLOCK_MAX_SHIFT];
+
+    q0 = QUANT_NINF_CODE(bits);
+    q1 = QUANT_NINF_CODE(bits);
+    for (k = 0; k < n; ++k) {
+        q = quant_code(ql->codes, o + k, bits);
+        if (k < split) {
+            q0 = (q > q0) ? q : q0;
+        } else {
+            q1 = (q > q1) ? q : q1;
+        }
+    }
+    a_max = fmax(dequant(q0, s0, bits), dequant(q1, s1, bits));
+    if (a_max <= -INFINITY || n <= 1) {
+        return a_max;
+    }
+
+    acc = 0.0;
+    for (k = 0; k < n; ++k) {
+        s = (k < split) ? s0 : s1;
+        acc += fast_exp(dequant(quant_code(ql->codes, o + k, bits), s, bits) - a_max);
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+static inline double faster_log_sum_exp_quant(const quant_logps_t *ql, int o, int n, int bits) {
+    // any width: dequantise each element with the scale of its own block.
+    double a_max, acc, v;
+    int k;
+    a_max = -INFINITY;
+    for (k = 0; k < n; ++k) {
+        v = dequant(quant_code(ql->codes, o + k, bits), ql->scale[(o + k) >> BLOCK_MAX_SHIFT], bits);
+        a_max = fmax(v, a_max);
+    }
+    if (a_max <= -INFINITY || n <= 1) {
+        return a_max;
+    }
+    acc = 0.0;
+    for (k = 0; k < n; ++k) {
+        v = dequant(quant_code(ql->codes, o + k, bits), ql->scale[(o + k) >> BLOCK_MAX_SHIFT], bits);
+        acc += fast_exp(v - a_max);
+    }
+    return fast_log(acc) + a_max;
+}
+
+
+static inline double bb_quant(range_t *ranges, const range_buckets_t *buckets, const quant_logps_t *ql, int bits) {
+    const int *b = buckets->start;
+    double acc = 0.0;
+    int i;
+
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += -INFINITY;
+    }
+
+#define QUANT_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        acc += faster_log_sum_exp_quant_n(ql, ranges[i].offset, N, bits); \
+    }
+
+    QUANT_BB_BUCKET(1)
+    QUANT_BB_BUCKET(2)
+    QUANT_BB_BUCKET(3)
+    QUANT_BB_BUCKET(4)
+    QUANT_BB_BUCKET(5)
+    QUANT_BB_BUCKET(6)
+    QUANT_BB_BUCKET(7)
+    QUANT_BB_BUCKET(8)
+    QUANT_BB_BUCKET(9)
+    QUANT_BB_BUCKET(10)
+
+#undef QUANT_BB_BUCKET
+
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        acc += faster_log_sum_exp_quant(ql, ranges[i].offset, ranges[i].width, bits);
+    }
+    return acc;
+}
+
+
+double faster_log_sum_exp_bb_quant(range_t *ranges, const range_buckets_t *buckets, const quant_logps_t *ql) {
+    // as faster_log_sum_exp_bb_tier over the dequantised data, reading
+    // 2 (bits 16) or 1 (bits 8) bytes per element instead of 8.
+    // pre-req: ql up to date with the data.
+    double total;
+    LSE_INSTRUMENT_START(t0);
+    if (ql->bits == 8) {
+        total = bb_quant(ranges, buckets, ql, 8);
+    } else {
+        total = bb_quant(ranges, buckets, ql, 16);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_QUANT, t0);
+    return total;
+}
+
+
+// smallest rescaled window sum trusted by faster_log_sum_exp_sliding.
+// below this the window is recomputed with its own max.
+#define SLIDING_MIN_SUM (1e-260)
+
+
+static inline double block_exps(const double *a, int n, double *e) {
+    // e[i] = fast_exp_poly(a[i] - max(a)). returns max(a). an all -inf block
+    // is shifted by 0 so its exps are 0 rather than nan.
+    double a_max, shift;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i], a_max);
+    }
+    shift = (a_max <= -INFINITY) ? 0.0 : a_max;
+    for (i = 0; i < n; ++i) {
+        e[i] = fast_exp_poly(a[i] - shift);
+    }
+    return a_max;
+}
+
+
+void faster_log_sum_exp_sliding(double *a, int w, int count, double *scratch, double *out) {
+    // out[j] = faster_log_sum_exp(a + j, w) for j = 0, ..., count-1.
+    // pre-req: scratch holds 2 * w doubles.
+    //
+    // cut a into blocks of w elements. window j with j % w == 0 is a whole
+    // block; any other window is a suffix of one block followed by a
+    // prefix of the next. with the exps of each block taken against the
+    // block max, and suffix sums of the first block kept in scratch, each
+    // window costs two multiplies and a fast_log however wide it is.
+    //
+    // exps and logs are at the poly tier. at the raw tier the error of the
+    // rescaling factors, and of exps taken against the block max rather
+    // than the window max, biases every window the same way: the total of
+    // a run came out about 2% low, against 0.5% for faster_log_sum_exp.
+    double *suffix, *e, *t;
+    double m_a, m_b, m, f_a, f_b, prefix, s;
+    int b0, len, r, i;
+
+    if (w <= 1) {
+        for (i = 0; i < count; ++i) {
+            out[i] = faster_log_sum_exp(a + i, w);
+        }
+        return;
+    }
+
+    suffix = scratch;
+    e = scratch + w;
+    m_a = block_exps(a, w, suffix);
+    for (i = w - 2; i >= 0; --i) {
+        suffix[i] += suffix[i + 1];
+    }
+
+    for (b0 = 0; b0 < count; b0 += w) {
+        out[b0] = (m_a <= -INFINITY) ? m_a : fast_log_poly(suffix[0]) + m_a;
+
+        // the next block, truncated to the elements the windows still need
+        len = count - 1 - b0;
+        if (len <= 0) {
+            break;
+        }
+        if (len > w) {
+            len = w;
+        }
+        m_b = block_exps(a + b0 + w, len, e);
+
+        // one rescaling of each block sum onto the larger of the two maxima.
+        // f_a and f_b are 0 for an all -inf block.
+        m = fmax(m_a, m_b);
+        f_a = fast_exp_poly(m_a - m);
+        f_b = fast_exp_poly(m_b - m);
+        prefix = 0.0;
+        for (r = 1; r < w && r <= len; ++r) {
+            prefix += e[r - 1];
+            s = suffix[r] * f_a + prefix * f_b;
+            if (s < SLIDING_MIN_SUM) {
+                // rare: the block maxima lie outside this window and its own
+                // terms underflow against them. also the all -inf case.
+                out[b0 + r] = faster_log_sum_exp(a + b0 + r, w);
+            } else {
+                out[b0 + r] = fast_log_poly(s) + m;
+            }
+        }
+
+        // the next block becomes the first; only needed if it is whole
+        for (i = len - 2; i >= 0; --i) {
+            e[i] += e[i + 1];
+        }
+        t = suffix;
+        suffix = e;
+        e = t;
+        m_a = m_b;
+    }
+}
+
+
+int compare_ranges(const void *a, const void *b) {
+    range_t *aa, *bb;
+    aa = (range_t*)a;
+    bb = (range_t*)b;
+    int delta_w, delta_o;
+    delta_w = (aa->width - bb->width);
+    delta_o = (aa->offset - bb->offset);
+    // return (delta_o != 0) ? delta_o : delta_w; // bad order
+    return (delta_w != 0) ? delta_w : delta_o; // good order
+}
+
+
+#define RADIX_BITS 11
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1)
+
+
+int order_ranges_bucketed(const range_t *ranges, int n, int *order, range_buckets_t *buckets) {
+    // compute the permutation that sorts ranges into the same order as
+    // compare_ranges, in linear time: LSD radix sort on offset, then a
+    // stable counting sort on width. on return ranges[order[i]] is the
+    // i-th range in sorted order. if buckets is not NULL, the width bucket
+    // boundaries are written there so kernels need not rescan
+    // ranges[i].width.
+    // returns 0 on success, 1 on negative offset or width, 2 on
+    // allocation failure.
+    int i, w, shift, max_offset, max_width, total, count;
+    int *counts, *src, *dst, *tmp, *swap;
+
+    max_offset = 0;
+    max_width = MAX_BB_WIDTH + 1;
+    for (i = 0; i < n; ++i) {
+        if (ranges[i].offset < 0 || ranges[i].width < 0) {
+            return 1;
+        }
+        if (ranges[i].offset > max_offset) {
+            max_offset = ranges[i].offset;
+        }
+        if (ranges[i].width > max_width) {
+            max_width = ranges[i].width;
+        }
+    }
+
+    tmp = malloc(n * sizeof(int) + 1);
+    counts = malloc(((max_width + 1 > RADIX_SIZE) ? max_width + 1 : RADIX_SIZE) * sizeof(int));
+    if (tmp == NULL || counts == NULL) {
+        free(tmp);
+        free(counts);
+        return 2;
+    }
+
+    for (i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    src = order;
+    dst = tmp;
+
+    // passes over offset digits, least significant first. offsets are non
+    // negative ints, so shifts past 30 would be undefined and find no digit
+    for (shift = 0; shift == 0 || (shift < 31 && (max_offset >> shift) > 0); shift += RADIX_BITS) {
+        memset(counts, 0, RADIX_SIZE * sizeof(int));
+        for (i = 0; i < n; ++i) {
+            counts[(ranges[src[i]].offset >> shift) & RADIX_MASK] += 1;
+        }
+        total = 0;
+        for (i = 0; i < RADIX_SIZE; ++i) {
+            count = counts[i];
+            counts[i] = total;
+            total += count;
+        }
+        for (i = 0; i < n; ++i) {
+            dst[counts[(ranges[src[i]].offset >> shift) & RADIX_MASK]++] = src[i];
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // final pass on width, always landing back in order
+    memset(counts, 0, (max_width + 1) * sizeof(int));
+    for (i = 0; i < n; ++i) {
+        counts[ranges[src[i]].width] += 1;
+    }
+    total = 0;
+    for (w = 0; w <= max_width; ++w) {
+        count = counts[w];
+        counts[w] = total;
+        total += count;
+    }
+    if (buckets != NULL) {
+        for (w = 0; w <= MAX_BB_WIDTH + 1; ++w) {
+            buckets->start[w] = counts[w];
+        }
+        buckets->start[MAX_BB_WIDTH + 2] = n;
+    }
+    if (src == order) {
+        memcpy(tmp, order, n * sizeof(int));
+        src = tmp;
+    }
+    for (i = 0; i < n; ++i) {
+        order[counts[ranges[src[i]].width]++] = src[i];
+    }
+
+    free(counts);
+    free(tmp);
+    return 0;
+}
+
+
+int sort_ranges_bucketed(range_t *ranges, int n, range_buckets_t *buckets) {
+    // sort ranges in place into the same order as compare_ranges, in
+    // linear time. see order_ranges_bucketed.
+    int i, status;
+    int *order;
+    range_t *tmp;
+
+    order = malloc(n * sizeof(int) + 1);
+    tmp = malloc(n * sizeof(range_t) + 1);
+    if (order == NULL || tmp == NULL) {
+        free(order);
+        free(tmp);
+        return 2;
+    }
+    status = order_ranges_bucketed(ranges, n, order, buckets);
+    if (status == 0) {
+        memcpy(tmp, ranges, n * sizeof(range_t));
+        for (i = 0; i < n; ++i) {
+            ranges[i] = tmp[order[i]];
+        }
+    }
+    free(tmp);
+    free(order);
+    return status;
+}
+
+
+void sort_ranges_inplace(range_t *ranges, int n) {
+    if (sort_ranges_bucketed(ranges, n, NULL) != 0) {
+        qsort((void *)ranges, n, sizeof(range_t), compare_ranges);
+    }
+}
+
+
+int sort_ranges_tiled(range_t *ranges, int n, int shift, range_tiles_t *tiles) {
+    // sort ranges in place into tiles of 1 << shift elements by offset,
+    // each tile in the order of compare_ranges, and record the width
+    // buckets of every tile. sorting by width first and then stably by
+    // tile gives (tile, width, offset) order.
+    // returns 0 on success, 1 on negative offset or width or bad shift,
+    // 2 on allocation failure.
+    int i, t, w, end, max_offset, status;
+    int *start;
+    range_t *tmp;
+    range_buckets_t *buckets;
+
+    if (shift < 0 || shift > 30) {
+        return 1;
+    }
+    status = sort_ranges_bucketed(ranges, n, NULL);
+    if (status != 0) {
+        return status;
+    }
+    max_offset = 0;
+    for (i = 0; i < n; ++i) {
+        max_offset = (ranges[i].offset > max_offset) ? ranges[i].offset : max_offset;
+    }
+    tiles->shift = shift;
+    tiles->n_tiles = (max_offset >> shift) + 1;
+
+    start = calloc(tiles->n_tiles + 1, sizeof(int));
+    tmp = malloc(n * sizeof(range_t) + 1);
+    buckets = malloc(tiles->n_tiles * sizeof(range_buckets_t));
+    if (start == NULL || tmp == NULL || buckets == NULL) {
+        free(start);
+        free(tmp);
+        free(buckets);
+        return 2;
+    }
+
+    // stable counting sort on tile
+    for (i = 0; i < n; ++i) {
+        ++start[(ranges[i].offset >> shift) + 1];
+    }
+    for (t = 0; t < tiles->n_tiles; ++t) {
+        start[t + 1] += start[t];
+    }
+    for (i = 0; i < n; ++i) {
+        tmp[start[ranges[i].offset >> shift]++] = ranges[i];
+    }
+    memcpy(ranges, tmp, n * sizeof(range_t));
+
+    // start[t] is now the end of tile t; within a tile ranges are by width
+    i = 0;
+    for (t = 0; t < tiles->n_tiles; ++t) {
+        end = start[t];
+        for (w = 0; w <= MAX_BB_WIDTH; ++w) {
+            buckets[t].start[w] = i;
+            while (i < end && ranges[i].width <= w) {
+                ++i;
+            }
+        }
+        buckets[t].start[MAX_BB_WIDTH + 1] = i;
+        buckets[t].start[MAX_BB_WIDTH + 2] = end;
+        i = end;
+    }
+    tiles->buckets = buckets;
+    free(tmp);
+    free(start);
+    return 0;
+}
+
+
+void release_range_tiles(range_tiles_t *tiles) {
+    free(tiles->buckets);
+    tiles->buckets = NULL;
+    tiles->n_tiles = 0;
+}
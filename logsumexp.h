@@ -0,0 +1,241 @@
+#ifndef _LSEA_LOGSUMEXP
+#define _LSEA_LOGSUMEXP 1
+
+#include <stddef.h>
+#include <math.h>
+
+#include "types.h"
+#include "fast_approx.h"
+#include "lse_instrument.h"
+
+
+static inline double faster_log_sum_exp_1(const double *a) {
+    return a[0];
+}
+
+static inline double faster_log_sum_exp_2(const double *a) {
+    double a_max;
+    a_max = fmax(a[0], a[1]);
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(2);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_3(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(a[0], a[1]), a[2]);
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(3);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_4(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(a[0], a[1]), fmax(a[2], a[3]));
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(4);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_5(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), a[4]);
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(5);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max) +
+        fast_exp(a[4] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_6(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(a[4], a[5]));
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(6);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max) +
+        fast_exp(a[4] - a_max) +
+        fast_exp(a[5] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_7(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), a[6]));
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(7);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max) +
+        fast_exp(a[4] - a_max) +
+        fast_exp(a[5] - a_max) +
+        fast_exp(a[6] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_8(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), fmax(a[6], a[7])));
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(8);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max) +
+        fast_exp(a[4] - a_max) +
+        fast_exp(a[5] - a_max) +
+        fast_exp(a[6] - a_max) +
+        fast_exp(a[7] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_9(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), fmax(a[6], a[7]))), a[8]);
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(9);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max) +
+        fast_exp(a[4] - a_max) +
+        fast_exp(a[5] - a_max) +
+        fast_exp(a[6] - a_max) +
+        fast_exp(a[7] - a_max) +
+        fast_exp(a[8] - a_max)
+    ) + a_max;
+}
+
+static inline double faster_log_sum_exp_10(const double *a) {
+    double a_max;
+    a_max = fmax(fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), fmax(a[6], a[7]))), fmax(a[8], a[9]));
+    if (a_max <= -INFINITY) {
+        LSE_INSTRUMENT_EARLY_EXIT();
+        return a_max;
+    }
+    LSE_INSTRUMENT_EXPS(10);
+    return fast_log(
+        fast_exp(a[0] - a_max) +
+        fast_exp(a[1] - a_max) +
+        fast_exp(a[2] - a_max) +
+        fast_exp(a[3] - a_max) +
+        fast_exp(a[4] - a_max) +
+        fast_exp(a[5] - a_max) +
+        fast_exp(a[6] - a_max) +
+        fast_exp(a[7] - a_max) +
+        fast_exp(a[8] - a_max) +
+        fast_exp(a[9] - a_max)
+    ) + a_max;
+}
+
+double sum(double *a, int n);
+double log_sum_exp(double *a, int n);
+double fast_log_sum_exp(double *a, int n);
+double faster_log_sum_exp(double *a, int n);
+double faster_log_sum_exp_table(double *a, int n);
+double faster_log_sum_exp_poly(double *a, int n);
+
+double log_sum_exp_bb_buckets(range_t *ranges, const range_buckets_t *buckets, double *logps);
+double faster_log_sum_exp_bb(range_t *ranges, double *logps, int n);
+double faster_log_sum_exp_bb_buckets(range_t *ranges, const range_buckets_t *buckets, double *logps);
+double faster_log_sum_exp_bb_tier(range_t *ranges, const range_buckets_t *buckets, double *logps, int tier);
+double faster_log_sum_exp_bb_prefetch(range_t *ranges, const range_buckets_t *buckets, double *logps,
+    int group, int distance);
+int faster_log_sum_exp_bb_sample(range_t *ranges, const range_buckets_t *buckets, double *logps,
+    double rel_err, double z, unsigned long seed, sample_estimate_t *est);
+double faster_log_sum_exp_bb_tiled(range_t *ranges, const range_tiles_t *tiles, double *logps);
+
+size_t encode_varint(unsigned char *p, unsigned int x);
+int make_compact_ranges(range_t *ranges, int n, compact_ranges_t *cr);
+void release_compact_ranges(compact_ranges_t *cr);
+double faster_log_sum_exp_bb_compact(const compact_ranges_t *cr, double *logps);
+
+int make_bytecode(range_t *ranges, int n, bytecode_t *bc);
+void release_bytecode(bytecode_t *bc);
+double faster_log_sum_exp_interp(const bytecode_t *bc, double *logps);
+
+int make_block_maxima(const double *logps, int m, block_maxima_t *bm);
+void update_block_maxima(const double *logps, int m, block_maxima_t *bm);
+void release_block_maxima(block_maxima_t *bm);
+double faster_log_sum_exp_bb_blockmax(range_t *ranges, const range_buckets_t *buckets, double *logps,
+    const block_maxima_t *bm);
+double faster_log_sum_exp_bb_pruned(range_t *ranges, const range_buckets_t *buckets, double *logps,
+    const block_maxima_t *bm);
+
+int make_exp_cache(const double *logps, int m, exp_cache_t *ec);
+void update_exp_cache(const double *logps, int m, exp_cache_t *ec);
+void release_exp_cache(exp_cache_t *ec);
+double faster_log_sum_exp_bb_expcache(range_t *ranges, const range_buckets_t *buckets, double *logps,
+    const exp_cache_t *ec);
+
+void faster_log_sum_exp_multi(const double *a, int n, int k, double *out);
+void faster_log_sum_exp_bb_multi(range_t *ranges, const range_buckets_t *buckets, const double *logps,
+    int k, double *totals);
+
+int make_quant_logps(const double *logps, int m, int bits, quant_logps_t *ql);
+void update_quant_logps(const double *logps, int m, quant_logps_t *ql);
+void release_quant_logps(quant_logps_t *ql);
+double faster_log_sum_exp_bb_quant(range_t *ranges, const range_buckets_t *buckets, const quant_logps_t *ql);
+
+int make_soa_logps(range_t *ranges, const range_buckets_t *buckets, const double *logps, soa_logps_t *soa);
+void update_soa_logps(range_t *ranges, const range_buckets_t *buckets, const double *logps, soa_logps_t *soa);
+void release_soa_logps(soa_logps_t *soa);
+double faster_log_sum_exp_bb_soa(const soa_logps_t *soa);
+
+void faster_log_sum_exp_sliding(double *a, int w, int count, double *scratch, double *out);
+
+int compare_ranges(const void *a, const void *b);
+int order_ranges_bucketed(const range_t *ranges, int n, int *order, range_buckets_t *buckets);
+int sort_ranges_bucketed(range_t *ranges, int n, range_buckets_t *buckets);
+void sort_ranges_inplace(range_t *ranges, int n);
+int sort_ranges_tiled(range_t *ranges, int n, int shift, range_tiles_t *tiles);
+void release_range_tiles(range_tiles_t *tiles);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _LSEA_LSE
+#define _LSEA_LSE 1
+
+// prepared-plan api for batched log-sum-exp over ranges of a data vector.
+//
+// lse_plan_create does the expensive, pattern-only work once: bucketing
+// the ranges by width, removing duplicate ranges, choosing a strategy,
+// and jit compiling if that strategy is chosen. lse_plan_execute may then
+// be called any number of times with different data vectors.
+//
+// a plan is never modified by lse_plan_execute, so one plan may be
+// executed concurrently from many threads.
+
+#include "types.h"
+
+
+#define LSE_STRATEGY_AUTO 0
+#define LSE_STRATEGY_BASE 1     // glibc exp and log
+#define LSE_STRATEGY_FAST 2     // fast_exp, glibc log
+#define LSE_STRATEGY_FASTER 3   // fast_exp, fast_log
+#define LSE_STRATEGY_BB 4       // as faster, specialised per width bucket
+#define LSE_STRATEGY_JIT 5      // as faster, compiled for the pattern at runtime
+#define LSE_STRATEGY_BASEBB 6   // as base, vectorised across each width bucket
+
+
+// accuracy tier of fast_exp and fast_log for the faster, bb and jit
+// strategies. see fast_approx.h for the error of each tier.
+#define LSE_ACCURACY_RAW 0      // bit-level approximation only
+#define LSE_ACCURACY_TABLE 1    // corrected by a 256-entry table
+#define LSE_ACCURACY_POLY 2     // polynomial, close to glibc
+
+
+typedef struct {
+    int strategy;       // one of LSE_STRATEGY_*
+    int dedup;          // nonzero: evaluate each distinct range only once
+    int jit_max_ranges; // LSE_STRATEGY_AUTO only picks jit for patterns up to this size
+    // nonzero: evaluate runs of ranges (o, w), (o+1, w), ... as sliding
+    // windows. off by default. only bb plans at LSE_ACCURACY_RAW use them;
+    // with LSE_STRATEGY_AUTO a pattern that has runs is planned as bb.
+    int sliding;
+    int accuracy;       // one of LSE_ACCURACY_*
+    // autotuning, LSE_STRATEGY_AUTO only. when tune is nonzero the faster,
+    // bb and jit strategies are timed on the pattern and the fastest kept,
+    // in place of the jit_max_ranges rule.
+    int tune;
+    const char *tune_cache;     // if not NULL, a file remembering decisions per cpu and pattern
+    const double *tune_logps;   // if not NULL, data to time on, covering every range; else synthetic
+} lse_options_t;
+
+
+typedef struct lse_plan lse_plan_t;
+
+
+void lse_options_init(lse_options_t *options);
+
+// returns NULL and sets errno on failure: EINVAL for an invalid pattern or
+// option, ENOMEM on allocation failure, or the errno of a failed jit
+// request. options may be NULL for defaults.
+lse_plan_t *lse_plan_create(const range_t *ranges, int n, const lse_options_t *options);
+
+// returns the sum of the log-sum-exp of every range. if out is not NULL,
+// out[i] receives the log-sum-exp of the i-th range given to
+// lse_plan_create.
+double lse_plan_execute(const lse_plan_t *plan, double *logps, double *out);
+
+// evaluates the plan over k data vectors at once. logps holds them
+// interleaved: element i of vector v is logps[i * k + v]. totals[v]
+// receives the sum of the log-sum-exp of every range of vector v. the
+// faster, bb and jit strategies at LSE_ACCURACY_RAW walk the ranges once
+// for all k; other plans, and plans with sliding windows, are executed
+// once per vector. returns 0, or -1 and sets
+// errno: EINVAL for k < 1, ENOMEM on allocation failure.
+int lse_plan_execute_multi(const lse_plan_t *plan, const double *logps, int k, double *totals);
+
+void lse_plan_destroy(lse_plan_t *plan);
+
+int lse_plan_strategy(const lse_plan_t *plan);
+int lse_plan_n_ranges(const lse_plan_t *plan);
+int lse_plan_n_unique(const lse_plan_t *plan);
+
+#endif
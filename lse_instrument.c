@@ -0,0 +1,188 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "lse_instrument.h"
+
+
+static const char *site_names[LSE_INSTRUMENT_SITES] = {
+    "bb", "bb_tier", "basebb",
+    "plan_base", "plan_fast", "plan_faster", "plan_bb", "plan_jit", "plan_basebb",
+    "plan_multi", "tiered", "shard",
+    "quant", "bb_multi", "prefetch", "tiled", "soa", "blockmax", "expcache",
+    "compact", "sample", "pruned", "interp",
+    "softmax_bb", "softmax_simd", "csr_rows", "csr_slices",
+    "gemm_exact_naive", "gemm_fast_naive", "gemm_blocked",
+    "jit", "jit_multi", "jit_softmax",
+};
+
+
+const char *lse_instrument_site_name(int site) {
+    if (site < 0 || site >= LSE_INSTRUMENT_SITES) {
+        return NULL;
+    }
+    return site_names[site];
+}
+
+
+#ifdef LSE_INSTRUMENT
+
+#include <pthread.h>
+
+
+__thread lse_instrument_block_t *lse_instrument_local = NULL;
+
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static lse_instrument_block_t *blocks = NULL;
+
+
+lse_instrument_block_t *lse_instrument_register(void) {
+    lse_instrument_block_t *block;
+    block = calloc(1, sizeof(lse_instrument_block_t));
+    if (block == NULL) {
+        // counting must not fail the kernel: a thread that cannot get a
+        // block of its own shares this one, unlisted
+        static lse_instrument_block_t fallback;
+        lse_instrument_local = &fallback;
+        return &fallback;
+    }
+    pthread_mutex_lock(&blocks_lock);
+    block->next = blocks;
+    blocks = block;
+    pthread_mutex_unlock(&blocks_lock);
+    lse_instrument_local = block;
+    return block;
+}
+
+
+static void add_counters(lse_instrument_counters_t *sum, const lse_instrument_counters_t *c) {
+    const long *from = (const long *)c;
+    long *to = (long *)sum;
+    size_t i;
+    // the counters are all longs
+    for (i = 0; i < sizeof(lse_instrument_counters_t) / sizeof(long); ++i) {
+        to[i] += __atomic_load_n(&(from[i]), __ATOMIC_RELAXED);
+    }
+}
+
+
+int lse_instrument_snapshot(lse_instrument_counters_t *counters) {
+    lse_instrument_block_t *block;
+    memset(counters, 0, sizeof(lse_instrument_counters_t));
+    pthread_mutex_lock(&blocks_lock);
+    for (block = blocks; block != NULL; block = block->next) {
+        add_counters(counters, &(block->counters));
+    }
+    pthread_mutex_unlock(&blocks_lock);
+    return 0;
+}
+
+
+void lse_instrument_reset(void) {
+    lse_instrument_block_t *block;
+    pthread_mutex_lock(&blocks_lock);
+    for (block = blocks; block != NULL; block = block->next) {
+        memset(&(block->counters), 0, sizeof(lse_instrument_counters_t));
+    }
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+
+static void write_text(FILE *f, const lse_instrument_counters_t *c) {
+    int k, s;
+    for (k = 0; k <= MAX_BB_WIDTH; ++k) {
+        fprintf(f, "ranges_width_%d %ld\n", k, c->ranges[k]);
+    }
+    fprintf(f, "ranges_width_wide %ld\n", c->ranges[MAX_BB_WIDTH + 1]);
+    fprintf(f, "exps %ld\n", c->exps);
+    fprintf(f, "early_exits %ld\n", c->early_exits);
+    fprintf(f, "jit_functions %ld\n", c->jit_functions);
+    fprintf(f, "jit_bytes %ld\n", c->jit_bytes);
+    for (s = 0; s < LSE_INSTRUMENT_SITES; ++s) {
+        for (k = 0; k < LSE_INSTRUMENT_LATENCY_BUCKETS; ++k) {
+            if (c->latency[s][k] > 0) {
+                fprintf(f, "latency_%s_ns_lt_%ld %ld\n", site_names[s], 1l << k, c->latency[s][k]);
+            }
+        }
+    }
+}
+
+
+static void write_json(FILE *f, const lse_instrument_counters_t *c) {
+    // latency as {site: {"upper bound ns": count}}, nonzero only
+    const char *sep;
+    int k, s, any;
+    fprintf(f, "{\"ranges_by_width\": [");
+    for (k = 0; k <= MAX_BB_WIDTH + 1; ++k) {
+        fprintf(f, "%s%ld", (k > 0) ? ", " : "", c->ranges[k]);
+    }
+    fprintf(f, "], \"exps\": %ld, \"early_exits\": %ld, \"jit_functions\": %ld, \"jit_bytes\": %ld, \"latency_ns\": {",
+        c->exps, c->early_exits, c->jit_functions, c->jit_bytes);
+    any = 0;
+    for (s = 0; s < LSE_INSTRUMENT_SITES; ++s) {
+        sep = "";
+        for (k = 0; k < LSE_INSTRUMENT_LATENCY_BUCKETS; ++k) {
+            if (c->latency[s][k] == 0) {
+                continue;
+            }
+            if (*sep == '\0') {
+                fprintf(f, "%s\"%s\": {", any ? ", " : "", site_names[s]);
+                any = 1;
+            }
+            fprintf(f, "%s\"%ld\": %ld", sep, 1l << k, c->latency[s][k]);
+            sep = ", ";
+        }
+        if (*sep != '\0') {
+            fprintf(f, "}");
+        }
+    }
+    fprintf(f, "}}\n");
+}
+
+
+int lse_instrument_write(FILE *f, int format) {
+    lse_instrument_counters_t *c;
+    if (format != LSE_INSTRUMENT_FORMAT_TEXT && format != LSE_INSTRUMENT_FORMAT_JSON) {
+        errno = EINVAL;
+        return -1;
+    }
+    // about 11KB: too much for some thread stacks
+    c = malloc(sizeof(lse_instrument_counters_t));
+    if (c == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    lse_instrument_snapshot(c);
+    if (format == LSE_INSTRUMENT_FORMAT_JSON) {
+        write_json(f, c);
+    } else {
+        write_text(f, c);
+    }
+    free(c);
+    if (ferror(f)) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int lse_instrument_snapshot(lse_instrument_counters_t *counters) {
+    errno = ENOSYS;
+    return -1;
+}
+
+
+int lse_instrument_write(FILE *f, int format) {
+    errno = ENOSYS;
+    return -1;
+}
+
+
+void lse_instrument_reset(void) {
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef _LSEA_LSE_INSTRUMENT
+#define _LSEA_LSE_INSTRUMENT 1
+
+// hot path counters and call latency histograms, built only with
+// -DLSE_INSTRUMENT (make INSTRUMENT=1). without it every LSE_INSTRUMENT_*
+// macro expands to nothing and the kernels are unchanged.
+//
+// each thread counts into its own block, so counting takes no lock and
+// shares no cache line. blocks are kept when their thread exits, and
+// lse_instrument_snapshot adds them all up. forked workers (lse_shard)
+// count in their own address space, and are not seen by the parent.
+//
+// counted:
+//     ranges      ranges evaluated by the bucketed kernels, by width
+//     exps        fast_exp calls made by the faster kernels
+//     early exits ranges whose maximum was -inf, so no exp was needed
+//     jit         functions generated and their bytes of code
+//     latency     log2 histograms of call time in ns, one per site below
+//
+// the sites are the public kernel entry points. the per-range functions
+// (faster_log_sum_exp and the like) are not timed: a clock read would
+// cost more than a call.
+
+#include <stdio.h>
+
+#include "types.h"
+
+
+#define LSE_INSTRUMENT_SITE_BB 0            // faster_log_sum_exp_bb_buckets
+#define LSE_INSTRUMENT_SITE_BB_TIER 1       // faster_log_sum_exp_bb_tier
+#define LSE_INSTRUMENT_SITE_BASEBB 2        // log_sum_exp_bb_buckets
+#define LSE_INSTRUMENT_SITE_PLAN 3          // lse_plan_execute: plus LSE_STRATEGY_* - 1
+#define LSE_INSTRUMENT_SITE_PLAN_MULTI 9    // lse_plan_execute_multi
+#define LSE_INSTRUMENT_SITE_TIERED 10       // lse_tiered_execute
+#define LSE_INSTRUMENT_SITE_SHARD 11        // lse_shard_execute
+#define LSE_INSTRUMENT_SITE_QUANT 12        // faster_log_sum_exp_bb_quant
+#define LSE_INSTRUMENT_SITE_MULTI 13        // faster_log_sum_exp_bb_multi
+#define LSE_INSTRUMENT_SITE_PREFETCH 14     // faster_log_sum_exp_bb_prefetch
+#define LSE_INSTRUMENT_SITE_TILED 15        // faster_log_sum_exp_bb_tiled
+#define LSE_INSTRUMENT_SITE_SOA 16          // faster_log_sum_exp_bb_soa
+#define LSE_INSTRUMENT_SITE_BLOCKMAX 17     // faster_log_sum_exp_bb_blockmax
+#define LSE_INSTRUMENT_SITE_EXPCACHE 18     // faster_log_sum_exp_bb_expcache
+#define LSE_INSTRUMENT_SITE_COMPACT 19      // faster_log_sum_exp_bb_compact
+#define LSE_INSTRUMENT_SITE_SAMPLE 20       // faster_log_sum_exp_bb_sample, on success
+#define LSE_INSTRUMENT_SITE_PRUNED 21       // faster_log_sum_exp_bb_pruned
+#define LSE_INSTRUMENT_SITE_INTERP 22       // faster_log_sum_exp_interp
+#define LSE_INSTRUMENT_SITE_SOFTMAX_BB 23   // faster_log_sum_exp_softmax_bb
+#define LSE_INSTRUMENT_SITE_SOFTMAX_SIMD 24 // faster_log_sum_exp_softmax_simd
+#define LSE_INSTRUMENT_SITE_CSR_ROWS 25     // csr_log_sum_exp_rows
+#define LSE_INSTRUMENT_SITE_CSR_SLICES 26   // csr_log_sum_exp_slices
+#define LSE_INSTRUMENT_SITE_GEMM_EXACT_NAIVE 27 // log_gemm_exact_naive
+#define LSE_INSTRUMENT_SITE_GEMM_FAST_NAIVE 28  // log_gemm_fast_naive
+#define LSE_INSTRUMENT_SITE_GEMM_BLOCKED 29 // log_gemm_blocked, on success
+// generated code is called directly, so its callers record these
+#define LSE_INSTRUMENT_SITE_JIT 30          // a reduction_func_t
+#define LSE_INSTRUMENT_SITE_JIT_MULTI 31    // a multi_reduction_func_t
+#define LSE_INSTRUMENT_SITE_JIT_SOFTMAX 32  // a fused_reduction_func_t
+#define LSE_INSTRUMENT_SITES 33
+
+// bucket k counts calls taking under 2^k ns; the last, everything slower
+#define LSE_INSTRUMENT_LATENCY_BUCKETS 40
+
+#define LSE_INSTRUMENT_FORMAT_TEXT 0
+#define LSE_INSTRUMENT_FORMAT_JSON 1
+
+
+typedef struct {
+    long ranges[MAX_BB_WIDTH + 2];  // by width; the last counts wider ranges
+    long exps;
+    long early_exits;
+    long jit_functions;
+    long jit_bytes;
+    long latency[LSE_INSTRUMENT_SITES][LSE_INSTRUMENT_LATENCY_BUCKETS];
+} lse_instrument_counters_t;
+
+
+// these are always declared. built without LSE_INSTRUMENT, the snapshot
+// and write calls return -1 and set errno to ENOSYS.
+
+// sums the blocks of every thread. counts being made meanwhile may or may
+// not be included.
+int lse_instrument_snapshot(lse_instrument_counters_t *counters);
+
+// writes a snapshot as "name value" lines or as one json object. only
+// nonzero latency buckets are written. returns 0, or -1 and sets errno.
+int lse_instrument_write(FILE *f, int format);
+
+// zeroes every thread's block. call it while no thread is counting.
+void lse_instrument_reset(void);
+
+const char *lse_instrument_site_name(int site);
+
+
+#ifdef LSE_INSTRUMENT
+
+#include <time.h>
+
+typedef struct lse_instrument_block {
+    lse_instrument_counters_t counters;
+    struct lse_instrument_block *next;
+} lse_instrument_block_t;
+
+extern __thread lse_instrument_block_t *lse_instrument_local;
+
+// allocates and registers the calling thread's block
+lse_instrument_block_t *lse_instrument_register(void);
+
+
+static inline lse_instrument_counters_t *lse_instrument_counters(void) {
+    lse_instrument_block_t *block = lse_instrument_local;
+    if (__builtin_expect(block == NULL, 0)) {
+        block = lse_instrument_register();
+    }
+    return &(block->counters);
+}
+
+
+static inline void lse_instrument_add(long *counter, long k) {
+    // only the owning thread writes a counter, so a relaxed load and store
+    // is enough. it keeps snapshot's reads from other threads well defined
+    // without a locked add on the hot path.
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + k, __ATOMIC_RELAXED);
+}
+
+
+static inline void lse_instrument_buckets(const range_buckets_t *buckets, int lo, int hi) {
+    lse_instrument_counters_t *c = lse_instrument_counters();
+    int k;
+    for (k = lo; k <= hi; ++k) {
+        lse_instrument_add(&(c->ranges[k]), buckets->start[k + 1] - buckets->start[k]);
+    }
+}
+
+
+static inline long lse_instrument_now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000l + t.tv_nsec;
+}
+
+
+static inline void lse_instrument_latency(int site, long start_ns) {
+    long ns = lse_instrument_now_ns() - start_ns;
+    int k = (ns <= 0) ? 0 : 64 - __builtin_clzl((unsigned long)ns);
+    if (k >= LSE_INSTRUMENT_LATENCY_BUCKETS) {
+        k = LSE_INSTRUMENT_LATENCY_BUCKETS - 1;
+    }
+    lse_instrument_add(&(lse_instrument_counters()->latency[site][k]), 1);
+}
+
+
+// widths lo .. hi of a bucketing; MAX_BB_WIDTH + 1 is the wider ranges
+#define LSE_INSTRUMENT_BUCKETS(buckets, lo, hi) lse_instrument_buckets((buckets), (lo), (hi))
+#define LSE_INSTRUMENT_EXPS(k) lse_instrument_add(&(lse_instrument_counters()->exps), (k))
+#define LSE_INSTRUMENT_EARLY_EXIT() lse_instrument_add(&(lse_instrument_counters()->early_exits), 1)
+#define LSE_INSTRUMENT_JIT(bytes) do { \
+        lse_instrument_add(&(lse_instrument_counters()->jit_functions), 1); \
+        lse_instrument_add(&(lse_instrument_counters()->jit_bytes), (long)(bytes)); \
+    } while (0)
+// declares t, the start of a call timed by LSE_INSTRUMENT_LATENCY
+#define LSE_INSTRUMENT_START(t) long t = lse_instrument_now_ns()
+#define LSE_INSTRUMENT_LATENCY(site, t) lse_instrument_latency((site), (t))
+
+#else
+
+#define LSE_INSTRUMENT_BUCKETS(buckets, lo, hi) do { } while (0)
+#define LSE_INSTRUMENT_EXPS(k) do { } while (0)
+#define LSE_INSTRUMENT_EARLY_EXIT() do { } while (0)
+#define LSE_INSTRUMENT_JIT(bytes) do { } while (0)
+#define LSE_INSTRUMENT_START(t)
+#define LSE_INSTRUMENT_LATENCY(site, t) do { } while (0)
+
+#endif
+
+#endif
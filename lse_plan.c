@@ -0,0 +1,769 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "types.h"
+#include "logsumexp.h"
+#include "jit_logsumexp.h"
+#include "lse.h"
+#include "lse_instrument.h"
+
+
+// README: jit beats fasterbb at 5000 ranges but degrades on larger
+// patterns as the generated code outgrows the instruction cache.
+#define LSE_DEFAULT_JIT_MAX_RANGES 5000
+
+// runs of at least LSE_SLIDING_MIN_RUN ranges (o, w), (o+1, w), ... with
+// LSE_SLIDING_MIN_WIDTH <= w <= LSE_SLIDING_MAX_WIDTH are evaluated with
+// faster_log_sum_exp_sliding. narrower windows are as cheap through the
+// width buckets; the upper bound caps the scratch space on the stack.
+#define LSE_SLIDING_MIN_WIDTH 4
+#define LSE_SLIDING_MAX_WIDTH 256
+#define LSE_SLIDING_MIN_RUN 4
+// windows per faster_log_sum_exp_sliding call
+#define LSE_SLIDING_CHUNK 256
+
+// autotuning scores each candidate strategy by its fastest of
+// LSE_TUNE_REPS executions.
+#define LSE_TUNE_REPS 7
+// the jit is only timed for patterns up to this size; compiling larger
+// ones costs more than tuning could win back.
+#define LSE_TUNE_JIT_MAX_RANGES 100000
+// part of the pattern signature: bump when kernels change enough to
+// invalidate cached decisions.
+#define LSE_TUNE_VERSION 1
+// cpuid brand string, 48 bytes and a terminator
+#define LSE_TUNE_CPU_SIZE 49
+
+
+typedef struct {
+    int u;      // first of count consecutive entries of plan->ranges
+    int count;
+} lse_run_t;
+
+
+struct lse_plan {
+    int strategy;
+    int accuracy;               // LSE_ACCURACY_*, equal to the APPROX_TIER_* value
+    int n;                      // number of ranges given to lse_plan_create
+    int extent;                 // max offset + width: length of data the plan reads
+    int n_unique;               // number of ranges evaluated per execute
+    range_t *ranges;            // n_unique ranges, sorted by width then offset
+    range_buckets_t buckets;    // width buckets of ranges[0 .. n_bucketed)
+    int n_bucketed;
+    // ranges[n_bucketed .. n_unique) form runs of sliding windows
+    int n_runs;
+    lse_run_t *runs;
+    // origin[origin_start[u] .. origin_start[u+1]) are the indices of the
+    // original ranges equal to ranges[u].
+    int *origin_start;
+    int *origin;
+    int has_duplicates;
+    jit_reduction_func_t jf;
+};
+
+
+void lse_options_init(lse_options_t *options) {
+    options->strategy = LSE_STRATEGY_AUTO;
+    options->dedup = 1;
+    options->jit_max_ranges = LSE_DEFAULT_JIT_MAX_RANGES;
+    options->sliding = 0;
+    options->accuracy = LSE_ACCURACY_RAW;
+    options->tune = 0;
+    options->tune_cache = NULL;
+    options->tune_logps = NULL;
+}
+
+
+static void find_buckets(const range_t *ranges, int n, range_buckets_t *buckets) {
+    // pre-req: ranges sorted by width
+    int i, w;
+    i = 0;
+    for (w = 0; w <= MAX_BB_WIDTH + 1; ++w) {
+        buckets->start[w] = i;
+        while (i < n && ranges[i].width == w) {
+            ++i;
+        }
+    }
+    buckets->start[MAX_BB_WIDTH + 2] = n;
+}
+
+
+static int jit_supported(const lse_plan_t *plan) {
+    // the jit code templates only cover widths 1 -- 10.
+    const int *b = plan->buckets.start;
+    int u;
+    for (u = plan->n_bucketed; u < plan->n_unique; ++u) {
+        if (plan->ranges[u].width > MAX_BB_WIDTH) {
+            return 0;
+        }
+    }
+    return (b[1] == 0) && (b[MAX_BB_WIDTH + 1] == plan->n_bucketed);
+}
+
+
+static int find_runs(lse_plan_t *plan) {
+    // pre-req: plan->ranges unique and sorted by width then offset.
+    //
+    // moves the ranges of sliding window runs after all other ranges,
+    // keeping origin_start / origin in step. returns 0 on success or an
+    // errno value.
+    const range_t *r = plan->ranges;
+    range_t *ranges;
+    int *origin_start, *origin, *in_run;
+    int u, v, k, p, q, pass, n_runs;
+
+    in_run = calloc(plan->n_unique + 1, sizeof(int));
+    if (in_run == NULL) {
+        return ENOMEM;
+    }
+    n_runs = 0;
+    for (u = 0; u < plan->n_unique; u = v) {
+        for (v = u + 1; v < plan->n_unique; ++v) {
+            if (r[v].width != r[u].width || r[v].offset != r[v - 1].offset + 1) {
+                break;
+            }
+        }
+        if (v - u >= LSE_SLIDING_MIN_RUN &&
+                r[u].width >= LSE_SLIDING_MIN_WIDTH && r[u].width <= LSE_SLIDING_MAX_WIDTH) {
+            for (k = u; k < v; ++k) {
+                in_run[k] = 1;
+            }
+            ++n_runs;
+        }
+    }
+    if (n_runs == 0) {
+        free(in_run);
+        plan->n_bucketed = plan->n_unique;
+        return 0;
+    }
+
+    ranges = malloc(plan->n_unique * sizeof(range_t));
+    origin_start = malloc((plan->n_unique + 1) * sizeof(int));
+    origin = malloc(plan->n * sizeof(int));
+    plan->runs = malloc(n_runs * sizeof(lse_run_t));
+    if (ranges == NULL || origin_start == NULL || origin == NULL || plan->runs == NULL) {
+        free(in_run);
+        free(ranges);
+        free(origin_start);
+        free(origin);
+        return ENOMEM;
+    }
+
+    // pass 0 copies the ranges outside runs, pass 1 those inside
+    p = 0;
+    q = 0;
+    plan->n_bucketed = 0;
+    for (pass = 0; pass < 2; ++pass) {
+        for (u = 0; u < plan->n_unique; ++u) {
+            if (in_run[u] != pass) {
+                continue;
+            }
+            if (pass == 0) {
+                plan->n_bucketed = p + 1;
+            } else if (p == plan->n_bucketed || ranges[p - 1].width != r[u].width ||
+                    ranges[p - 1].offset + 1 != r[u].offset) {
+                plan->runs[plan->n_runs].u = p;
+                plan->runs[plan->n_runs].count = 0;
+                ++(plan->n_runs);
+            }
+            if (pass == 1) {
+                ++(plan->runs[plan->n_runs - 1].count);
+            }
+            ranges[p] = r[u];
+            origin_start[p] = q;
+            for (k = plan->origin_start[u]; k < plan->origin_start[u + 1]; ++k) {
+                origin[q++] = plan->origin[k];
+            }
+            ++p;
+        }
+    }
+    origin_start[p] = q;
+
+    free(in_run);
+    free(plan->ranges);
+    free(plan->origin_start);
+    free(plan->origin);
+    plan->ranges = ranges;
+    plan->origin_start = origin_start;
+    plan->origin = origin;
+    return 0;
+}
+
+
+static int build_jit(lse_plan_t *plan) {
+    // the generated code has no notion of multiplicity, so compile the
+    // full sorted pattern, duplicates included.
+    int k, u, status;
+    range_t *sorted;
+
+    sorted = malloc(plan->n * sizeof(range_t) + 1);
+    if (sorted == NULL) {
+        return ENOMEM;
+    }
+    for (u = 0; u < plan->n_unique; ++u) {
+        for (k = plan->origin_start[u]; k < plan->origin_start[u + 1]; ++k) {
+            sorted[k] = plan->ranges[u];
+        }
+    }
+    status = make_batch_log_sum_exp_jit_reduction_func_tier(sorted, plan->n, plan->accuracy, &(plan->jf));
+    free(sorted);
+    if (status != 0) {
+        return ENOMEM;
+    }
+    status = arm_jit_reduction_func(&(plan->jf));
+    if (status != 0) {
+        status = errno;
+        release_jit_reduction_func(&(plan->jf));
+        return status;
+    }
+    return 0;
+}
+
+
+static void tune_cpu_model(char *model) {
+    // the cpuid brand string, or "unknown"
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int regs[12];
+    char *p;
+    if (__get_cpuid_max(0x80000000, NULL) >= 0x80000004 &&
+            __get_cpuid(0x80000002, &regs[0], &regs[1], &regs[2], &regs[3]) &&
+            __get_cpuid(0x80000003, &regs[4], &regs[5], &regs[6], &regs[7]) &&
+            __get_cpuid(0x80000004, &regs[8], &regs[9], &regs[10], &regs[11])) {
+        memcpy(model, regs, LSE_TUNE_CPU_SIZE - 1);
+        model[LSE_TUNE_CPU_SIZE - 1] = '\0';
+        for (p = model; *p == ' '; ++p) {
+        }
+        memmove(model, p, strlen(p) + 1);
+        return;
+    }
+#endif
+    strcpy(model, "unknown");
+}
+
+
+static unsigned long tune_signature(const lse_plan_t *plan) {
+    // 64 bit fnv-1a over everything that affects the timings
+    unsigned long h = 0xcbf29ce484222325ul;
+    int key[6];
+    int u, i;
+    key[0] = LSE_TUNE_VERSION;
+    key[1] = plan->n;
+    key[2] = plan->n_unique;
+    key[3] = plan->n_bucketed;
+    key[4] = plan->accuracy;
+    key[5] = plan->has_duplicates;
+    for (i = 0; i < (int)sizeof(key); ++i) {
+        h = (h ^ ((unsigned char *)key)[i]) * 0x100000001b3ul;
+    }
+    for (u = 0; u < plan->n_unique; ++u) {
+        for (i = 0; i < (int)sizeof(range_t); ++i) {
+            h = (h ^ ((unsigned char *)&(plan->ranges[u]))[i]) * 0x100000001b3ul;
+        }
+    }
+    return h;
+}
+
+
+static int read_tune_cache(const char *path, unsigned long signature, const char *model, int *strategy) {
+    // lines are "<signature> <strategy> <cpu model>". returns 0 if found.
+    char line[LSE_TUNE_CPU_SIZE + 64];
+    unsigned long s;
+    size_t len;
+    int k, at, found = 1;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n') {
+            line[len - 1] = '\0';
+        }
+        if (sscanf(line, "%lx %d %n", &s, &k, &at) == 2 && s == signature && strcmp(line + at, model) == 0) {
+            // later lines win
+            *strategy = k;
+            found = 0;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+
+static void append_tune_cache(const char *path, unsigned long signature, const char *model, int strategy) {
+    // best effort: an unwritable cache only costs a retune next time
+    FILE *f;
+    f = fopen(path, "a");
+    if (f == NULL) {
+        return;
+    }
+    fprintf(f, "%016lx %d %s\n", signature, strategy, model);
+    fclose(f);
+}
+
+
+static double time_strategy(lse_plan_t *plan, int strategy, double *logps) {
+    struct timespec t0, t1;
+    double t, best = INFINITY;
+    int r;
+    plan->strategy = strategy;
+    for (r = 0; r < LSE_TUNE_REPS; ++r) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        lse_plan_execute(plan, logps, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        t = (double)(t1.tv_sec - t0.tv_sec) + 1e-9 * (double)(t1.tv_nsec - t0.tv_nsec);
+        best = (t < best) ? t : best;
+    }
+    return best;
+}
+
+
+static int tune_strategy(lse_plan_t *plan, const lse_options_t *options) {
+    // sets plan->strategy to the fastest of faster, bb and jit, building
+    // the jit if it wins. returns 0, or ENOMEM.
+    char model[LSE_TUNE_CPU_SIZE];
+    unsigned long signature, x;
+    double *logps, t, t_best;
+    int i, strategy;
+
+    tune_cpu_model(model);
+    signature = tune_signature(plan);
+    if (options->tune_cache != NULL && read_tune_cache(options->tune_cache, signature, model, &strategy) == 0) {
+        if (strategy == LSE_STRATEGY_FASTER || strategy == LSE_STRATEGY_BB) {
+            plan->strategy = strategy;
+            return 0;
+        }
+        if (strategy == LSE_STRATEGY_JIT && jit_supported(plan) && build_jit(plan) == 0) {
+            plan->strategy = strategy;
+            return 0;
+        }
+        // unusable entry: tune again
+    }
+
+    if (options->tune_logps != NULL) {
+        logps = (double *)options->tune_logps;
+    } else {
+        // log of uniform (0, 1] samples from a fixed lcg, so tuning does
+        // not disturb the caller's rand() sequence
+        logps = malloc(plan->extent * sizeof(double) + 1);
+        if (logps == NULL) {
+            return ENOMEM;
+        }
+        x = 12345;
+        for (i = 0; i < plan->extent; ++i) {
+            x = x * 6364136223846793005ul + 1442695040888963407ul;
+            logps[i] = log((double)((x >> 11) + 1) / 9007199254740992.0);
+        }
+    }
+
+    strategy = LSE_STRATEGY_BB;
+    t_best = time_strategy(plan, LSE_STRATEGY_BB, logps);
+    t = time_strategy(plan, LSE_STRATEGY_FASTER, logps);
+    if (t < t_best) {
+        strategy = LSE_STRATEGY_FASTER;
+        t_best = t;
+    }
+    if (plan->n > 0 && plan->n <= LSE_TUNE_JIT_MAX_RANGES && jit_supported(plan) && build_jit(plan) == 0) {
+        t = time_strategy(plan, LSE_STRATEGY_JIT, logps);
+        if (t < t_best) {
+            strategy = LSE_STRATEGY_JIT;
+            t_best = t;
+        } else {
+            release_jit_reduction_func(&(plan->jf));
+        }
+    }
+    plan->strategy = strategy;
+
+    if (logps != options->tune_logps) {
+        free(logps);
+    }
+    if (options->tune_cache != NULL) {
+        append_tune_cache(options->tune_cache, signature, model, strategy);
+    }
+    return 0;
+}
+
+
+lse_plan_t *lse_plan_create(const range_t *ranges, int n, const lse_options_t *options) {
+    lse_options_t defaults;
+    lse_plan_t *plan;
+    range_t r;
+    int k, u, status;
+
+    if (options == NULL) {
+        lse_options_init(&defaults);
+        options = &defaults;
+    }
+    if (n < 0 || (n > 0 && ranges == NULL) ||
+            options->strategy < LSE_STRATEGY_AUTO || options->strategy > LSE_STRATEGY_BASEBB ||
+            options->accuracy < LSE_ACCURACY_RAW || options->accuracy > LSE_ACCURACY_POLY) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    plan = calloc(1, sizeof(lse_plan_t));
+    if (plan == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    plan->n = n;
+    plan->accuracy = options->accuracy;
+    plan->ranges = malloc(n * sizeof(range_t) + 1);
+    plan->origin_start = malloc((n + 1) * sizeof(int));
+    plan->origin = malloc(n * sizeof(int) + 1);
+    if (plan->ranges == NULL || plan->origin_start == NULL || plan->origin == NULL) {
+        lse_plan_destroy(plan);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    status = order_ranges_bucketed(ranges, n, plan->origin, NULL);
+    if (status != 0) {
+        lse_plan_destroy(plan);
+        errno = (status == 1) ? EINVAL : ENOMEM;
+        return NULL;
+    }
+
+    // walk the sorted order, merging equal ranges when deduplicating.
+    u = 0;
+    for (k = 0; k < n; ++k) {
+        r = ranges[plan->origin[k]];
+        if (options->dedup && u > 0 &&
+                r.width == plan->ranges[u - 1].width && r.offset == plan->ranges[u - 1].offset) {
+            plan->has_duplicates = 1;
+            continue;
+        }
+        plan->ranges[u] = r;
+        plan->origin_start[u] = k;
+        ++u;
+    }
+    plan->n_unique = u;
+    plan->origin_start[u] = n;
+    for (u = 0; u < plan->n_unique; ++u) {
+        r = plan->ranges[u];
+        if (r.offset + r.width > plan->extent) {
+            plan->extent = r.offset + r.width;
+        }
+    }
+
+    plan->n_bucketed = plan->n_unique;
+    // the sliding kernel is built on the raw tier only. only the bb
+    // strategy applies runs on every path, so no other plan gets them:
+    // its total would depend on out, or on which execute was called.
+    if (options->sliding && plan->accuracy == LSE_ACCURACY_RAW &&
+            (options->strategy == LSE_STRATEGY_BB || options->strategy == LSE_STRATEGY_AUTO)) {
+        status = find_runs(plan);
+        if (status != 0) {
+            lse_plan_destroy(plan);
+            errno = status;
+            return NULL;
+        }
+    }
+    find_buckets(plan->ranges, plan->n_bucketed, &(plan->buckets));
+
+    plan->strategy = options->strategy;
+    if (plan->strategy == LSE_STRATEGY_AUTO && plan->n_runs > 0) {
+        // the jit and faster candidates would ignore the runs
+        plan->strategy = LSE_STRATEGY_BB;
+    } else if (plan->strategy == LSE_STRATEGY_AUTO && options->tune) {
+        status = tune_strategy(plan, options);
+        if (status != 0) {
+            lse_plan_destroy(plan);
+            errno = status;
+            return NULL;
+        }
+    } else if (plan->strategy == LSE_STRATEGY_AUTO) {
+        plan->strategy = LSE_STRATEGY_BB;
+        if (n > 0 && n <= options->jit_max_ranges && jit_supported(plan) && build_jit(plan) == 0) {
+            plan->strategy = LSE_STRATEGY_JIT;
+        }
+    } else if (plan->strategy == LSE_STRATEGY_JIT) {
+        status = jit_supported(plan) ? build_jit(plan) : EINVAL;
+        if (status != 0) {
+            lse_plan_destroy(plan);
+            errno = status;
+            return NULL;
+        }
+    }
+    return plan;
+}
+
+
+void lse_plan_destroy(lse_plan_t *plan) {
+    if (plan == NULL) {
+        return;
+    }
+    release_jit_reduction_func(&(plan->jf));
+    free(plan->runs);
+    free(plan->origin);
+    free(plan->origin_start);
+    free(plan->ranges);
+    free(plan);
+}
+
+
+int lse_plan_strategy(const lse_plan_t *plan) {
+    return plan->strategy;
+}
+
+
+int lse_plan_n_ranges(const lse_plan_t *plan) {
+    return plan->n;
+}
+
+
+int lse_plan_n_unique(const lse_plan_t *plan) {
+    return plan->n_unique;
+}
+
+
+static inline double emit_result(const lse_plan_t *plan, int u, double v, double *out) {
+    // scatter v to every original range equal to ranges[u], and return v
+    // weighted by the number of such ranges.
+    int k, k0, k1;
+    k0 = plan->origin_start[u];
+    k1 = plan->origin_start[u + 1];
+    if (out != NULL) {
+        for (k = k0; k < k1; ++k) {
+            out[plan->origin[k]] = v;
+        }
+    }
+    return (double)(k1 - k0) * v;
+}
+
+
+static double execute_generic(const lse_plan_t *plan, double *logps, double *out,
+        double (*f)(double *, int)) {
+    const range_t *r = plan->ranges;
+    double acc = 0.0;
+    int u;
+    for (u = 0; u < plan->n_unique; ++u) {
+        acc += emit_result(plan, u, f(&(logps[r[u].offset]), r[u].width), out);
+    }
+    return acc;
+}
+
+
+static double execute_runs(const lse_plan_t *plan, double *logps, double *out) {
+    double scratch[2 * LSE_SLIDING_MAX_WIDTH];
+    double v[LSE_SLIDING_CHUNK];
+    const range_t *r = plan->ranges;
+    double acc = 0.0;
+    int i, u, u_end, count, k;
+
+    for (i = 0; i < plan->n_runs; ++i) {
+        u_end = plan->runs[i].u + plan->runs[i].count;
+        for (u = plan->runs[i].u; u < u_end; u += count) {
+            count = (u_end - u < LSE_SLIDING_CHUNK) ? u_end - u : LSE_SLIDING_CHUNK;
+            faster_log_sum_exp_sliding(&(logps[r[u].offset]), r[u].width, count, scratch, v);
+            for (k = 0; k < count; ++k) {
+                acc += emit_result(plan, u + k, v[k], out);
+            }
+        }
+    }
+    return acc;
+}
+
+
+static double execute_bb(const lse_plan_t *plan, double *logps, double *out) {
+    const range_t *r = plan->ranges;
+    const int *b = plan->buckets.start;
+    double acc = 0.0;
+    int u;
+
+    acc += execute_runs(plan, logps, out);
+
+    // empty and over-wide ranges are outside the specialised kernels
+    LSE_INSTRUMENT_BUCKETS(&(plan->buckets), 0, 0);
+    LSE_INSTRUMENT_BUCKETS(&(plan->buckets), MAX_BB_WIDTH + 1, MAX_BB_WIDTH + 1);
+    for (u = b[0]; u < b[1]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp(&(logps[r[u].offset]), 0), out);
+    }
+    for (u = b[MAX_BB_WIDTH + 1]; u < b[MAX_BB_WIDTH + 2]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp(&(logps[r[u].offset]), r[u].width), out);
+    }
+
+    if (out == NULL && !plan->has_duplicates) {
+        return acc + faster_log_sum_exp_bb_buckets(plan->ranges, &(plan->buckets), logps);
+    }
+
+    LSE_INSTRUMENT_BUCKETS(&(plan->buckets), 1, MAX_BB_WIDTH);
+    for (u = b[1]; u < b[2]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_1(&(logps[r[u].offset])), out);
+    }
+    for (u = b[2]; u < b[3]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_2(&(logps[r[u].offset])), out);
+    }
+    for (u = b[3]; u < b[4]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_3(&(logps[r[u].offset])), out);
+    }
+    for (u = b[4]; u < b[5]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_4(&(logps[r[u].offset])), out);
+    }
+    for (u = b[5]; u < b[6]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_5(&(logps[r[u].offset])), out);
+    }
+    for (u = b[6]; u < b[7]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_6(&(logps[r[u].offset])), out);
+    }
+    for (u = b[7]; u < b[8]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_7(&(logps[r[u].offset])), out);
+    }
+    for (u = b[8]; u < b[9]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_8(&(logps[r[u].offset])), out);
+    }
+    for (u = b[9]; u < b[10]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_9(&(logps[r[u].offset])), out);
+    }
+    for (u = b[10]; u < b[11]; ++u) {
+        acc += emit_result(plan, u, faster_log_sum_exp_10(&(logps[r[u].offset])), out);
+    }
+    return acc;
+}
+
+
+static double execute_bb_tier(const lse_plan_t *plan, double *logps, double *out) {
+    // the table and poly tiers have no per-width kernels with a result per
+    // range, and never have sliding window runs.
+    if (out == NULL && !plan->has_duplicates) {
+        return faster_log_sum_exp_bb_tier(plan->ranges, &(plan->buckets), logps, plan->accuracy);
+    }
+    if (plan->accuracy == LSE_ACCURACY_POLY) {
+        return execute_generic(plan, logps, out, faster_log_sum_exp_poly);
+    }
+    return execute_generic(plan, logps, out, faster_log_sum_exp_table);
+}
+
+
+static double execute(const lse_plan_t *plan, double *logps, double *out) {
+    if (plan->accuracy != LSE_ACCURACY_RAW) {
+        switch (plan->strategy) {
+        case LSE_STRATEGY_FASTER:
+            if (plan->accuracy == LSE_ACCURACY_POLY) {
+                return execute_generic(plan, logps, out, faster_log_sum_exp_poly);
+            }
+            return execute_generic(plan, logps, out, faster_log_sum_exp_table);
+        case LSE_STRATEGY_BB:
+            return execute_bb_tier(plan, logps, out);
+        case LSE_STRATEGY_JIT:
+            if (out == NULL) {
+                return plan->jf.f(logps, plan->ranges, plan->n);
+            }
+            return execute_bb_tier(plan, logps, out);
+        default:
+            // base, fast and basebb do not use fast_log
+            break;
+        }
+    }
+
+    switch (plan->strategy) {
+    case LSE_STRATEGY_BASE:
+        return execute_generic(plan, logps, out, log_sum_exp);
+    case LSE_STRATEGY_FAST:
+        return execute_generic(plan, logps, out, fast_log_sum_exp);
+    case LSE_STRATEGY_FASTER:
+        return execute_generic(plan, logps, out, faster_log_sum_exp);
+    case LSE_STRATEGY_BASEBB:
+        if (out == NULL && !plan->has_duplicates) {
+            return log_sum_exp_bb_buckets(plan->ranges, &(plan->buckets), logps);
+        }
+        return execute_generic(plan, logps, out, log_sum_exp);
+    case LSE_STRATEGY_JIT:
+        if (out == NULL) {
+            // ranges and n are baked into the generated code
+            return plan->jf.f(logps, plan->ranges, plan->n);
+        }
+        // the generated code only produces the total
+        return execute_bb(plan, logps, out);
+    default:
+        return execute_bb(plan, logps, out);
+    }
+}
+
+
+double lse_plan_execute(const lse_plan_t *plan, double *logps, double *out) {
+    double total;
+    LSE_INSTRUMENT_START(t0);
+    total = execute(plan, logps, out);
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_PLAN + plan->strategy - 1, t0);
+    return total;
+}
+
+
+static int execute_multi_each(const lse_plan_t *plan, const double *logps, int k, double *totals) {
+    // execute once per vector on a de-interleaved copy
+    double *a;
+    int i, v;
+    a = malloc(plan->extent * sizeof(double) + 1);
+    if (a == NULL) {
+        return ENOMEM;
+    }
+    for (v = 0; v < k; ++v) {
+        for (i = 0; i < plan->extent; ++i) {
+            a[i] = logps[(size_t)i * k + v];
+        }
+        totals[v] = lse_plan_execute(plan, a, NULL);
+    }
+    free(a);
+    return 0;
+}
+
+
+static int execute_multi_ranges(const lse_plan_t *plan, const double *logps, int k, double *totals) {
+    // one range at a time over all k vectors, weighted by multiplicity
+    const range_t *r = plan->ranges;
+    double *row, count;
+    int u, v;
+    row = malloc(k * sizeof(double));
+    if (row == NULL) {
+        return ENOMEM;
+    }
+    for (v = 0; v < k; ++v) {
+        totals[v] = 0.0;
+    }
+    for (u = 0; u < plan->n_unique; ++u) {
+        faster_log_sum_exp_multi(&(logps[(size_t)r[u].offset * k]), r[u].width, k, row);
+        count = (double)(plan->origin_start[u + 1] - plan->origin_start[u]);
+        for (v = 0; v < k; ++v) {
+            totals[v] += count * row[v];
+        }
+    }
+    free(row);
+    return 0;
+}
+
+
+int lse_plan_execute_multi(const lse_plan_t *plan, const double *logps, int k, double *totals) {
+    int status;
+    LSE_INSTRUMENT_START(t0);
+    if (k < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (plan->accuracy != LSE_ACCURACY_RAW || plan->n_runs > 0 || (plan->strategy != LSE_STRATEGY_FASTER &&
+            plan->strategy != LSE_STRATEGY_BB && plan->strategy != LSE_STRATEGY_JIT)) {
+        // the vectors one at a time, so sliding window runs give the same
+        // totals as lse_plan_execute
+        status = execute_multi_each(plan, logps, k, totals);
+    } else if (!plan->has_duplicates && plan->n_bucketed == plan->n_unique) {
+        faster_log_sum_exp_bb_multi(plan->ranges, &(plan->buckets), logps, k, totals);
+        status = 0;
+    } else {
+        status = execute_multi_ranges(plan, logps, k, totals);
+    }
+    if (status != 0) {
+        errno = status;
+        return -1;
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_PLAN_MULTI, t0);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef _LSEA_LSE_SERVICE
+#define _LSEA_LSE_SERVICE 1
+
+// client side of lsed, a local daemon that holds prepared patterns and
+// data vectors and evaluates them on request over a unix domain socket.
+// clients pay for planning and jit once per pattern, not once per process.
+//
+// the protocol is binary, in host byte order (the socket is local). each
+// request is an lse_service_request_t then a payload:
+//
+//     op                          a           b           payload
+//     LSE_SERVICE_OP_PATTERN      n           0           n range_t
+//     LSE_SERVICE_OP_DATA         m           0           m doubles
+//     LSE_SERVICE_OP_UPDATE       handle      m           m doubles
+//     LSE_SERVICE_OP_EVALUATE     pattern     data        none
+//     LSE_SERVICE_OP_STATS        0           0           none
+//
+// each request gets an lse_service_reply_t with the same id. status is 0
+// or an errno value: ENOENT for an unknown handle, EINVAL for an invalid
+// pattern or data shorter than the pattern reads. PATTERN and DATA return
+// a handle; EVALUATE returns the total in value; STATS is followed by a
+// text payload of size bytes.
+// evaluations of one pattern that reach the daemon together run as one
+// batched kernel call over all their data vectors. an EVALUATE sees every
+// UPDATE that reached the daemon before it and none after, and is
+// answered before such a later UPDATE.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+
+#define LSE_SERVICE_OP_PATTERN 1
+#define LSE_SERVICE_OP_DATA 2
+#define LSE_SERVICE_OP_UPDATE 3
+#define LSE_SERVICE_OP_EVALUATE 4
+#define LSE_SERVICE_OP_STATS 5
+
+// largest payload lsed accepts, in bytes
+#define LSE_SERVICE_MAX_PAYLOAD (1u << 30)
+
+
+typedef struct {
+    uint32_t op;
+    uint32_t id;
+    uint32_t a;
+    uint32_t b;
+} lse_service_request_t;
+
+
+typedef struct {
+    int32_t status;
+    uint32_t id;
+    uint32_t handle;
+    uint32_t size;
+    double value;
+} lse_service_reply_t;
+
+
+// all return 0, or -1 and set errno: to the daemon's status, or to the
+// errno of a failed socket call. a connection is used from one thread at
+// a time, one request in flight.
+int lse_service_connect(const char *path);
+int lse_service_pattern(int fd, const range_t *ranges, int n, uint32_t *handle);
+int lse_service_data(int fd, const double *logps, int m, uint32_t *handle);
+int lse_service_update(int fd, uint32_t handle, const double *logps, int m);
+int lse_service_evaluate(int fd, uint32_t pattern, uint32_t data, double *total);
+// text as "name value" lines, truncated to fit size bytes with a terminator
+int lse_service_stats(int fd, char *text, size_t size);
+
+#endif
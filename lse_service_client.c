@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "types.h"
+#include "lse_service.h"
+
+
+static int write_all(int fd, const void *p, size_t size) {
+    const char *c = p;
+    ssize_t k;
+    while (size > 0) {
+        k = send(fd, c, size, MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        c += k;
+        size -= k;
+    }
+    return 0;
+}
+
+
+static int read_all(int fd, void *p, size_t size) {
+    char *c = p;
+    ssize_t k;
+    while (size > 0) {
+        k = read(fd, c, size);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (k == 0) {
+            errno = ECONNRESET;
+            return -1;
+        }
+        c += k;
+        size -= k;
+    }
+    return 0;
+}
+
+
+static int call(int fd, uint32_t op, uint32_t a, uint32_t b, const void *payload, size_t size,
+        lse_service_reply_t *reply) {
+    // one request, one reply. a text payload after the reply is left for
+    // the caller to read.
+    static uint32_t next_id = 0;
+    lse_service_request_t request;
+
+    request.op = op;
+    request.id = __sync_add_and_fetch(&next_id, 1);
+    request.a = a;
+    request.b = b;
+    if (write_all(fd, &request, sizeof(request)) != 0 || (size > 0 && write_all(fd, payload, size) != 0)) {
+        return -1;
+    }
+    if (read_all(fd, reply, sizeof(*reply)) != 0) {
+        return -1;
+    }
+    if (reply->id != request.id) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+
+static int check(const lse_service_reply_t *reply) {
+    if (reply->status != 0) {
+        errno = reply->status;
+        return -1;
+    }
+    return 0;
+}
+
+
+int lse_service_connect(const char *path) {
+    struct sockaddr_un addr;
+    int fd, saved;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+
+int lse_service_pattern(int fd, const range_t *ranges, int n, uint32_t *handle) {
+    lse_service_reply_t reply;
+    if (n < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (call(fd, LSE_SERVICE_OP_PATTERN, n, 0, ranges, n * sizeof(range_t), &reply) != 0 || check(&reply) != 0) {
+        return -1;
+    }
+    *handle = reply.handle;
+    return 0;
+}
+
+
+int lse_service_data(int fd, const double *logps, int m, uint32_t *handle) {
+    lse_service_reply_t reply;
+    if (m < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (call(fd, LSE_SERVICE_OP_DATA, m, 0, logps, m * sizeof(double), &reply) != 0 || check(&reply) != 0) {
+        return -1;
+    }
+    *handle = reply.handle;
+    return 0;
+}
+
+
+int lse_service_update(int fd, uint32_t handle, const double *logps, int m) {
+    lse_service_reply_t reply;
+    if (m < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (call(fd, LSE_SERVICE_OP_UPDATE, handle, m, logps, m * sizeof(double), &reply) != 0) {
+        return -1;
+    }
+    return check(&reply);
+}
+
+
+int lse_service_evaluate(int fd, uint32_t pattern, uint32_t data, double *total) {
+    lse_service_reply_t reply;
+    if (call(fd, LSE_SERVICE_OP_EVALUATE, pattern, data, NULL, 0, &reply) != 0 || check(&reply) != 0) {
+        return -1;
+    }
+    *total = reply.value;
+    return 0;
+}
+
+
+int lse_service_stats(int fd, char *text, size_t size) {
+    lse_service_reply_t reply;
+    char drain[256];
+    size_t keep, left, k;
+
+    if (call(fd, LSE_SERVICE_OP_STATS, 0, 0, NULL, 0, &reply) != 0 || check(&reply) != 0) {
+        return -1;
+    }
+    // keep what fits, drain the rest
+    keep = (size == 0) ? 0 : (reply.size < size - 1) ? reply.size : size - 1;
+    if (read_all(fd, text, keep) != 0) {
+        return -1;
+    }
+    for (left = reply.size - keep; left > 0; left -= k) {
+        k = (left < sizeof(drain)) ? left : sizeof(drain);
+        if (read_all(fd, drain, k) != 0) {
+            return -1;
+        }
+    }
+    if (size > 0) {
+        text[keep] = '\0';
+    }
+    return 0;
+}
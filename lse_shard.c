@@ -0,0 +1,348 @@
+// for sched_setaffinity
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "types.h"
+#include "fast_approx.h"
+#include "logsumexp.h"
+#include "lse_shard.h"
+#include "lse_instrument.h"
+
+
+// how often a coordinator waiting on the workers checks that they live
+#define LSE_SHARD_POLL_NS 100000000
+
+
+// one per worker, a cache line each so partial sums do not false share
+typedef struct {
+    double partial;
+    char pad[64 - sizeof(double)];
+} lse_shard_partial_t;
+
+
+// start of the shared segment. the ranges, in shard order, follow at
+// ranges_at bytes and the data at logps_at bytes.
+typedef struct {
+    int n_workers;
+    int n;
+    int m;
+    int stop;                   // set before the final go: workers exit
+    size_t ranges_at;
+    size_t logps_at;
+    sem_t go[LSE_SHARD_MAX_WORKERS];
+    sem_t done;
+    range_buckets_t shard[LSE_SHARD_MAX_WORKERS];  // indices into the shared ranges
+    lse_shard_partial_t partial[LSE_SHARD_MAX_WORKERS];
+} lse_shard_segment_t;
+
+
+struct lse_shard {
+    lse_shard_segment_t *seg;
+    size_t size;
+    pid_t pid[LSE_SHARD_MAX_WORKERS];
+    int n_started;
+    int failed;
+};
+
+
+static size_t align64(size_t x) {
+    return (x + 63) & ~(size_t)63;
+}
+
+
+static void worker_loop(lse_shard_segment_t *seg, int w) {
+    range_t *ranges = (range_t *)((char *)seg + seg->ranges_at);
+    double *logps = (double *)((char *)seg + seg->logps_at);
+
+    for (;;) {
+        while (sem_wait(&(seg->go[w])) != 0) {
+            if (errno != EINTR) {
+                _exit(1);
+            }
+        }
+        if (seg->stop) {
+            _exit(0);
+        }
+        seg->partial[w].partial = faster_log_sum_exp_bb_tier(ranges, &(seg->shard[w]), logps, APPROX_TIER_RAW);
+        sem_post(&(seg->done));
+    }
+}
+
+
+static void split_shards(const range_t *sorted, const range_buckets_t *buckets, lse_shard_segment_t *seg) {
+    // copy sorted into the segment shard by shard. each width bucket is
+    // split into equal counts; the wide bucket into equal total widths,
+    // a range going to the shard that holds the midpoint of its width.
+    const int *b = buckets->start;
+    range_t *ranges = (range_t *)((char *)seg + seg->ranges_at);
+    const int p = seg->n_workers;
+    long total, before;
+    int w, k, i, count, lo, hi, q;
+
+    total = 0;
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        total += sorted[i].width;
+    }
+
+    q = 0;
+    for (w = 0; w < p; ++w) {
+        for (k = 0; k <= MAX_BB_WIDTH; ++k) {
+            seg->shard[w].start[k] = q;
+            count = b[k + 1] - b[k];
+            lo = b[k] + (int)((long)count * w / p);
+            hi = b[k] + (int)((long)count * (w + 1) / p);
+            for (i = lo; i < hi; ++i) {
+                ranges[q++] = sorted[i];
+            }
+        }
+        seg->shard[w].start[MAX_BB_WIDTH + 1] = q;
+        before = 0;
+        for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+            // 2 * before + width is twice the midpoint
+            if ((2 * before + sorted[i].width) * p >= 2 * total * w &&
+                    (2 * before + sorted[i].width) * p < 2 * total * (w + 1)) {
+                ranges[q++] = sorted[i];
+            }
+            before += sorted[i].width;
+        }
+        seg->shard[w].start[MAX_BB_WIDTH + 2] = q;
+    }
+}
+
+
+static void pin_worker(int w) {
+    // best effort
+    cpu_set_t allowed, one;
+    int cpu, k, count;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+    count = CPU_COUNT(&allowed);
+    if (count == 0) {
+        return;
+    }
+    k = w % count;
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed) && k-- == 0) {
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            sched_setaffinity(0, sizeof(one), &one);
+            return;
+        }
+    }
+}
+
+
+lse_shard_t *lse_shard_create(const range_t *ranges, int n, int m, int n_workers, int pin) {
+    static int serial = 0;
+    range_buckets_t buckets;
+    lse_shard_segment_t *seg;
+    lse_shard_t *shard;
+    range_t *sorted;
+    char name[64];
+    int i, fd, status;
+    pid_t pid, parent;
+
+    if (n < 0 || m < 0 || (n > 0 && ranges == NULL) || n_workers < 1 || n_workers > LSE_SHARD_MAX_WORKERS) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (i = 0; i < n; ++i) {
+        if (ranges[i].offset < 0 || ranges[i].width < 0 || ranges[i].offset > m - ranges[i].width) {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    sorted = malloc(n * sizeof(range_t) + 1);
+    shard = calloc(1, sizeof(lse_shard_t));
+    if (sorted == NULL || shard == NULL) {
+        free(sorted);
+        free(shard);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memcpy(sorted, ranges, n * sizeof(range_t));
+    status = sort_ranges_bucketed(sorted, n, &buckets);
+    if (status != 0) {
+        free(sorted);
+        free(shard);
+        errno = (status == 1) ? EINVAL : ENOMEM;
+        return NULL;
+    }
+
+    snprintf(name, sizeof(name), "/lse_shard_%d_%d", (int)getpid(), serial++);
+    shard->size = align64(sizeof(lse_shard_segment_t)) + align64(n * sizeof(range_t)) + m * sizeof(double);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        status = errno;
+        free(sorted);
+        free(shard);
+        errno = status;
+        return NULL;
+    }
+    seg = MAP_FAILED;
+    if (ftruncate(fd, shard->size) == 0) {
+        seg = mmap(NULL, shard->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    status = errno;
+    close(fd);
+    // the mapping keeps the segment alive, and forked workers inherit it:
+    // nothing needs the name, so a coordinator killed before destroy
+    // leaves nothing in /dev/shm
+    shm_unlink(name);
+    if (seg == MAP_FAILED) {
+        free(sorted);
+        free(shard);
+        errno = status;
+        return NULL;
+    }
+    shard->seg = seg;
+
+    seg->n_workers = n_workers;
+    seg->n = n;
+    seg->m = m;
+    seg->stop = 0;
+    seg->ranges_at = align64(sizeof(lse_shard_segment_t));
+    seg->logps_at = seg->ranges_at + align64(n * sizeof(range_t));
+    split_shards(sorted, &buckets, seg);
+    free(sorted);
+    sem_init(&(seg->done), 1, 0);
+    for (i = 0; i < n_workers; ++i) {
+        sem_init(&(seg->go[i]), 1, 0);
+    }
+
+    parent = getpid();
+    for (i = 0; i < n_workers; ++i) {
+        pid = fork();
+        if (pid < 0) {
+            status = errno;
+            lse_shard_destroy(shard);
+            errno = status;
+            return NULL;
+        }
+        if (pid == 0) {
+#ifdef __linux__
+            // do not outlive a coordinator that dies without destroying
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+            // the coordinator died before prctl took effect
+            if (getppid() != parent) {
+                _exit(1);
+            }
+            if (pin) {
+                pin_worker(i);
+            }
+            worker_loop(seg, i);
+        }
+        shard->pid[i] = pid;
+        shard->n_started = i + 1;
+    }
+    return shard;
+}
+
+
+double *lse_shard_logps(lse_shard_t *shard) {
+    return (double *)((char *)shard->seg + shard->seg->logps_at);
+}
+
+
+static int wait_done(lse_shard_t *shard) {
+    // wait for one worker to finish. returns 0, or -1 if a worker died.
+    struct timespec deadline;
+    int i;
+
+    for (;;) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LSE_SHARD_POLL_NS;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_nsec -= 1000000000;
+            ++deadline.tv_sec;
+        }
+        if (sem_timedwait(&(shard->seg->done), &deadline) == 0) {
+            return 0;
+        }
+        if (errno != ETIMEDOUT && errno != EINTR) {
+            return -1;
+        }
+        for (i = 0; i < shard->n_started; ++i) {
+            if (shard->pid[i] > 0 && waitpid(shard->pid[i], NULL, WNOHANG) == shard->pid[i]) {
+                shard->pid[i] = 0;
+                return -1;
+            }
+        }
+    }
+}
+
+
+double lse_shard_execute(lse_shard_t *shard) {
+    lse_shard_segment_t *seg = shard->seg;
+    double total;
+    int w;
+    LSE_INSTRUMENT_START(t0);
+
+    if (shard->failed) {
+        errno = ECHILD;
+        return NAN;
+    }
+    for (w = 0; w < seg->n_workers; ++w) {
+        sem_post(&(seg->go[w]));
+    }
+    for (w = 0; w < seg->n_workers; ++w) {
+        if (wait_done(shard) != 0) {
+            shard->failed = 1;
+            errno = ECHILD;
+            return NAN;
+        }
+    }
+    // in worker order, so the total does not depend on who finished first
+    total = 0.0;
+    for (w = 0; w < seg->n_workers; ++w) {
+        total += seg->partial[w].partial;
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_SHARD, t0);
+    return total;
+}
+
+
+void lse_shard_destroy(lse_shard_t *shard) {
+    int i;
+    if (shard == NULL) {
+        return;
+    }
+    shard->seg->stop = 1;
+    for (i = 0; i < shard->n_started; ++i) {
+        if (shard->pid[i] <= 0) {
+            continue;
+        }
+        if (shard->failed) {
+            // the others may be mid-shard: do not wait on them
+            kill(shard->pid[i], SIGKILL);
+        } else {
+            sem_post(&(shard->seg->go[i]));
+        }
+        waitpid(shard->pid[i], NULL, 0);
+    }
+    for (i = 0; i < shard->seg->n_workers; ++i) {
+        sem_destroy(&(shard->seg->go[i]));
+    }
+    sem_destroy(&(shard->seg->done));
+    munmap(shard->seg, shard->size);
+    free(shard);
+}
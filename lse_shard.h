@@ -0,0 +1,45 @@
+#ifndef _LSEA_LSE_SHARD
+#define _LSEA_LSE_SHARD 1
+
+// one large range pattern evaluated by several worker processes.
+//
+// lse_shard_create sorts and buckets the ranges, and places them and an
+// m element data vector in a POSIX shared memory segment. it then forks
+// n_workers workers, each with its own address space. every width bucket
+// is split evenly over the workers, and the bucket of wider ranges by
+// total width, so the shards cost the same. each worker evaluates its
+// shard with faster_log_sum_exp_bb_tier at the raw tier. it writes its
+// partial sum into the segment for the coordinator to add up.
+//
+// the data is written in place through lse_shard_logps, so nothing is
+// copied per execute. a coordinator is used from one thread at a time.
+
+#include "types.h"
+
+
+#define LSE_SHARD_MAX_WORKERS 64
+
+
+typedef struct lse_shard lse_shard_t;
+
+
+// returns NULL and sets errno on failure: EINVAL for an invalid pattern,
+// a range past m, or n_workers outside 1 .. LSE_SHARD_MAX_WORKERS;
+// otherwise the errno of the failed allocation, shm_open, mmap or fork.
+// if pin is nonzero, worker i is pinned to cpu i modulo the cpus
+// available.
+lse_shard_t *lse_shard_create(const range_t *ranges, int n, int m, int n_workers, int pin);
+
+// the m element data vector in the segment: fill it before each execute
+double *lse_shard_logps(lse_shard_t *shard);
+
+// returns the sum of the log-sum-exp of every range over the current
+// data. returns NAN and sets errno to ECHILD if a worker has died. the
+// coordinator is then unusable, and can only be destroyed.
+double lse_shard_execute(lse_shard_t *shard);
+
+// stops and reaps the workers, and unmaps the segment. its name is
+// unlinked as soon as it is mapped, so it never outlives its processes.
+void lse_shard_destroy(lse_shard_t *shard);
+
+#endif
@@ -0,0 +1,299 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "lse.h"
+#include "lse_tiered.h"
+#include "lse_instrument.h"
+
+
+// jit compiling a 5000 range pattern costs about as much as 20 bb
+// executions of it: after 100 calls compilation is a small part of the total.
+#define LSE_TIERED_DEFAULT_PROMOTE_CALLS 100
+#define LSE_TIERED_DEFAULT_EPOCH_CALLS 1000
+#define LSE_TIERED_DEFAULT_DEMOTE_CALLS 10
+#define LSE_TIERED_DEFAULT_EVICT_EPOCHS 8
+#define LSE_TIERED_DEFAULT_MAX_PATTERNS 64
+
+
+typedef struct {
+    unsigned long hash;
+    int n;
+    range_t *ranges;        // the pattern as given, to match calls exactly
+    lse_plan_t *bb;
+    lse_plan_t *jit;        // NULL unless promoted
+    long calls;             // since the pattern was first seen or last demoted
+    long epoch_calls;       // in the current epoch
+    long last_epoch;        // epoch of the last call
+    long last_call;         // value of stats.calls at the last call, for lru order
+    long promoted_epoch;
+    int jit_failed;         // the jit refused this pattern: never retry
+} lse_tiered_entry_t;
+
+
+struct lse_tiered {
+    lse_tiered_options_t options;
+    int n_entries;
+    lse_tiered_entry_t *entries;    // options.max_patterns slots
+    int mru;                        // slot of the last pattern executed, checked before hashing
+    long epoch;
+    long epoch_left;                // executions until the epoch ends
+    lse_tiered_stats_t stats;
+};
+
+
+void lse_tiered_options_init(lse_tiered_options_t *options) {
+    lse_options_init(&(options->plan));
+    options->promote_calls = LSE_TIERED_DEFAULT_PROMOTE_CALLS;
+    options->epoch_calls = LSE_TIERED_DEFAULT_EPOCH_CALLS;
+    options->demote_calls = LSE_TIERED_DEFAULT_DEMOTE_CALLS;
+    options->evict_epochs = LSE_TIERED_DEFAULT_EVICT_EPOCHS;
+    options->max_patterns = LSE_TIERED_DEFAULT_MAX_PATTERNS;
+}
+
+
+lse_tiered_t *lse_tiered_create(const lse_tiered_options_t *options) {
+    lse_tiered_options_t defaults;
+    lse_tiered_t *tiered;
+
+    if (options == NULL) {
+        lse_tiered_options_init(&defaults);
+        options = &defaults;
+    }
+    if (options->promote_calls < 1 || options->epoch_calls < 1 || options->demote_calls < 0 ||
+            options->evict_epochs < 1 || options->max_patterns < 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    tiered = calloc(1, sizeof(lse_tiered_t));
+    if (tiered == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    tiered->entries = calloc(options->max_patterns, sizeof(lse_tiered_entry_t));
+    if (tiered->entries == NULL) {
+        free(tiered);
+        errno = ENOMEM;
+        return NULL;
+    }
+    tiered->options = *options;
+    tiered->epoch_left = options->epoch_calls;
+    return tiered;
+}
+
+
+static unsigned long pattern_hash(const range_t *ranges, int n) {
+    // fnv-1a style, one range per step rather than one byte: this runs on
+    // every call, so it must cost little next to evaluating the pattern.
+    unsigned long h = 0xcbf29ce484222325ul ^ (unsigned long)n;
+    int i;
+    for (i = 0; i < n; ++i) {
+        h = (h ^ (((unsigned long)(unsigned int)ranges[i].offset << 32) |
+            (unsigned int)ranges[i].width)) * 0x100000001b3ul;
+    }
+    return h;
+}
+
+
+static void release_entry(lse_tiered_entry_t *e) {
+    lse_plan_destroy(e->jit);
+    lse_plan_destroy(e->bb);
+    free(e->ranges);
+    memset(e, 0, sizeof(lse_tiered_entry_t));
+}
+
+
+static void evict(lse_tiered_t *tiered, int i) {
+    // forget entry i, filling its slot with the last entry
+    release_entry(&(tiered->entries[i]));
+    --(tiered->n_entries);
+    if (i != tiered->n_entries) {
+        tiered->entries[i] = tiered->entries[tiered->n_entries];
+        memset(&(tiered->entries[tiered->n_entries]), 0, sizeof(lse_tiered_entry_t));
+    }
+    ++(tiered->stats.evictions);
+}
+
+
+static lse_tiered_entry_t *find_entry(lse_tiered_t *tiered, const range_t *ranges, int n, unsigned long hash) {
+    lse_tiered_entry_t *e;
+    int i;
+    for (i = 0; i < tiered->n_entries; ++i) {
+        e = &(tiered->entries[i]);
+        if (e->hash == hash && e->n == n && memcmp(e->ranges, ranges, n * sizeof(range_t)) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+
+static lse_tiered_entry_t *add_entry(lse_tiered_t *tiered, const range_t *ranges, int n, unsigned long hash) {
+    // plan a new pattern on the bb tier. returns NULL and sets errno on
+    // failure.
+    lse_options_t options;
+    lse_tiered_entry_t *e;
+    int i, lru;
+
+    if (tiered->n_entries == tiered->options.max_patterns) {
+        lru = 0;
+        for (i = 1; i < tiered->n_entries; ++i) {
+            if (tiered->entries[i].last_call < tiered->entries[lru].last_call) {
+                lru = i;
+            }
+        }
+        evict(tiered, lru);
+    }
+
+    e = &(tiered->entries[tiered->n_entries]);
+    e->ranges = malloc(n * sizeof(range_t) + 1);
+    if (e->ranges == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memcpy(e->ranges, ranges, n * sizeof(range_t));
+    options = tiered->options.plan;
+    options.strategy = LSE_STRATEGY_BB;
+    options.tune = 0;
+    // the jit plan of a promoted pattern has no sliding windows: without
+    // them here too, promotion does not change the totals
+    options.sliding = 0;
+    e->bb = lse_plan_create(ranges, n, &options);
+    if (e->bb == NULL) {
+        // lse_plan_create set errno
+        free(e->ranges);
+        e->ranges = NULL;
+        return NULL;
+    }
+    e->hash = hash;
+    e->n = n;
+    e->last_epoch = tiered->epoch;
+    ++(tiered->n_entries);
+    return e;
+}
+
+
+static void promote(lse_tiered_t *tiered, lse_tiered_entry_t *e) {
+    // best effort: a pattern the jit cannot take stays on bb
+    lse_options_t options;
+    int saved_errno = errno;
+
+    if (e->n > tiered->options.plan.jit_max_ranges) {
+        e->jit_failed = 1;
+        return;
+    }
+    options = tiered->options.plan;
+    options.strategy = LSE_STRATEGY_JIT;
+    options.tune = 0;
+    e->jit = lse_plan_create(e->ranges, e->n, &options);
+    if (e->jit == NULL) {
+        e->jit_failed = 1;
+        ++(tiered->stats.jit_failures);
+        errno = saved_errno;
+        return;
+    }
+    e->promoted_epoch = tiered->epoch;
+    ++(tiered->stats.promotions);
+}
+
+
+static void end_epoch(lse_tiered_t *tiered) {
+    lse_tiered_entry_t *e;
+    int i;
+
+    // backwards, so evict's swap only moves entries already visited
+    for (i = tiered->n_entries - 1; i >= 0; --i) {
+        e = &(tiered->entries[i]);
+        if (tiered->epoch - e->last_epoch >= tiered->options.evict_epochs) {
+            evict(tiered, i);
+            continue;
+        }
+        // a pattern promoted during this epoch gets a full epoch first
+        if (e->jit != NULL && e->promoted_epoch < tiered->epoch &&
+                e->epoch_calls < tiered->options.demote_calls) {
+            lse_plan_destroy(e->jit);
+            e->jit = NULL;
+            e->calls = 0;
+            ++(tiered->stats.demotions);
+        }
+        e->epoch_calls = 0;
+    }
+    ++(tiered->epoch);
+    tiered->epoch_left = tiered->options.epoch_calls;
+}
+
+
+double lse_tiered_execute(lse_tiered_t *tiered, const range_t *ranges, int n, double *logps, double *out) {
+    lse_tiered_entry_t *e;
+    lse_plan_t *plan;
+    unsigned long hash;
+    double total;
+    LSE_INSTRUMENT_START(t0);
+
+    // hashing costs several times a memcmp, and calls tend to repeat
+    e = &(tiered->entries[tiered->mru]);
+    if (tiered->mru >= tiered->n_entries || e->n != n || memcmp(e->ranges, ranges, n * sizeof(range_t)) != 0) {
+        hash = pattern_hash(ranges, n);
+        e = find_entry(tiered, ranges, n, hash);
+        if (e == NULL) {
+            e = add_entry(tiered, ranges, n, hash);
+            if (e == NULL) {
+                return NAN;
+            }
+        }
+        tiered->mru = (int)(e - tiered->entries);
+    }
+    ++(e->calls);
+    ++(e->epoch_calls);
+    e->last_epoch = tiered->epoch;
+    e->last_call = tiered->stats.calls;
+    if (e->jit == NULL && !e->jit_failed && e->calls >= tiered->options.promote_calls) {
+        promote(tiered, e);
+    }
+
+    ++(tiered->stats.calls);
+    if (e->jit != NULL) {
+        plan = e->jit;
+        ++(tiered->stats.jit_calls);
+    } else {
+        plan = e->bb;
+        ++(tiered->stats.bb_calls);
+    }
+    total = lse_plan_execute(plan, logps, out);
+
+    // may evict e: nothing below touches it
+    if (--(tiered->epoch_left) == 0) {
+        end_epoch(tiered);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_TIERED, t0);
+    return total;
+}
+
+
+void lse_tiered_stats(const lse_tiered_t *tiered, lse_tiered_stats_t *stats) {
+    int i;
+    *stats = tiered->stats;
+    stats->n_patterns = tiered->n_entries;
+    stats->n_jit = 0;
+    for (i = 0; i < tiered->n_entries; ++i) {
+        if (tiered->entries[i].jit != NULL) {
+            ++(stats->n_jit);
+        }
+    }
+}
+
+
+void lse_tiered_destroy(lse_tiered_t *tiered) {
+    int i;
+    if (tiered == NULL) {
+        return;
+    }
+    for (i = 0; i < tiered->n_entries; ++i) {
+        release_entry(&(tiered->entries[i]));
+    }
+    free(tiered->entries);
+    free(tiered);
+}
@@ -0,0 +1,66 @@
+#ifndef _LSEA_LSE_TIERED
+#define _LSEA_LSE_TIERED 1
+
+// tiered execution of many range patterns, for callers that do not know
+// up front which patterns will be hot.
+//
+// lse_tiered_execute takes the pattern with every call. a pattern seen for
+// the first time gets a bb plan. once it has been executed promote_calls
+// times it is promoted to a jit plan. the executor counts time in epochs
+// of epoch_calls executions. at the end of each epoch, jit patterns
+// executed fewer than demote_calls times in it are demoted back to bb.
+// patterns not executed for evict_epochs epochs are forgotten. so cold
+// patterns never pay for compilation, and hot ones run at jit speed.
+//
+// an executor is modified by every call: use one per thread, or serialise
+// calls to it.
+
+#include "types.h"
+#include "lse.h"
+
+
+typedef struct {
+    // dedup, accuracy and jit_max_ranges for both tiers. patterns larger
+    // than jit_max_ranges stay on bb. strategy and tune are ignored, and
+    // sliding too: the jit tier could not apply it.
+    lse_options_t plan;
+    int promote_calls;  // executions of a pattern before it is jit compiled
+    int epoch_calls;    // executions per epoch, over all patterns
+    int demote_calls;   // jit patterns executed fewer times in an epoch go back to bb
+    int evict_epochs;   // patterns not executed for this many epochs are forgotten
+    int max_patterns;   // when full, the least recently executed pattern is forgotten
+} lse_tiered_options_t;
+
+
+typedef struct {
+    long calls;
+    long bb_calls;
+    long jit_calls;
+    long promotions;
+    long demotions;
+    long evictions;
+    long jit_failures;  // promotions refused by the jit, e.g. for widths it lacks
+    int n_patterns;     // patterns remembered now
+    int n_jit;          // of which jit compiled
+} lse_tiered_stats_t;
+
+
+typedef struct lse_tiered lse_tiered_t;
+
+
+void lse_tiered_options_init(lse_tiered_options_t *options);
+
+// returns NULL and sets errno on failure: EINVAL for an invalid option,
+// ENOMEM on allocation failure. options may be NULL for defaults.
+lse_tiered_t *lse_tiered_create(const lse_tiered_options_t *options);
+
+// as lse_plan_execute on a plan for ranges. returns NAN and sets errno if
+// a new pattern cannot be planned: EINVAL for an invalid pattern, ENOMEM
+// on allocation failure.
+double lse_tiered_execute(lse_tiered_t *tiered, const range_t *ranges, int n, double *logps, double *out);
+
+void lse_tiered_stats(const lse_tiered_t *tiered, lse_tiered_stats_t *stats);
+
+void lse_tiered_destroy(lse_tiered_t *tiered);
+
+#endif
@@ -0,0 +1,722 @@
+// lsed: local evaluation daemon. see lse_service.h for the protocol.
+//
+//     ./lsed <socket path>
+//
+// one thread, one poll loop. every round reads what each client has
+// sent, parses complete requests and queues evaluations. the queue is
+// then drained grouped by pattern: the distinct data vectors of a
+// pattern's evaluations run as one lse_plan_execute_multi call, so
+// concurrent clients share a walk over the ranges. an UPDATE first answers
+// the queued evaluations of its data vector, so they see the data as it
+// was when they arrived.
+
+// for accept4 and SOCK_NONBLOCK
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "types.h"
+#include "lse.h"
+#include "lse_service.h"
+
+
+#define LSED_MAX_CLIENTS 256
+// data vectors per batched kernel call
+#define LSED_MAX_BATCH 16
+// latency histogram buckets: bucket k counts latencies below 2^k us
+#define LSED_LATENCY_BUCKETS 24
+
+
+typedef struct {
+    int fd;
+    char *in;           // received, not yet parsed
+    size_t in_size;
+    size_t in_cap;
+    char *out;          // replies not yet sent
+    size_t out_size;
+    size_t out_cap;
+} lsed_client_t;
+
+
+typedef struct {
+    lse_plan_t *plan;
+    int extent;         // max offset + width: the data length it needs
+} lsed_pattern_t;
+
+
+typedef struct {
+    double *logps;
+    int m;
+} lsed_data_t;
+
+
+typedef struct {
+    int client;
+    uint32_t id;
+    uint32_t pattern;
+    uint32_t data;
+    double arrived;
+    int done;
+} lsed_pending_t;
+
+
+typedef struct {
+    lsed_client_t clients[LSED_MAX_CLIENTS];
+    int n_clients;
+    lsed_pattern_t *patterns;
+    int n_patterns;
+    lsed_data_t *data;
+    int n_data;
+    lsed_pending_t *pending;
+    int n_pending;
+    int pending_cap;
+    double *scratch;    // interleaved batch, grown as needed
+    size_t scratch_size;
+    double started;
+    long requests;
+    long evaluations;
+    long batches;       // kernel calls made for evaluations
+    long batched;       // data vectors over all kernel calls
+    long latency[LSED_LATENCY_BUCKETS];
+    int failed;         // a reply could not be queued
+} lsed_t;
+
+
+static volatile sig_atomic_t stopping = 0;
+
+
+static void on_signal(int sig) {
+    stopping = 1;
+}
+
+
+static double now_seconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+
+static int reserve(char **p, size_t *cap, size_t size) {
+    char *q;
+    size_t c;
+    if (size <= *cap) {
+        return 0;
+    }
+    c = (*cap == 0) ? 4096 : *cap;
+    while (c < size) {
+        c *= 2;
+    }
+    q = realloc(*p, c);
+    if (q == NULL) {
+        return -1;
+    }
+    *p = q;
+    *cap = c;
+    return 0;
+}
+
+
+static int reply(lsed_t *d, int c, uint32_t id, int status, uint32_t handle, double value,
+        const char *text, uint32_t size) {
+    // queue a reply for client c. returns -1 if it could not be queued.
+    lsed_client_t *client = &(d->clients[c]);
+    lse_service_reply_t r;
+
+    r.status = status;
+    r.id = id;
+    r.handle = handle;
+    r.size = size;
+    r.value = value;
+    if (reserve(&(client->out), &(client->out_cap), client->out_size + sizeof(r) + size) != 0) {
+        return -1;
+    }
+    memcpy(client->out + client->out_size, &r, sizeof(r));
+    if (size > 0) {
+        memcpy(client->out + client->out_size + sizeof(r), text, size);
+    }
+    client->out_size += sizeof(r) + size;
+    return 0;
+}
+
+
+static int add_pattern(lsed_t *d, const range_t *ranges, int n, uint32_t *handle) {
+    // returns 0 or an errno value
+    lse_options_t options;
+    lsed_pattern_t *p;
+    lse_plan_t *plan;
+    int i, extent;
+
+    extent = 0;
+    for (i = 0; i < n; ++i) {
+        if (ranges[i].offset < 0 || ranges[i].width < 0 || ranges[i].offset > INT32_MAX - ranges[i].width) {
+            return EINVAL;
+        }
+        if (ranges[i].offset + ranges[i].width > extent) {
+            extent = ranges[i].offset + ranges[i].width;
+        }
+    }
+    p = realloc(d->patterns, (d->n_patterns + 1) * sizeof(lsed_pattern_t));
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    d->patterns = p;
+    // a batch of one goes through lse_plan_execute and larger ones through
+    // lse_plan_execute_multi. without sliding windows both give the same
+    // total, whoever else is in the batch.
+    lse_options_init(&options);
+    options.sliding = 0;
+    plan = lse_plan_create(ranges, n, &options);
+    if (plan == NULL) {
+        return errno;
+    }
+    d->patterns[d->n_patterns].plan = plan;
+    d->patterns[d->n_patterns].extent = extent;
+    *handle = ++(d->n_patterns);
+    return 0;
+}
+
+
+static int add_data(lsed_t *d, const double *logps, int m, uint32_t *handle) {
+    lsed_data_t *p;
+    double *copy;
+
+    p = realloc(d->data, (d->n_data + 1) * sizeof(lsed_data_t));
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    d->data = p;
+    copy = malloc(m * sizeof(double) + 1);
+    if (copy == NULL) {
+        return ENOMEM;
+    }
+    memcpy(copy, logps, m * sizeof(double));
+    d->data[d->n_data].logps = copy;
+    d->data[d->n_data].m = m;
+    *handle = ++(d->n_data);
+    return 0;
+}
+
+
+static int update_data(lsed_t *d, uint32_t handle, const double *logps, int m) {
+    lsed_data_t *e;
+    double *copy;
+
+    if (handle < 1 || handle > (uint32_t)d->n_data) {
+        return ENOENT;
+    }
+    e = &(d->data[handle - 1]);
+    if (m != e->m) {
+        copy = realloc(e->logps, m * sizeof(double) + 1);
+        if (copy == NULL) {
+            return ENOMEM;
+        }
+        e->logps = copy;
+        e->m = m;
+    }
+    memcpy(e->logps, logps, m * sizeof(double));
+    return 0;
+}
+
+
+static int queue_evaluate(lsed_t *d, int c, const lse_service_request_t *request) {
+    lsed_pending_t *p;
+    int cap;
+
+    if (d->n_pending == d->pending_cap) {
+        cap = (d->pending_cap == 0) ? 64 : 2 * d->pending_cap;
+        p = realloc(d->pending, cap * sizeof(lsed_pending_t));
+        if (p == NULL) {
+            return -1;
+        }
+        d->pending = p;
+        d->pending_cap = cap;
+    }
+    p = &(d->pending[d->n_pending++]);
+    p->client = c;
+    p->id = request->id;
+    p->pattern = request->a;
+    p->data = request->b;
+    p->arrived = now_seconds();
+    p->done = 0;
+    return 0;
+}
+
+
+static int stats_text(lsed_t *d, char *text, size_t size) {
+    double elapsed = now_seconds() - d->started;
+    int k, len;
+
+    len = snprintf(text, size,
+        "requests %ld\n"
+        "evaluations %ld\n"
+        "batches %ld\n"
+        "mean_batch %.2f\n"
+        "patterns %d\n"
+        "data %d\n"
+        "uptime_s %.3f\n"
+        "evaluations_per_s %.1f\n",
+        d->requests, d->evaluations, d->batches,
+        (d->batches > 0) ? (double)d->batched / d->batches : 0.0,
+        d->n_patterns, d->n_data, elapsed,
+        (elapsed > 0.0) ? d->evaluations / elapsed : 0.0);
+    for (k = 0; k < LSED_LATENCY_BUCKETS && len < (int)size; ++k) {
+        if (d->latency[k] > 0) {
+            len += snprintf(text + len, size - len, "latency_us_lt_%ld %ld\n", 1l << k, d->latency[k]);
+        }
+    }
+    return (len < (int)size) ? len : (int)size - 1;
+}
+
+
+static int evaluate_pending(lsed_t *d);
+
+
+static int pending_reads(const lsed_t *d, uint32_t data) {
+    // whether a queued evaluation reads data
+    int i;
+    for (i = 0; i < d->n_pending; ++i) {
+        if (d->pending[i].data == data) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+static int handle_request(lsed_t *d, int c, const lse_service_request_t *request, const char *payload) {
+    // returns -1 if the client must be dropped
+    char text[2048];
+    uint32_t handle = 0;
+    int status, len;
+
+    ++(d->requests);
+    switch (request->op) {
+    case LSE_SERVICE_OP_PATTERN:
+        status = add_pattern(d, (const range_t *)payload, request->a, &handle);
+        return reply(d, c, request->id, status, handle, 0.0, NULL, 0);
+    case LSE_SERVICE_OP_DATA:
+        status = add_data(d, (const double *)payload, request->a, &handle);
+        return reply(d, c, request->id, status, handle, 0.0, NULL, 0);
+    case LSE_SERVICE_OP_UPDATE:
+        // evaluations queued before the update must see the old data, and
+        // be answered first. a failure to queue their replies is kept in
+        // d->failed for the main loop.
+        if (pending_reads(d, request->a)) {
+            evaluate_pending(d);
+        }
+        status = update_data(d, request->a, (const double *)payload, request->b);
+        return reply(d, c, request->id, status, request->a, 0.0, NULL, 0);
+    case LSE_SERVICE_OP_EVALUATE:
+        // answered once this round's reads are done
+        return queue_evaluate(d, c, request);
+    case LSE_SERVICE_OP_STATS:
+        len = stats_text(d, text, sizeof(text));
+        return reply(d, c, request->id, 0, 0, 0.0, text, len);
+    default:
+        return reply(d, c, request->id, EINVAL, 0, 0.0, NULL, 0);
+    }
+}
+
+
+static int payload_size(const lse_service_request_t *request, size_t *size) {
+    // bytes following the request. returns -1 for a size the daemon
+    // refuses: the stream cannot be resynchronised after that.
+    uint64_t s;
+    switch (request->op) {
+    case LSE_SERVICE_OP_PATTERN:
+        s = (uint64_t)request->a * sizeof(range_t);
+        break;
+    case LSE_SERVICE_OP_DATA:
+        s = (uint64_t)request->a * sizeof(double);
+        break;
+    case LSE_SERVICE_OP_UPDATE:
+        s = (uint64_t)request->b * sizeof(double);
+        break;
+    default:
+        s = 0;
+    }
+    if (s > LSE_SERVICE_MAX_PAYLOAD) {
+        return -1;
+    }
+    *size = s;
+    return 0;
+}
+
+
+static int parse(lsed_t *d, int c) {
+    // handle every complete request in the client's buffer. returns -1 if
+    // the client must be dropped.
+    lsed_client_t *client = &(d->clients[c]);
+    lse_service_request_t request;
+    size_t at = 0, size;
+
+    while (client->in_size - at >= sizeof(request)) {
+        memcpy(&request, client->in + at, sizeof(request));
+        if (payload_size(&request, &size) != 0) {
+            return -1;
+        }
+        if (client->in_size - at - sizeof(request) < size) {
+            break;
+        }
+        // the payload is read in place: in is malloc aligned and requests
+        // and payloads keep 8 byte multiples
+        if (handle_request(d, c, &request, client->in + at + sizeof(request)) != 0) {
+            return -1;
+        }
+        at += sizeof(request) + size;
+    }
+    memmove(client->in, client->in + at, client->in_size - at);
+    client->in_size -= at;
+    return 0;
+}
+
+
+static void drop_client(lsed_t *d, int c) {
+    // fills slot c with the last client. only called with nothing pending.
+    lsed_client_t *client = &(d->clients[c]);
+    close(client->fd);
+    free(client->in);
+    free(client->out);
+    --(d->n_clients);
+    if (c != d->n_clients) {
+        *client = d->clients[d->n_clients];
+    }
+}
+
+
+static int receive(lsed_t *d, int c) {
+    // returns -1 if the client closed or must be dropped
+    lsed_client_t *client = &(d->clients[c]);
+    ssize_t k;
+
+    for (;;) {
+        if (reserve(&(client->in), &(client->in_cap), client->in_size + 65536) != 0) {
+            return -1;
+        }
+        k = read(client->fd, client->in + client->in_size, client->in_cap - client->in_size);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? parse(d, c) : -1;
+        }
+        if (k == 0) {
+            return -1;
+        }
+        client->in_size += k;
+    }
+}
+
+
+static int send_pending(lsed_client_t *client) {
+    // returns -1 if the client must be dropped
+    ssize_t k;
+    size_t at = 0;
+
+    while (at < client->out_size) {
+        k = send(client->fd, client->out + at, client->out_size - at, MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        at += k;
+    }
+    memmove(client->out, client->out + at, client->out_size - at);
+    client->out_size -= at;
+    return 0;
+}
+
+
+static void record_latency(lsed_t *d, double arrived, double finished) {
+    double us = 1e6 * (finished - arrived);
+    int k = 0;
+    while (k < LSED_LATENCY_BUCKETS - 1 && us >= (double)(1l << k)) {
+        ++k;
+    }
+    ++(d->latency[k]);
+}
+
+
+static int evaluate_group(lsed_t *d, int first, uint32_t *handles, double *totals, int *status) {
+    // gather up to LSED_MAX_BATCH distinct data vectors of pending
+    // evaluations of the pattern of pending[first], and evaluate them.
+    // returns the number of vectors; *status is 0 or an errno value.
+    const lsed_pending_t *p = d->pending;
+    const lsed_pattern_t *pattern = &(d->patterns[p[first].pattern - 1]);
+    double *scratch, *logps;
+    int i, j, k, v;
+
+    k = 0;
+    for (i = first; i < d->n_pending && k < LSED_MAX_BATCH; ++i) {
+        if (p[i].done || p[i].pattern != p[first].pattern) {
+            continue;
+        }
+        for (j = 0; j < k && handles[j] != p[i].data; ++j) {
+        }
+        if (j == k) {
+            handles[k++] = p[i].data;
+        }
+    }
+
+    *status = 0;
+    if (k == 1) {
+        totals[0] = lse_plan_execute(pattern->plan, d->data[handles[0] - 1].logps, NULL);
+    } else {
+        if ((size_t)pattern->extent * k > d->scratch_size) {
+            scratch = realloc(d->scratch, (size_t)pattern->extent * k * sizeof(double) + 1);
+            if (scratch == NULL) {
+                *status = ENOMEM;
+                return k;
+            }
+            d->scratch = scratch;
+            d->scratch_size = (size_t)pattern->extent * k;
+        }
+        for (v = 0; v < k; ++v) {
+            logps = d->data[handles[v] - 1].logps;
+            for (i = 0; i < pattern->extent; ++i) {
+                d->scratch[(size_t)i * k + v] = logps[i];
+            }
+        }
+        if (lse_plan_execute_multi(pattern->plan, d->scratch, k, totals) != 0) {
+            *status = errno;
+        }
+    }
+    ++(d->batches);
+    d->batched += k;
+    return k;
+}
+
+
+static int evaluate_pending(lsed_t *d) {
+    // answer every queued evaluation. returns -1 if a reply could not be
+    // queued, by this call or an earlier one.
+    lsed_pending_t *p = d->pending;
+    uint32_t handles[LSED_MAX_BATCH];
+    double totals[LSED_MAX_BATCH], finished;
+    int i, j, v, k, status, failed = 0;
+
+    // invalid requests first, so groups only hold good ones
+    for (i = 0; i < d->n_pending; ++i) {
+        status = 0;
+        if (p[i].pattern < 1 || p[i].pattern > (uint32_t)d->n_patterns ||
+                p[i].data < 1 || p[i].data > (uint32_t)d->n_data) {
+            status = ENOENT;
+        } else if (d->data[p[i].data - 1].m < d->patterns[p[i].pattern - 1].extent) {
+            status = EINVAL;
+        }
+        if (status != 0) {
+            failed |= reply(d, p[i].client, p[i].id, status, 0, NAN, NULL, 0);
+            p[i].done = 1;
+        }
+    }
+
+    for (i = 0; i < d->n_pending; ++i) {
+        while (!p[i].done) {
+            k = evaluate_group(d, i, handles, totals, &status);
+            finished = now_seconds();
+            for (j = i; j < d->n_pending; ++j) {
+                if (p[j].done || p[j].pattern != p[i].pattern) {
+                    continue;
+                }
+                for (v = 0; v < k && handles[v] != p[j].data; ++v) {
+                }
+                if (v == k) {
+                    continue;
+                }
+                failed |= reply(d, p[j].client, p[j].id, status, 0, (status == 0) ? totals[v] : NAN, NULL, 0);
+                record_latency(d, p[j].arrived, finished);
+                ++(d->evaluations);
+                p[j].done = 1;
+            }
+        }
+    }
+    d->n_pending = 0;
+    d->failed |= failed;
+    return d->failed;
+}
+
+
+static int remove_stale(const struct sockaddr_un *addr) {
+    // removes the socket left at addr by a daemon that did not exit
+    // cleanly. anything else there is kept: a file that is not a socket
+    // fails with EEXIST, and a socket that accepts a connection, i.e. a
+    // running daemon, with EADDRINUSE. returns 0, or -1 and sets errno.
+    struct stat st;
+    int fd, err;
+
+    if (lstat(addr->sun_path, &st) != 0) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EEXIST;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0) {
+        close(fd);
+        errno = EADDRINUSE;
+        return -1;
+    }
+    err = errno;
+    close(fd);
+    if (err != ECONNREFUSED) {
+        errno = err;
+        return -1;
+    }
+    if (unlink(addr->sun_path) != 0 && errno != ENOENT) {
+        return -1;
+    }
+    return 0;
+}
+
+
+static int listen_on(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (remove_stale(&addr) != 0) {
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+static void accept_clients(lsed_t *d, int listener) {
+    int fd;
+    for (;;) {
+        fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        if (d->n_clients == LSED_MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+        memset(&(d->clients[d->n_clients]), 0, sizeof(lsed_client_t));
+        d->clients[d->n_clients].fd = fd;
+        ++(d->n_clients);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    static struct pollfd fds[LSED_MAX_CLIENTS + 1];
+    static lsed_t d;
+    struct sigaction action;
+    char closing[LSED_MAX_CLIENTS];
+    int listener, i, n_ready;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <socket path>\n", argv[0]);
+        return 1;
+    }
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    listener = listen_on(argv[1]);
+    if (listener < 0) {
+        perror("err: listen");
+        return 1;
+    }
+    d.started = now_seconds();
+
+    while (!stopping) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (i = 0; i < d.n_clients; ++i) {
+            fds[i + 1].fd = d.clients[i].fd;
+            fds[i + 1].events = POLLIN | ((d.clients[i].out_size > 0) ? POLLOUT : 0);
+            fds[i + 1].revents = 0;
+        }
+        n_ready = poll(fds, d.n_clients + 1, -1);
+        if (n_ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("err: poll");
+            break;
+        }
+
+        // read and parse everything, then evaluate it together, then
+        // drop clients: evaluate_pending refers to clients by slot
+        memset(closing, 0, sizeof(closing));
+        for (i = 0; i < d.n_clients; ++i) {
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                closing[i] = (receive(&d, i) != 0);
+            }
+        }
+        if (evaluate_pending(&d) != 0) {
+            fprintf(stderr, "err: out of memory queueing replies\n");
+            break;
+        }
+        for (i = 0; i < d.n_clients; ++i) {
+            if (!closing[i] && d.clients[i].out_size > 0) {
+                closing[i] = (send_pending(&(d.clients[i])) != 0);
+            }
+        }
+        // backwards, so drop_client's swap only moves clients already visited
+        for (i = d.n_clients - 1; i >= 0; --i) {
+            if (closing[i]) {
+                drop_client(&d, i);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_clients(&d, listener);
+        }
+    }
+
+    for (i = d.n_clients - 1; i >= 0; --i) {
+        drop_client(&d, i);
+    }
+    close(listener);
+    unlink(argv[1]);
+    for (i = 0; i < d.n_patterns; ++i) {
+        lse_plan_destroy(d.patterns[i].plan);
+    }
+    for (i = 0; i < d.n_data; ++i) {
+        free(d.data[i].logps);
+    }
+    free(d.patterns);
+    free(d.data);
+    free(d.pending);
+    free(d.scratch);
+    return 0;
+}
@@ -2,25 +2,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "types.h"
-
-#include "jit_logsumexp.c"
-
-// ref: Curioni -- Fast Exponential Computation on SIMD Architectures
-// ref: Schraudolph -- A Fast, Compact Approximation of the Exponential Function
-
-#define APPROX_LN2 (0.6931471805599453)
-// APPROX_S0 can be set to 0 if loading into a 32 bit int,
-// as per Schraudolph, or 32 if loading into a 64 bit int.
-#define APPROX_S0 (32l)
-#define APPROX_S (1l << (20l + APPROX_S0))
-#define APPROX_A (APPROX_S / APPROX_LN2)
-#define APPROX_B (APPROX_S * 1023l)
-#define APPROX_C (60801l * (1l << APPROX_S0))
-#define APPROX_A_INV (1.0 / APPROX_A)
-
-#define FAST_EXP_MIN_ARG -706.0
+#include "logsumexp.h"
+#include "jit_logsumexp.h"
+#include "lse.h"
+#include "lse_tiered.h"
+#include "lse_shard.h"
+#include "lse_service.h"
+#include "lse_instrument.h"
+#include "csr_logsumexp.h"
+#include "log_gemm.h"
+#include "softmax.h"
+#include "fast_approx.h"
 
 
 #define MODE_BASE 1
@@ -29,373 +26,541 @@
 #define MODE_FASTER 4
 #define MODE_FASTERBB 6
 #define MODE_JIT 7
+#define MODE_COMPACTBB 8
+#define MODE_PLAN 9
+#define MODE_CSR 10
+#define MODE_CSR_ROWS 11
+#define MODE_GEMM 12
+#define MODE_GEMM_NAIVE 13
+#define MODE_GEMM_EXACT 14
+#define MODE_SOFTMAX_BB 15
+#define MODE_SOFTMAX_SIMD 16
+#define MODE_SOFTMAX_JIT 17
+#define MODE_SOFTMAX_2PASS 18
+#define MODE_WINDOWS 19
+#define MODE_WINDOWS_BB 20
+#define MODE_BLOCKMAX 21
+#define MODE_EXPCACHE 22
+#define MODE_BB_TABLE 23
+#define MODE_BB_POLY 24
+#define MODE_JIT_TABLE 25
+#define MODE_JIT_POLY 26
+#define MODE_BASEBB 27
+#define MODE_QUANT16 28
+#define MODE_QUANT8 29
+#define MODE_MULTI_BB 30
+#define MODE_MULTI_JIT 31
+#define MODE_MULTI_LOOP 32
+#define MODE_TUNE 33
+#define MODE_PREFETCH 34
+#define MODE_PREFETCH_SWEEP 35
+#define MODE_TILED 36
+#define MODE_SOA 37
+#define MODE_SOA_REFRESH 38
+#define MODE_INTERP 39
+#define MODE_TIERED 40
+#define MODE_SAMPLE 41
+#define MODE_PRUNE 42
+#define MODE_SHARD 43
+#define MODE_LSED 44
+
+// group prefetch: ranges per group, and how many ranges ahead to prefetch
+#define PREFETCH_GROUP 8
+#define PREFETCH_DISTANCE 16
+// offset tiling: tiles of 1 << TILE_SHIFT doubles, half of a 2MB L2
+#define TILE_SHIFT 17
+// prefetch sweep: data sizes from 1 << SWEEP_MIN_LOG2_M to 1 << SWEEP_MAX_LOG2_M
+// doubles, i.e. from L1 size to several times a large LLC
+#define SWEEP_MIN_LOG2_M 12
+#define SWEEP_MAX_LOG2_M 26
+#define SWEEP_N (1 << 20)
+#define SWEEP_REPS 3
+
+// tiered benchmark: every TIERED_COLD_EVERY trials, also execute a pattern
+// of TIERED_COLD_N ranges that is never seen again
+#define TIERED_COLD_EVERY 10
+#define TIERED_COLD_N 500
+
+// pruning benchmark: PRUNE_N ranges of width PRUNE_MIN_WIDTH to
+// PRUNE_MAX_WIDTH over 1 << PRUNE_LOG2_M elements, at several fractions of
+// significant elements; the rest lie 100 to 1000 below them
+#define PRUNE_LOG2_M 20
+#define PRUNE_N 4096
+#define PRUNE_MIN_WIDTH 256
+#define PRUNE_MAX_WIDTH 4096
+#define PRUNE_REPS 5
+
+// sharding benchmark: SHARD_N ranges over 1 << SHARD_LOG2_M elements,
+// with up to SHARD_MAX_WORKERS worker processes
+#define SHARD_LOG2_M 22
+#define SHARD_N (1 << 22)
+#define SHARD_MAX_WORKERS 8
+#define SHARD_REPS 5
+
+// evaluation service: LSED_CLIENTS client processes, each making
+// LSED_REQUESTS evaluations of LSED_PATTERNS shared patterns in turn over
+// its own data, on the lsed listening at $LSED_SOCKET or LSED_DEFAULT_SOCKET
+#define LSED_DEFAULT_SOCKET "/tmp/lsed.sock"
+#define LSED_CLIENTS 4
+#define LSED_REQUESTS 2000
+#define LSED_PATTERNS 2
+
+// sampling estimator: relative error target, at 95% confidence
+#define SAMPLE_REL_ERR 1e-2
+#define SAMPLE_Z 1.96
+
+// multi-vector benchmark: data vectors per call
+#define MULTI_K 8
+
+// log semiring gemm benchmark: square matrices of this size
+#define GEMM_SIZE 256
+#define GEMM_TRIALS 20
+
+// sliding window benchmark: every window of this width over logps
+#define WINDOW_WIDTH 16
 
 
-static inline double reinterpret_long_as_double(long int x) {
-    // type pun: reinterpret the bits of x as a 64 bit float.
-    // this is expected to compile to a no-op.
-    // with C++ we'd use "reinterpret cast".
-    union {
-        long int i;
-        double d;
-    } b;
-    b.i = x;
-    return b.d;
-}
-
-
-static inline long int reinterpret_double_as_long(double x) {
-    // type pun: reinterpret the bits of x as a 64 bit int.
-    // this is expected to compile to a no-op.
-    // with C++ we'd use "reinterpret cast".
-    union {
-        long int i;
-        double d;
-    } b;
-    b.d = x;
-    return b.i;
-}
-
-
-double fast_exp(double x) {
-    double z;
-    z = reinterpret_long_as_double((long int)(fma(APPROX_A, x, + (APPROX_B - APPROX_C))));
-    // above approximation gives bad results where x < -706.0
-    return (x >= FAST_EXP_MIN_ARG) ? z : 0.0;
-}
-
-
-double fast_log(double x) {
-    // precondition: x >= 0.0
-    //
-    // naively invert fast_exp
-    // y = (a * x) + b
-    // x = (y - b) / a
-    // x = (1/a) * y + (1/a) * (-b)  // distribute multiply for fma
-    double z;
-    z = (double)reinterpret_double_as_long(x);
-    z = fma(APPROX_A_INV, z, APPROX_A_INV * (- APPROX_B + APPROX_C));
-    return (x > 0.0) ? z : -INFINITY;
-}
-
-
-double sum(double *a, int n) {
-    // preconditions:
-    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
-    double acc;
+void sample_uniform(double *a, int n, double min, double max) {
     int i;
-    acc = 0.0;
-    for (i = 0; i < n; ++i) {
-        acc += a[i];
+    double range = (max - min); 
+    double div = RAND_MAX / range;
+
+    for (i=0; i<n; ++i) {
+        a[i] = min + (rand() / div);
     }
-    return acc;
 }
 
 
-double log_sum_exp(double *a, int n) {
-    // preconditions:
-    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
-    double a_max, acc;
-    int i;
-    a_max = -INFINITY;
-    for (i = 0; i < n; ++i) {
-        a_max = fmax(a[i], a_max);
-    }
-    if (a_max <= -INFINITY || n <= 1) {
-        return a_max;
-    }
-    acc = 0.0;
-    for (i = 0; i < n; ++i) {
-        acc += exp(a[i] - a_max);
+void sample_ranges(range_t *ranges, int n, int w, int m) {
+    int i, width, offset;
+    for (i=0; i<n; ++i) {
+        // sample width from 1 to w
+        width = rand() % (w + 1 - 1) + 1;
+        // sample offset from 0 to m-width
+        offset = rand() % (m-width + 1);
+        ranges[i].offset = offset;
+        ranges[i].width = width;
     }
-    return log(acc) + a_max;
 }
 
 
-double fast_log_sum_exp(double *a, int n) {
-    // preconditions:
-    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
-    double a_max, acc;
-    int i;
-    a_max = -INFINITY;
+int ranges_to_csr(range_t *ranges, int n, int m, csr_matrix_t *a) {
+    // express each range as a csr row of consecutive column indices, so
+    // the sparse engine can be benchmarked against the range kernels.
+    int i, k, p;
+    int *row_start, *col;
+    row_start = malloc((n + 1) * sizeof(int));
+    p = 0;
     for (i = 0; i < n; ++i) {
-        a_max = fmax(a[i], a_max);
+        p += ranges[i].width;
     }
-    if (a_max <= -INFINITY || n <= 1) {
-        return a_max;
+    col = malloc(p * sizeof(int) + 1);
+    if (row_start == NULL || col == NULL) {
+        free(row_start);
+        free(col);
+        return 2;
     }
-    acc = 0.0;
+    p = 0;
     for (i = 0; i < n; ++i) {
-        acc += fast_exp(a[i] - a_max);
+        row_start[i] = p;
+        for (k = 0; k < ranges[i].width; ++k) {
+            col[p++] = ranges[i].offset + k;
+        }
     }
-    return log(acc) + a_max;
+    row_start[n] = p;
+    a->n_rows = n;
+    a->n_cols = m;
+    a->row_start = row_start;
+    a->col = col;
+    a->val = NULL;
+    return 0;
 }
 
 
-double faster_log_sum_exp(double *a, int n) {
-    // preconditions:
-    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
-    double a_max, acc;
+void batch_log_inplace(double *a, int n) {
     int i;
-    a_max = -INFINITY;
-    for (i = 0; i < n; ++i) {
-        a_max = fmax(a[i], a_max);
-    }
-    if (a_max <= -INFINITY || n <= 1) {
-        return a_max;
-    }
-    // TODO: consider trick of biasing a_max to push more information into ieee exponent bits
-    acc = 0.0;
-    for (i = 0; i < n; ++i) {
-        acc += fast_exp(a[i] - a_max);
+    for (i=0; i<n; ++i) {
+        a[i] = log(a[i]);
     }
-    return fast_log(acc) + a_max;
 }
 
 
-static inline double faster_log_sum_exp_1(const double *a) {
-    return a[0];
-}
-
-static inline double faster_log_sum_exp_2(const double *a) {
-    double a_max;
-    a_max = fmax(a[0], a[1]);
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max)
-    ) + a_max;
+double now_seconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
 }
 
-static inline double faster_log_sum_exp_3(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(a[0], a[1]), a[2]);
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max)
-    ) + a_max;
-}
 
-static inline double faster_log_sum_exp_4(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(a[0], a[1]), fmax(a[2], a[3]));
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max)
-    ) + a_max;
+static int check_sorted(const range_t *ranges, int n) {
+    // 0 if ranges is in compare_ranges order, else 1 after an err: line
+    int i;
+    for (i = 1; i < n; ++i) {
+        if (compare_ranges(&(ranges[i - 1]), &(ranges[i])) > 0) {
+            printf("err: ranges %d and %d out of order: (%d, %d) before (%d, %d)\n", i - 1, i,
+                ranges[i - 1].offset, ranges[i - 1].width, ranges[i].offset, ranges[i].width);
+            return 1;
+        }
+    }
+    return 0;
 }
 
-static inline double faster_log_sum_exp_5(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), a[4]);
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max) +
-        fast_exp(a[4] - a_max)
-    ) + a_max;
-}
 
-static inline double faster_log_sum_exp_6(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(a[4], a[5]));
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max) +
-        fast_exp(a[4] - a_max) +
-        fast_exp(a[5] - a_max)
-    ) + a_max;
+int prefetch_sweep(void) {
+    // ns per range for fasterbb, offset tiling and group prefetch with a
+    // few group sizes and distances, over SWEEP_N ranges at random offsets
+    // into ever larger data. best of SWEEP_REPS runs each.
+    static const int group[] = {1, 8, 8, 16, 32};
+    static const int distance[] = {8, 8, 32, 32, 64};
+    const int n_configs = sizeof(group) / sizeof(group[0]);
+    range_buckets_t buckets;
+    range_tiles_t tiles;
+    range_t *ranges, *tiled;
+    double *logps, t, t0, best, acc = 0.0;
+    int log2_m, m, c, r, err;
+
+    ranges = malloc(SWEEP_N * sizeof(range_t));
+    tiled = malloc(SWEEP_N * sizeof(range_t));
+    if (ranges == NULL || tiled == NULL) {
+        free(ranges);
+        free(tiled);
+        return 2;
+    }
+    printf("%10s %12s %10s %10s", "m", "bytes", "fasterbb", "tiled");
+    for (c = 0; c < n_configs; ++c) {
+        printf("   g%-2d d%-3d", group[c], distance[c]);
+    }
+    printf("   (ns per range)\n");
+    for (log2_m = SWEEP_MIN_LOG2_M; log2_m <= SWEEP_MAX_LOG2_M; log2_m += 2) {
+        m = 1 << log2_m;
+        logps = malloc(m * sizeof(double));
+        if (logps == NULL) {
+            free(ranges);
+            free(tiled);
+            return 2;
+        }
+        sample_uniform(logps, m, 0.0, 1.0);
+        batch_log_inplace(logps, m);
+        sample_ranges(ranges, SWEEP_N, MAX_BB_WIDTH, m);
+        memcpy(tiled, ranges, SWEEP_N * sizeof(range_t));
+        err = sort_ranges_bucketed(ranges, SWEEP_N, &buckets);
+        if (err == 0) {
+            // the larger sizes take the radix sort through every offset digit
+            err = check_sorted(ranges, SWEEP_N);
+        }
+        if (err == 0) {
+            err = sort_ranges_tiled(tiled, SWEEP_N, TILE_SHIFT, &tiles);
+        }
+        if (err != 0) {
+            free(logps);
+            free(ranges);
+            free(tiled);
+            return err;
+        }
+        printf("%10d %12zu", m, m * sizeof(double));
+        for (c = -2; c < n_configs; ++c) {
+            best = INFINITY;
+            for (r = 0; r < SWEEP_REPS; ++r) {
+                t0 = now_seconds();
+                if (c == -2) {
+                    acc += faster_log_sum_exp_bb_buckets(ranges, &buckets, logps);
+                } else if (c == -1) {
+                    acc += faster_log_sum_exp_bb_tiled(tiled, &tiles, logps);
+                } else {
+                    acc += faster_log_sum_exp_bb_prefetch(ranges, &buckets, logps, group[c], distance[c]);
+                }
+                t = now_seconds() - t0;
+                best = (t < best) ? t : best;
+            }
+            printf(" %10.2f", 1e9 * best / SWEEP_N);
+        }
+        printf("\n");
+        release_range_tiles(&tiles);
+        free(logps);
+    }
+    printf("acc = %g\n", acc);
+    free(ranges);
+    free(tiled);
+    return 0;
 }
 
-static inline double faster_log_sum_exp_7(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), a[6]));
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max) +
-        fast_exp(a[4] - a_max) +
-        fast_exp(a[5] - a_max) +
-        fast_exp(a[6] - a_max)
-    ) + a_max;
-}
 
-static inline double faster_log_sum_exp_8(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), fmax(a[6], a[7])));
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max) +
-        fast_exp(a[4] - a_max) +
-        fast_exp(a[5] - a_max) +
-        fast_exp(a[6] - a_max) +
-        fast_exp(a[7] - a_max)
-    ) + a_max;
-}
+int prune_bench(void) {
+    // ns per range for wide ranges through faster_log_sum_exp_bb_tier and
+    // faster_log_sum_exp_bb_pruned, and for the block maxima update the
+    // pruned kernel needs whenever the data changes. best of PRUNE_REPS.
+    static const double fraction[] = {1.0, 0.1, 0.01, 0.001};
+    const int n_fractions = sizeof(fraction) / sizeof(fraction[0]);
+    const int m = 1 << PRUNE_LOG2_M;
+    range_buckets_t buckets;
+    block_maxima_t bm;
+    range_t *ranges;
+    double *logps, t, t0, best[3], exact = 0.0, pruned = 0.0;
+    int i, f, c, r, err;
 
-static inline double faster_log_sum_exp_9(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), fmax(a[6], a[7]))), a[8]);
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max) +
-        fast_exp(a[4] - a_max) +
-        fast_exp(a[5] - a_max) +
-        fast_exp(a[6] - a_max) +
-        fast_exp(a[7] - a_max) +
-        fast_exp(a[8] - a_max)
-    ) + a_max;
+    ranges = malloc(PRUNE_N * sizeof(range_t));
+    logps = malloc(m * sizeof(double));
+    if (ranges == NULL || logps == NULL) {
+        free(ranges);
+        free(logps);
+        return 2;
+    }
+    for (i = 0; i < PRUNE_N; ++i) {
+        ranges[i].width = PRUNE_MIN_WIDTH + rand() % (PRUNE_MAX_WIDTH - PRUNE_MIN_WIDTH + 1);
+        ranges[i].offset = rand() % (m - ranges[i].width + 1);
+    }
+    err = sort_ranges_bucketed(ranges, PRUNE_N, &buckets);
+    if (err == 0) {
+        err = make_block_maxima(logps, m, &bm);
+    }
+    if (err != 0) {
+        free(ranges);
+        free(logps);
+        return err;
+    }
+    printf("%10s %10s %10s %10s %12s   (ns per range)\n", "fraction", "update", "bbtier", "pruned", "rel diff");
+    for (f = 0; f < n_fractions; ++f) {
+        sample_uniform(logps, m, 0.0, 1.0);
+        batch_log_inplace(logps, m);
+        for (i = 0; i < m; ++i) {
+            if (rand() >= fraction[f] * RAND_MAX) {
+                logps[i] -= 100.0 + 900.0 * rand() / RAND_MAX;
+            }
+        }
+        // the update comes first: the pruned kernel needs fresh maxima
+        for (c = 0; c < 3; ++c) {
+            best[c] = INFINITY;
+            for (r = 0; r < PRUNE_REPS; ++r) {
+                t0 = now_seconds();
+                if (c == 0) {
+                    update_block_maxima(logps, m, &bm);
+                } else if (c == 1) {
+                    exact = faster_log_sum_exp_bb_tier(ranges, &buckets, logps, APPROX_TIER_RAW);
+                } else {
+                    pruned = faster_log_sum_exp_bb_pruned(ranges, &buckets, logps, &bm);
+                }
+                t = now_seconds() - t0;
+                best[c] = (t < best[c]) ? t : best[c];
+            }
+        }
+        printf("%10g %10.1f %10.1f %10.1f %12.3g\n", fraction[f], 1e9 * best[0] / PRUNE_N,
+            1e9 * best[1] / PRUNE_N, 1e9 * best[2] / PRUNE_N, fabs(pruned - exact) / fabs(exact));
+    }
+    release_block_maxima(&bm);
+    free(ranges);
+    free(logps);
+    return 0;
 }
 
-static inline double faster_log_sum_exp_10(const double *a) {
-    double a_max;
-    a_max = fmax(fmax(fmax(fmax(a[0], a[1]), fmax(a[2], a[3])), fmax(fmax(a[4], a[5]), fmax(a[6], a[7]))), fmax(a[8], a[9]));
-    if (a_max <= -INFINITY) {
-        return a_max;
-    }
-    return fast_log(
-        fast_exp(a[0] - a_max) +
-        fast_exp(a[1] - a_max) +
-        fast_exp(a[2] - a_max) +
-        fast_exp(a[3] - a_max) +
-        fast_exp(a[4] - a_max) +
-        fast_exp(a[5] - a_max) +
-        fast_exp(a[6] - a_max) +
-        fast_exp(a[7] - a_max) +
-        fast_exp(a[8] - a_max) +
-        fast_exp(a[9] - a_max)
-    ) + a_max;
-}
 
+int shard_bench(void) {
+    // ms per execute for the pattern in one process, and sharded over 1,
+    // 2, 4, ... worker processes. best of SHARD_REPS.
+    const int m = 1 << SHARD_LOG2_M;
+    range_buckets_t buckets;
+    lse_shard_t *shard;
+    range_t *ranges, *sorted;
+    double *logps, t, t0, best, exact, total = 0.0;
+    int p, r, err;
 
-double faster_log_sum_exp_bb(range_t *ranges, double *logps, int n) {
-    // this version only supports ranges of with 1 -- 10.
-    // pre-req: input ranges ordered with nondecreasing width
+    ranges = malloc(SHARD_N * sizeof(range_t));
+    sorted = malloc(SHARD_N * sizeof(range_t));
+    logps = malloc(m * sizeof(double));
+    if (ranges == NULL || sorted == NULL || logps == NULL) {
+        free(ranges);
+        free(sorted);
+        free(logps);
+        return 2;
+    }
+    sample_ranges(ranges, SHARD_N, MAX_BB_WIDTH, m);
+    sample_uniform(logps, m, 0.0, 1.0);
+    batch_log_inplace(logps, m);
+    memcpy(sorted, ranges, SHARD_N * sizeof(range_t));
+    err = sort_ranges_bucketed(sorted, SHARD_N, &buckets);
+    if (err != 0) {
+        free(ranges);
+        free(sorted);
+        free(logps);
+        return err;
+    }
 
-    // method       running time (s)
-    // ------
-    // faster       0.532
-    // fasterbb     0.421
+    best = INFINITY;
+    exact = 0.0;
+    for (r = 0; r < SHARD_REPS; ++r) {
+        t0 = now_seconds();
+        exact = faster_log_sum_exp_bb_tier(sorted, &buckets, logps, APPROX_TIER_RAW);
+        t = now_seconds() - t0;
+        best = (t < best) ? t : best;
+    }
+    printf("%8s %10s %12s\n", "workers", "ms", "rel diff");
+    printf("%8s %10.2f %12.3g\n", "none", 1e3 * best, 0.0);
+
+    for (p = 1; p <= SHARD_MAX_WORKERS; p *= 2) {
+        shard = lse_shard_create(ranges, SHARD_N, m, p, 1);
+        if (shard == NULL) {
+            perror("err: lse_shard_create");
+            break;
+        }
+        memcpy(lse_shard_logps(shard), logps, m * sizeof(double));
+        best = INFINITY;
+        for (r = 0; r < SHARD_REPS; ++r) {
+            t0 = now_seconds();
+            total = lse_shard_execute(shard);
+            t = now_seconds() - t0;
+            best = (t < best) ? t : best;
+        }
+        if (isnan(total)) {
+            perror("err: lse_shard_execute");
+        }
+        printf("%8d %10.2f %12.3g\n", p, 1e3 * best, fabs(total - exact) / fabs(exact));
+        lse_shard_destroy(shard);
+    }
+    free(ranges);
+    free(sorted);
+    free(logps);
+    return 0;
+}
 
-    double acc = 0.0;
 
-    int i = 0.0;
+static int lsed_client(const char *path, const uint32_t *patterns, range_t **ranges, const int *n, int m, int c) {
+    // one client process: its own data, evaluated against each pattern in
+    // turn and checked against local plans planned as lsed plans them
+    lse_options_t options;
+    lse_plan_t *plan[LSED_PATTERNS];
+    uint32_t data;
+    double *logps, total, expected[LSED_PATTERNS];
+    int fd, i, p, bad = 0;
 
-    for(; i < n && ranges[i].width == 1; ++i) {
-        acc += faster_log_sum_exp_1(&(logps[ranges[i].offset]));
+    logps = malloc(m * sizeof(double));
+    fd = lse_service_connect(path);
+    if (logps == NULL || fd < 0) {
+        perror("err: lsed client");
+        return 1;
     }
-    for(; i < n && ranges[i].width == 2; ++i) {
-        acc += faster_log_sum_exp_2(&(logps[ranges[i].offset]));
+    srand(1000 + c);
+    sample_uniform(logps, m, 0.0, 1.0);
+    batch_log_inplace(logps, m);
+    lse_options_init(&options);
+    options.sliding = 0;
+    for (p = 0; p < LSED_PATTERNS; ++p) {
+        plan[p] = lse_plan_create(ranges[p], n[p], &options);
+        if (plan[p] == NULL) {
+            perror("err: lse_plan_create");
+            return 1;
+        }
+        expected[p] = lse_plan_execute(plan[p], logps, NULL);
+        lse_plan_destroy(plan[p]);
     }
-    for(; i < n && ranges[i].width == 3; ++i) {
-        acc += faster_log_sum_exp_3(&(logps[ranges[i].offset]));
+    if (lse_service_data(fd, logps, m, &data) != 0) {
+        perror("err: lse_service_data");
+        return 1;
     }
-    for(; i < n && ranges[i].width == 4; ++i) {
-        acc += faster_log_sum_exp_4(&(logps[ranges[i].offset]));
+    for (i = 0; i < LSED_REQUESTS; ++i) {
+        p = i % LSED_PATTERNS;
+        if (lse_service_evaluate(fd, patterns[p], data, &total) != 0) {
+            perror("err: lse_service_evaluate");
+            return 1;
+        }
+        bad += (fabs(total - expected[p]) > 1e-9 * fabs(expected[p]));
     }
-    for(; i < n && ranges[i].width == 5; ++i) {
-        acc += faster_log_sum_exp_5(&(logps[ranges[i].offset]));
+    if (bad > 0) {
+        printf("err: client %d: %d of %d totals differ from a local plan\n", c, bad, LSED_REQUESTS);
+        // the caller leaves with _exit, which does not flush
+        fflush(stdout);
     }
-    for(; i < n && ranges[i].width == 6; ++i) {
-        acc += faster_log_sum_exp_6(&(logps[ranges[i].offset]));
+    close(fd);
+    free(logps);
+    return bad > 0;
+}
+
+
+int lsed_bench(void) {
+    // registers the patterns, then runs the clients concurrently and
+    // prints the daemon's stats. the second pattern is every window of
+    // WINDOW_WIDTH: a single run of consecutive equal-width ranges.
+    const char *path = getenv("LSED_SOCKET");
+    const int m = 1000;
+    int n[LSED_PATTERNS] = {5000, m - WINDOW_WIDTH + 1};
+    char text[4096];
+    range_t *ranges[LSED_PATTERNS];
+    uint32_t patterns[LSED_PATTERNS];
+    double t0, t;
+    int fd, c, i, p, status, failed = 0;
+    pid_t pid;
+
+    if (path == NULL) {
+        path = LSED_DEFAULT_SOCKET;
     }
-    for(; i < n && ranges[i].width == 7; ++i) {
-        acc += faster_log_sum_exp_7(&(logps[ranges[i].offset]));
+    fd = lse_service_connect(path);
+    if (fd < 0) {
+        perror("err: lse_service_connect");
+        return 1;
     }
-    for(; i < n && ranges[i].width == 8; ++i) {
-        acc += faster_log_sum_exp_8(&(logps[ranges[i].offset]));
+    ranges[0] = malloc(n[0] * sizeof(range_t));
+    ranges[1] = malloc(n[1] * sizeof(range_t));
+    if (ranges[0] == NULL || ranges[1] == NULL) {
+        free(ranges[0]);
+        free(ranges[1]);
+        close(fd);
+        return 2;
     }
-    for(; i < n && ranges[i].width == 9; ++i) {
-        acc += faster_log_sum_exp_9(&(logps[ranges[i].offset]));
+    srand(12345);
+    sample_ranges(ranges[0], n[0], MAX_BB_WIDTH, m);
+    for (i = 0; i < n[1]; ++i) {
+        ranges[1][i].offset = i;
+        ranges[1][i].width = WINDOW_WIDTH;
     }
-    for(; i < n && ranges[i].width == 10; ++i) {
-        acc += faster_log_sum_exp_10(&(logps[ranges[i].offset]));
+    for (p = 0; p < LSED_PATTERNS; ++p) {
+        if (lse_service_pattern(fd, ranges[p], n[p], &(patterns[p])) != 0) {
+            perror("err: lse_service_pattern");
+            failed = 1;
+        }
     }
-    return acc;
-}
 
-
-void sample_uniform(double *a, int n, double min, double max) {
-    int i;
-    double range = (max - min); 
-    double div = RAND_MAX / range;
-
-    for (i=0; i<n; ++i) {
-        a[i] = min + (rand() / div);
+    fflush(stdout);
+    t0 = now_seconds();
+    for (c = 0; c < LSED_CLIENTS && !failed; ++c) {
+        pid = fork();
+        if (pid < 0) {
+            perror("err: fork");
+            failed = 1;
+            break;
+        }
+        if (pid == 0) {
+            _exit(lsed_client(path, patterns, ranges, n, m, c));
+        }
     }
-}
-
-
-void sample_ranges(range_t *ranges, int n, int w, int m) {
-    int i, width, offset;
-    for (i=0; i<n; ++i) {
-        // sample width from 1 to w
-        width = rand() % (w + 1 - 1) + 1;
-        // sample offset from 0 to m-width
-        offset = rand() % (m-width + 1);
-        ranges[i].offset = offset;
-        ranges[i].width = width;
+    while (wait(&status) > 0) {
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
     }
-}
-
-
-
-int compare_ranges(const void *a, const void *b) {
-    range_t *aa, *bb;
-    aa = (range_t*)a;
-    bb = (range_t*)b;
-    int delta_w, delta_o;
-    delta_w = (aa->width - bb->width);
-    delta_o = (aa->offset - bb->offset);
-    // return (delta_o != 0) ? delta_o : delta_w; // bad order
-    return (delta_w != 0) ? delta_w : delta_o; // good order
-}
+    t = now_seconds() - t0;
+    printf("%d clients x %d evaluations in %.3fs: %.0f evaluations/s\n",
+        LSED_CLIENTS, LSED_REQUESTS, t, LSED_CLIENTS * LSED_REQUESTS / t);
 
-void sort_ranges_inplace(range_t *ranges, int n) {
-    qsort((void *)ranges, n, sizeof(range_t), compare_ranges);
+    if (lse_service_stats(fd, text, sizeof(text)) != 0) {
+        perror("err: lse_service_stats");
+        failed = 1;
+    } else {
+        printf("%s", text);
+    }
+    close(fd);
+    free(ranges[0]);
+    free(ranges[1]);
+    return failed;
 }
 
 
-void batch_log_inplace(double *a, int n) {
-    int i;
-    for (i=0; i<n; ++i) {
-        a[i] = log(a[i]);
+#ifdef LSE_INSTRUMENT
+static void report_instrument(void) {
+    // LSE_INSTRUMENT_FORMAT=json for json, else text
+    const char *format = getenv("LSE_INSTRUMENT_FORMAT");
+    printf("instrument:\n");
+    if (lse_instrument_write(stdout, (format != NULL && strcmp(format, "json") == 0) ?
+            LSE_INSTRUMENT_FORMAT_JSON : LSE_INSTRUMENT_FORMAT_TEXT) != 0) {
+        perror("err: lse_instrument_write");
     }
 }
+#endif
 
 
 int main(int argc, char **argv) {
@@ -413,6 +578,33 @@ int main(int argc, char **argv) {
     jf.size = 0;
     jf.f = NULL;
 
+    compact_ranges_t cr;
+    bytecode_t bc;
+    range_buckets_t buckets;
+    range_tiles_t tiles;
+    lse_plan_t *plan;
+    lse_tiered_t *tiered;
+    lse_tiered_stats_t stats;
+    sample_estimate_t est;
+    long n_sampled;
+
+    csr_matrix_t csr;
+    csr_slices_t slices;
+    double *out;
+
+    double *gemm_a, *gemm_b, *gemm_c;
+
+    int total_width, k, tier;
+    lse_options_t options;
+    range_t *windows;
+    double exact, faster_total, sliding_total;
+    block_maxima_t bm;
+    exp_cache_t ec;
+    quant_logps_t ql;
+    soa_logps_t soa;
+    double *multi_logps, *multi_cols, multi_totals[MULTI_K];
+    double lse;
+
     if (argc <= 1) {
         printf("set mode=base\n");
         mode = MODE_BASE;
@@ -435,13 +627,144 @@ int main(int argc, char **argv) {
         } else if (strcmp(argv[1], "jit") == 0) {
             printf("set mode=jit\n");
             mode = MODE_JIT;
+        } else if (strcmp(argv[1], "compactbb") == 0) {
+            printf("set mode=compactbb\n");
+            mode = MODE_COMPACTBB;
+        } else if (strcmp(argv[1], "plan") == 0) {
+            printf("set mode=plan\n");
+            mode = MODE_PLAN;
+        } else if (strcmp(argv[1], "csr") == 0) {
+            printf("set mode=csr\n");
+            mode = MODE_CSR;
+        } else if (strcmp(argv[1], "csrrows") == 0) {
+            printf("set mode=csrrows\n");
+            mode = MODE_CSR_ROWS;
+        } else if (strcmp(argv[1], "gemm") == 0) {
+            printf("set mode=gemm\n");
+            mode = MODE_GEMM;
+        } else if (strcmp(argv[1], "gemmnaive") == 0) {
+            printf("set mode=gemmnaive\n");
+            mode = MODE_GEMM_NAIVE;
+        } else if (strcmp(argv[1], "gemmexact") == 0) {
+            printf("set mode=gemmexact\n");
+            mode = MODE_GEMM_EXACT;
+        } else if (strcmp(argv[1], "softmaxbb") == 0) {
+            printf("set mode=softmaxbb\n");
+            mode = MODE_SOFTMAX_BB;
+        } else if (strcmp(argv[1], "softmaxsimd") == 0) {
+            printf("set mode=softmaxsimd\n");
+            mode = MODE_SOFTMAX_SIMD;
+        } else if (strcmp(argv[1], "softmaxjit") == 0) {
+            printf("set mode=softmaxjit\n");
+            mode = MODE_SOFTMAX_JIT;
+        } else if (strcmp(argv[1], "softmax2pass") == 0) {
+            printf("set mode=softmax2pass\n");
+            mode = MODE_SOFTMAX_2PASS;
+        } else if (strcmp(argv[1], "windows") == 0) {
+            printf("set mode=windows\n");
+            mode = MODE_WINDOWS;
+        } else if (strcmp(argv[1], "windowsbb") == 0) {
+            printf("set mode=windowsbb\n");
+            mode = MODE_WINDOWS_BB;
+        } else if (strcmp(argv[1], "blockmax") == 0) {
+            printf("set mode=blockmax\n");
+            mode = MODE_BLOCKMAX;
+        } else if (strcmp(argv[1], "expcache") == 0) {
+            printf("set mode=expcache\n");
+            mode = MODE_EXPCACHE;
+        } else if (strcmp(argv[1], "bbtable") == 0) {
+            printf("set mode=bbtable\n");
+            mode = MODE_BB_TABLE;
+        } else if (strcmp(argv[1], "bbpoly") == 0) {
+            printf("set mode=bbpoly\n");
+            mode = MODE_BB_POLY;
+        } else if (strcmp(argv[1], "jittable") == 0) {
+            printf("set mode=jittable\n");
+            mode = MODE_JIT_TABLE;
+        } else if (strcmp(argv[1], "jitpoly") == 0) {
+            printf("set mode=jitpoly\n");
+            mode = MODE_JIT_POLY;
+        } else if (strcmp(argv[1], "basebb") == 0) {
+            printf("set mode=basebb\n");
+            mode = MODE_BASEBB;
+        } else if (strcmp(argv[1], "quant16") == 0) {
+            printf("set mode=quant16\n");
+            mode = MODE_QUANT16;
+        } else if (strcmp(argv[1], "quant8") == 0) {
+            printf("set mode=quant8\n");
+            mode = MODE_QUANT8;
+        } else if (strcmp(argv[1], "multibb") == 0) {
+            printf("set mode=multibb\n");
+            mode = MODE_MULTI_BB;
+        } else if (strcmp(argv[1], "multijit") == 0) {
+            printf("set mode=multijit\n");
+            mode = MODE_MULTI_JIT;
+        } else if (strcmp(argv[1], "multiloop") == 0) {
+            printf("set mode=multiloop\n");
+            mode = MODE_MULTI_LOOP;
+        } else if (strcmp(argv[1], "tune") == 0) {
+            printf("set mode=tune\n");
+            mode = MODE_TUNE;
+        } else if (strcmp(argv[1], "prefetch") == 0) {
+            printf("set mode=prefetch\n");
+            mode = MODE_PREFETCH;
+        } else if (strcmp(argv[1], "prefetchsweep") == 0) {
+            printf("set mode=prefetchsweep\n");
+            mode = MODE_PREFETCH_SWEEP;
+        } else if (strcmp(argv[1], "tiled") == 0) {
+            printf("set mode=tiled\n");
+            mode = MODE_TILED;
+        } else if (strcmp(argv[1], "soa") == 0) {
+            printf("set mode=soa\n");
+            mode = MODE_SOA;
+        } else if (strcmp(argv[1], "soarefresh") == 0) {
+            printf("set mode=soarefresh\n");
+            mode = MODE_SOA_REFRESH;
+        } else if (strcmp(argv[1], "interp") == 0) {
+            printf("set mode=interp\n");
+            mode = MODE_INTERP;
+        } else if (strcmp(argv[1], "tiered") == 0) {
+            printf("set mode=tiered\n");
+            mode = MODE_TIERED;
+        } else if (strcmp(argv[1], "sample") == 0) {
+            printf("set mode=sample\n");
+            mode = MODE_SAMPLE;
+        } else if (strcmp(argv[1], "prune") == 0) {
+            printf("set mode=prune\n");
+            mode = MODE_PRUNE;
+        } else if (strcmp(argv[1], "shard") == 0) {
+            printf("set mode=shard\n");
+            mode = MODE_SHARD;
+        } else if (strcmp(argv[1], "lsed") == 0) {
+            printf("set mode=lsed\n");
+            mode = MODE_LSED;
         } else {
-            printf("unrecognised mode, expected one of 'base', 'fast', 'faster', 'fasterbb', 'jit', 'onlysum'\n");
+            printf("unrecognised mode, expected one of 'base', 'fast', 'faster', 'fasterbb', 'compactbb', 'jit', 'plan', 'csr', 'csrrows', 'gemm', 'gemmnaive', 'gemmexact', 'softmaxbb', 'softmaxsimd', 'softmaxjit', 'softmax2pass', 'windows', 'windowsbb', 'blockmax', 'expcache', 'bbtable', 'bbpoly', 'jittable', 'jitpoly', 'basebb', 'quant16', 'quant8', 'multibb', 'multijit', 'multiloop', 'tune', 'prefetch', 'prefetchsweep', 'tiled', 'soa', 'soarefresh', 'interp', 'tiered', 'sample', 'prune', 'shard', 'lsed', 'onlysum'\n");
             exit(1);
         }
     }
 
     printf("init\n");
+#ifdef LSE_INSTRUMENT
+    atexit(report_instrument);
+#endif
+
+    if (mode == MODE_PREFETCH_SWEEP) {
+        // sets up its own data and patterns, one per size
+        return prefetch_sweep();
+    }
+    if (mode == MODE_PRUNE) {
+        // wide ranges over large, mostly negligible data of its own
+        return prune_bench();
+    }
+    if (mode == MODE_SHARD) {
+        // one large pattern over worker processes
+        return shard_bench();
+    }
+    if (mode == MODE_LSED) {
+        // a client of a running lsed
+        return lsed_bench();
+    }
 
     seed = 12345;
     srand(seed);
@@ -467,7 +790,11 @@ int main(int argc, char **argv) {
     //  unsorted            0.760               7.59
     //  sorted by offset    0.734               6.74
     //  sorted by width     0.534               0.02
-    sort_ranges_inplace(ranges, n);
+    err = sort_ranges_bucketed(ranges, n, &buckets);
+    if (err != 0) {
+        fprintf(stderr, "err: sort_ranges_bucketed: %d\n", err);
+        return err;
+    }
 
     trials = 10000;
 
@@ -500,15 +827,398 @@ int main(int argc, char **argv) {
     } else if (mode == MODE_FASTERBB) {
         for (j = 0; j < trials; ++j) {
             logps[0] += acc; // impede optimisation
-            acc += faster_log_sum_exp_bb(ranges, logps, n);
+            acc += faster_log_sum_exp_bb_buckets(ranges, &buckets, logps);
             logps[0] -= acc; // impede optimisation
        }
-    } else if (mode == MODE_JIT) {
+    } else if (mode == MODE_BASEBB) {
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += log_sum_exp_bb_buckets(ranges, &buckets, logps);
+            logps[0] -= acc; // impede optimisation
+        }
+    } else if (mode == MODE_QUANT16 || mode == MODE_QUANT8) {
+        // the data is stored quantised: encode it once, up front
+        err = make_quant_logps(logps, m, (mode == MODE_QUANT16) ? 16 : 8, &ql);
+        if (err != 0) {
+            fprintf(stderr, "err: make_quant_logps: %d\n", err);
+            return err;
+        }
+        for (j = 0; j < trials; ++j) {
+            acc += faster_log_sum_exp_bb_quant(ranges, &buckets, &ql);
+        }
+        release_quant_logps(&ql);
+    } else if (mode == MODE_MULTI_BB || mode == MODE_MULTI_JIT || mode == MODE_MULTI_LOOP) {
+        // MULTI_K slightly different data vectors, interleaved. each call
+        // does MULTI_K vectors of work, so there are trials / MULTI_K calls.
+        // multiloop reads the same vectors from contiguous copies.
+        multi_logps = malloc(m * MULTI_K * sizeof(double));
+        multi_cols = malloc(m * MULTI_K * sizeof(double));
+        if (multi_logps == NULL || multi_cols == NULL) {
+            perror("err: malloc");
+            return 2;
+        }
+        for (i = 0; i < m; ++i) {
+            for (k = 0; k < MULTI_K; ++k) {
+                multi_logps[i * MULTI_K + k] = logps[i] - 0.01 * k;
+                multi_cols[k * m + i] = logps[i] - 0.01 * k;
+            }
+        }
+        if (mode == MODE_MULTI_JIT) {
+            err = make_multi_log_sum_exp_jit_reduction_func(ranges, n, MULTI_K, &jf);
+            if (err != 0) {
+                perror("err: make_multi_log_sum_exp_jit_reduction_func");
+                return err;
+            }
+            err = arm_jit_reduction_func(&jf);
+            if (err != 0) {
+                perror("err: arm_jit_reduction_func");
+                release_jit_reduction_func(&jf);
+                return err;
+            }
+        }
+        for (j = 0; j < trials / MULTI_K; ++j) {
+            if (mode == MODE_MULTI_BB) {
+                faster_log_sum_exp_bb_multi(ranges, &buckets, multi_logps, MULTI_K, multi_totals);
+            } else if (mode == MODE_MULTI_JIT) {
+                for (k = 0; k < MULTI_K; k += 4) {
+                    LSE_INSTRUMENT_START(t0);
+                    ((multi_reduction_func_t)(void *)jf.f)(multi_logps + k, multi_totals + k);
+                    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_JIT_MULTI, t0);
+                }
+            } else {
+                // one call per vector
+                for (k = 0; k < MULTI_K; ++k) {
+                    multi_totals[k] = faster_log_sum_exp_bb_buckets(ranges, &buckets, multi_cols + k * m);
+                }
+            }
+            for (k = 0; k < MULTI_K; ++k) {
+                acc += multi_totals[k];
+            }
+        }
+        if (mode == MODE_MULTI_JIT) {
+            release_jit_reduction_func(&jf);
+        }
+        free(multi_logps);
+        free(multi_cols);
+    } else if (mode == MODE_BB_TABLE || mode == MODE_BB_POLY) {
+        tier = (mode == MODE_BB_TABLE) ? APPROX_TIER_TABLE : APPROX_TIER_POLY;
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += faster_log_sum_exp_bb_tier(ranges, &buckets, logps, tier);
+            logps[0] -= acc; // impede optimisation
+        }
+    } else if (mode == MODE_PREFETCH) {
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += faster_log_sum_exp_bb_prefetch(ranges, &buckets, logps, PREFETCH_GROUP, PREFETCH_DISTANCE);
+            logps[0] -= acc; // impede optimisation
+        }
+    } else if (mode == MODE_TILED) {
+        // reorders ranges: tile first, then the usual width and offset
+        err = sort_ranges_tiled(ranges, n, TILE_SHIFT, &tiles);
+        if (err != 0) {
+            fprintf(stderr, "err: sort_ranges_tiled: %d\n", err);
+            return err;
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += faster_log_sum_exp_bb_tiled(ranges, &tiles, logps);
+            logps[0] -= acc; // impede optimisation
+        }
+        release_range_tiles(&tiles);
+    } else if (mode == MODE_SOA || mode == MODE_SOA_REFRESH) {
+        err = make_soa_logps(ranges, &buckets, logps, &soa);
+        if (err != 0) {
+            fprintf(stderr, "err: make_soa_logps: %d\n", err);
+            return err;
+        }
+        for (j = 0; j < trials; ++j) {
+            if (mode == MODE_SOA_REFRESH) {
+                // the data changes every trial, so the copy must follow
+                logps[0] += acc; // impede optimisation
+                update_soa_logps(ranges, &buckets, logps, &soa);
+                acc += faster_log_sum_exp_bb_soa(&soa);
+                logps[0] -= acc; // impede optimisation
+            } else {
+                acc += faster_log_sum_exp_bb_soa(&soa);
+            }
+        }
+        release_soa_logps(&soa);
+    } else if (mode == MODE_BLOCKMAX) {
+        err = make_block_maxima(logps, m, &bm);
+        if (err != 0) {
+            fprintf(stderr, "err: make_block_maxima: %d\n", err);
+            return err;
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            // the data changes every trial, so the maxima do too
+            update_block_maxima(logps, m, &bm);
+            acc += faster_log_sum_exp_bb_blockmax(ranges, &buckets, logps, &bm);
+            logps[0] -= acc; // impede optimisation
+        }
+        release_block_maxima(&bm);
+    } else if (mode == MODE_EXPCACHE) {
+        err = make_exp_cache(logps, m, &ec);
+        if (err != 0) {
+            fprintf(stderr, "err: make_exp_cache: %d\n", err);
+            return err;
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            // the data changes every trial, so the cache does too
+            update_exp_cache(logps, m, &ec);
+            acc += faster_log_sum_exp_bb_expcache(ranges, &buckets, logps, &ec);
+            logps[0] -= acc; // impede optimisation
+        }
+        release_exp_cache(&ec);
+    } else if (mode == MODE_COMPACTBB) {
+        err = make_compact_ranges(ranges, n, &cr);
+        if (err != 0) {
+            fprintf(stderr, "err: make_compact_ranges: %d\n", err);
+            return err;
+        }
+        printf("compact: %d ranges encoded in %zu bytes (was %zu bytes)\n", n, cr.size, n * sizeof(range_t));
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += faster_log_sum_exp_bb_compact(&cr, logps);
+            logps[0] -= acc; // impede optimisation
+        }
+        release_compact_ranges(&cr);
+    } else if (mode == MODE_SAMPLE) {
+        n_sampled = 0;
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            err = faster_log_sum_exp_bb_sample(ranges, &buckets, logps, SAMPLE_REL_ERR, SAMPLE_Z, j, &est);
+            if (err != 0) {
+                fprintf(stderr, "err: faster_log_sum_exp_bb_sample: %d\n", err);
+                return err;
+            }
+            acc += est.estimate;
+            logps[0] -= acc; // impede optimisation
+            n_sampled += est.n_sampled;
+        }
+        // one more estimate, against the exact total of the same data
+        faster_log_sum_exp_bb_sample(ranges, &buckets, logps, SAMPLE_REL_ERR, SAMPLE_Z, trials, &est);
+        printf("sample: %.1f of %d ranges evaluated on average. now %g +- %g, exact %g\n",
+            (double)n_sampled / trials, est.n_ranges, est.estimate, est.half_width,
+            faster_log_sum_exp_bb_buckets(ranges, &buckets, logps));
+    } else if (mode == MODE_TIERED) {
+        tiered = lse_tiered_create(NULL);
+        if (tiered == NULL) {
+            perror("err: lse_tiered_create");
+            return 1;
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += lse_tiered_execute(tiered, ranges, n, logps, NULL);
+            logps[0] -= acc; // impede optimisation
+            if (j % TIERED_COLD_EVERY == 0) {
+                // a different slice each time, so only the hot pattern repeats
+                lse_tiered_execute(tiered, ranges + (j / TIERED_COLD_EVERY) % (n - TIERED_COLD_N),
+                    TIERED_COLD_N, logps, NULL);
+            }
+        }
+        lse_tiered_stats(tiered, &stats);
+        printf("tiered: %ld calls, %ld bb, %ld jit, %ld promotions, %ld demotions, %ld evictions, "
+            "%d patterns, %d jit\n", stats.calls, stats.bb_calls, stats.jit_calls, stats.promotions,
+            stats.demotions, stats.evictions, stats.n_patterns, stats.n_jit);
+        lse_tiered_destroy(tiered);
+    } else if (mode == MODE_INTERP) {
+        err = make_bytecode(ranges, n, &bc);
+        if (err != 0) {
+            fprintf(stderr, "err: make_bytecode: %d\n", err);
+            return err;
+        }
+        printf("interp: %d ranges compiled to %zu bytes of bytecode\n", n, bc.size);
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += faster_log_sum_exp_interp(&bc, logps);
+            logps[0] -= acc; // impede optimisation
+        }
+        release_bytecode(&bc);
+    } else if (mode == MODE_PLAN || mode == MODE_TUNE) {
+        lse_options_init(&options);
+        if (mode == MODE_TUNE) {
+            options.tune = 1;
+            options.tune_cache = "lse_tune.cache";
+            options.tune_logps = logps;
+        }
+        plan = lse_plan_create(ranges, n, &options);
+        if (plan == NULL) {
+            perror("err: lse_plan_create");
+            return 1;
+        }
+        printf("plan: %d ranges, %d distinct, strategy %d\n", lse_plan_n_ranges(plan), lse_plan_n_unique(plan), lse_plan_strategy(plan));
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += lse_plan_execute(plan, logps, NULL);
+            logps[0] -= acc; // impede optimisation
+        }
+        lse_plan_destroy(plan);
+    } else if (mode == MODE_CSR || mode == MODE_CSR_ROWS) {
+        err = ranges_to_csr(ranges, n, m, &csr);
+        if (err == 0 && mode == MODE_CSR) {
+            err = make_csr_slices(&csr, &slices);
+        }
+        out = malloc(n * sizeof(double) + 1);
+        if (err != 0 || out == NULL) {
+            fprintf(stderr, "err: csr setup: %d\n", err);
+            return 1;
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            if (mode == MODE_CSR) {
+                csr_log_sum_exp_slices(&slices, logps, out);
+            } else {
+                csr_log_sum_exp_rows(&csr, logps, out);
+            }
+            for (i = 0; i < n; ++i) {
+                acc += out[i];
+            }
+            logps[0] -= acc; // impede optimisation
+        }
+        if (mode == MODE_CSR) {
+            release_csr_slices(&slices);
+        }
+        free(out);
+        free((void *)csr.row_start);
+        free((void *)csr.col);
+    } else if (mode == MODE_GEMM || mode == MODE_GEMM_NAIVE || mode == MODE_GEMM_EXACT) {
+        // A, B: log transition-like matrices. C = A (x) B in the log semiring.
+        gemm_a = malloc(3 * GEMM_SIZE * GEMM_SIZE * sizeof(double));
+        if (gemm_a == NULL) {
+            perror("err: malloc");
+            return 1;
+        }
+        gemm_b = gemm_a + GEMM_SIZE * GEMM_SIZE;
+        gemm_c = gemm_b + GEMM_SIZE * GEMM_SIZE;
+        sample_uniform(gemm_a, 2 * GEMM_SIZE * GEMM_SIZE, 0.0, 1.0);
+        batch_log_inplace(gemm_a, 2 * GEMM_SIZE * GEMM_SIZE);
+        for (j = 0; j < GEMM_TRIALS; ++j) {
+            if (mode == MODE_GEMM) {
+                err = log_gemm_blocked(GEMM_SIZE, GEMM_SIZE, GEMM_SIZE, gemm_a, gemm_b, gemm_c);
+                if (err != 0) {
+                    fprintf(stderr, "err: log_gemm_blocked: %d\n", err);
+                    return err;
+                }
+            } else if (mode == MODE_GEMM_NAIVE) {
+                log_gemm_fast_naive(GEMM_SIZE, GEMM_SIZE, GEMM_SIZE, gemm_a, gemm_b, gemm_c);
+            } else {
+                log_gemm_exact_naive(GEMM_SIZE, GEMM_SIZE, GEMM_SIZE, gemm_a, gemm_b, gemm_c);
+            }
+            for (i = 0; i < GEMM_SIZE * GEMM_SIZE; ++i) {
+                acc += gemm_c[i];
+            }
+        }
+        free(gemm_a);
+    } else if (mode == MODE_SOFTMAX_BB || mode == MODE_SOFTMAX_SIMD || mode == MODE_SOFTMAX_JIT || mode == MODE_SOFTMAX_2PASS) {
+        // forward log-sum-exp plus the softmax weights of every range
+        total_width = 0;
+        for (i = 0; i < n; ++i) {
+            total_width += ranges[i].width;
+        }
+        out = malloc(total_width * sizeof(double) + 1);
+        if (out == NULL) {
+            perror("err: malloc");
+            return 1;
+        }
+        if (mode == MODE_SOFTMAX_JIT) {
+            err = make_batch_softmax_jit_reduction_func(ranges, n, &jf);
+            if (err != 0) {
+                perror("err: make_batch_softmax_jit_reduction_func");
+                return err;
+            }
+            printf("jit: generated %zu bytes of code\n", jf.size);
+            err = arm_jit_reduction_func(&jf);
+            if (err != 0) {
+                perror("err: arm_jit_reduction_func");
+                return err;
+            }
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            if (mode == MODE_SOFTMAX_BB) {
+                acc += faster_log_sum_exp_softmax_bb(ranges, &buckets, logps, SOFTMAX_WEIGHTS, out, NULL);
+            } else if (mode == MODE_SOFTMAX_SIMD) {
+                acc += faster_log_sum_exp_softmax_simd(ranges, n, logps, SOFTMAX_WEIGHTS, out, NULL);
+            } else if (mode == MODE_SOFTMAX_JIT) {
+                LSE_INSTRUMENT_START(t0);
+                acc += ((fused_reduction_func_t)(void *)jf.f)(logps, out);
+                LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_JIT_SOFTMAX, t0);
+            } else {
+                // unfused: one pass for lse, a second to exponentiate
+                total_width = 0;
+                for (i = 0; i < n; ++i) {
+                    lse = faster_log_sum_exp(&(logps[ranges[i].offset]), ranges[i].width);
+                    for (k = 0; k < ranges[i].width; ++k) {
+                        out[total_width + k] = fast_exp(logps[ranges[i].offset + k] - lse);
+                    }
+                    total_width += ranges[i].width;
+                    acc += lse;
+                }
+            }
+            logps[0] -= acc; // impede optimisation
+        }
+        if (mode == MODE_SOFTMAX_JIT) {
+            err = release_jit_reduction_func(&jf);
+            if (err != 0) {
+                perror("err: release_jit_reduction_func");
+            }
+        }
+        free(out);
+    } else if (mode == MODE_WINDOWS || mode == MODE_WINDOWS_BB) {
+        // (0, w), (1, w), (2, w), ...: sliding windows vs one range at a time
+        windows = malloc((m - WINDOW_WIDTH + 1) * sizeof(range_t));
+        if (windows == NULL) {
+            perror("err: malloc");
+            return 1;
+        }
+        for (i = 0; i <= m - WINDOW_WIDTH; ++i) {
+            windows[i].offset = i;
+            windows[i].width = WINDOW_WIDTH;
+        }
+        lse_options_init(&options);
+        options.strategy = LSE_STRATEGY_BB;
+        options.sliding = (mode == MODE_WINDOWS);
+        plan = lse_plan_create(windows, m - WINDOW_WIDTH + 1, &options);
+        if (plan == NULL) {
+            perror("err: lse_plan_create");
+            return 1;
+        }
+        if (mode == MODE_WINDOWS) {
+            // the sliding total must be no less accurate than faster's
+            exact = 0.0;
+            faster_total = 0.0;
+            for (i = 0; i <= m - WINDOW_WIDTH; ++i) {
+                exact += log_sum_exp(&(logps[i]), WINDOW_WIDTH);
+                faster_total += faster_log_sum_exp(&(logps[i]), WINDOW_WIDTH);
+            }
+            sliding_total = lse_plan_execute(plan, logps, NULL);
+            printf("exact %g faster %g sliding %g\n", exact, faster_total, sliding_total);
+            if (fabs(sliding_total - exact) > fabs(faster_total - exact)) {
+                printf("err: sliding windows are less accurate than faster\n");
+            }
+        }
+        for (j = 0; j < trials; ++j) {
+            logps[0] += acc; // impede optimisation
+            acc += lse_plan_execute(plan, logps, NULL);
+            logps[0] -= acc; // impede optimisation
+        }
+        lse_plan_destroy(plan);
+        free(windows);
+    } else if (mode == MODE_JIT || mode == MODE_JIT_TABLE || mode == MODE_JIT_POLY) {
+        tier = APPROX_TIER_RAW;
+        if (mode == MODE_JIT_TABLE) {
+            tier = APPROX_TIER_TABLE;
+        } else if (mode == MODE_JIT_POLY) {
+            tier = APPROX_TIER_POLY;
+        }
         printf("jit: input pattern has %d ranges with total size %zu bytes\n", n, n * sizeof(range_t));
         printf("jit: generating code\n");
-        err = make_batch_log_sum_exp_jit_reduction_func(ranges, n, &jf);
+        err = make_batch_log_sum_exp_jit_reduction_func_tier(ranges, n, tier, &jf);
         if (err != 0) {
-            perror("err: make_batch_log_sum_exp_jit_reduction_func");
+            perror("err: make_batch_log_sum_exp_jit_reduction_func_tier");
             return err;
         }
         printf("jit: generated %zu bytes of code\n", jf.size);
@@ -525,7 +1235,10 @@ int main(int argc, char **argv) {
         printf("jit: ready\n");
 
         for (j = 0; j < trials; ++j) {
+            // generated code records no latency of its own
+            LSE_INSTRUMENT_START(t0);
             acc += jf.f(logps, ranges, n);
+            LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_JIT, t0);
         }
 
         err = release_jit_reduction_func(&jf);
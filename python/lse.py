@@ -0,0 +1,242 @@
+"""
+lse -- python bindings for the log-sum-exp kernels
+
+purpose:
+
+Call the batched log-sum-exp kernels in liblse.so from python, passing
+numpy buffers straight through to C without copying.
+
+    logps : 1-d float64 array, C-contiguous
+    ranges : (n, 2) int32 array of (offset, width) rows, C-contiguous
+
+usage:
+
+    import numpy as np
+    import lse
+
+    plan = lse.Plan(ranges)             # sort, dedup, maybe jit. reusable.
+    total = plan.execute(logps)         # sum over ranges
+    per_range = plan.execute(logps, out=np.empty(len(ranges)))
+
+The shared library is looked up via the LSE_LIBRARY environment variable,
+falling back to liblse.so in the repository root (`make liblse.so`).
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+
+STRATEGY_AUTO = 0
+STRATEGY_BASE = 1
+STRATEGY_FAST = 2
+STRATEGY_FASTER = 3
+STRATEGY_BB = 4
+STRATEGY_JIT = 5
+STRATEGY_BASEBB = 6
+
+ACCURACY_RAW = 0
+ACCURACY_TABLE = 1
+ACCURACY_POLY = 2
+
+ACCURACIES = {
+    'raw': ACCURACY_RAW,
+    'table': ACCURACY_TABLE,
+    'poly': ACCURACY_POLY,
+}
+
+STRATEGIES = {
+    'auto': STRATEGY_AUTO,
+    'base': STRATEGY_BASE,
+    'fast': STRATEGY_FAST,
+    'faster': STRATEGY_FASTER,
+    'bb': STRATEGY_BB,
+    'jit': STRATEGY_JIT,
+    'basebb': STRATEGY_BASEBB,
+}
+
+
+class _Options(ctypes.Structure):
+    # mirrors lse_options_t in lse.h
+    _fields_ = [
+        ('strategy', ctypes.c_int),
+        ('dedup', ctypes.c_int),
+        ('jit_max_ranges', ctypes.c_int),
+        ('sliding', ctypes.c_int),
+        ('accuracy', ctypes.c_int),
+        ('tune', ctypes.c_int),
+        ('tune_cache', ctypes.c_char_p),
+        ('tune_logps', ctypes.POINTER(ctypes.c_double)),
+    ]
+
+
+_c_double_p = ctypes.POINTER(ctypes.c_double)
+_c_int_p = ctypes.POINTER(ctypes.c_int)
+
+
+def _default_library_path():
+    here = os.path.dirname(os.path.abspath(__file__))
+    return os.path.join(os.path.dirname(here), 'liblse.so')
+
+
+def _load_library():
+    path = os.environ.get('LSE_LIBRARY', _default_library_path())
+    lib = ctypes.CDLL(path, use_errno=True)
+
+    lib.lse_options_init.argtypes = [ctypes.POINTER(_Options)]
+    lib.lse_options_init.restype = None
+
+    lib.lse_plan_create.argtypes = [_c_int_p, ctypes.c_int, ctypes.POINTER(_Options)]
+    lib.lse_plan_create.restype = ctypes.c_void_p
+
+    lib.lse_plan_execute.argtypes = [ctypes.c_void_p, _c_double_p, _c_double_p]
+    lib.lse_plan_execute.restype = ctypes.c_double
+
+    lib.lse_plan_execute_multi.argtypes = [ctypes.c_void_p, _c_double_p, ctypes.c_int, _c_double_p]
+    lib.lse_plan_execute_multi.restype = ctypes.c_int
+
+    lib.lse_plan_destroy.argtypes = [ctypes.c_void_p]
+    lib.lse_plan_destroy.restype = None
+
+    for name in ('lse_plan_strategy', 'lse_plan_n_ranges', 'lse_plan_n_unique'):
+        f = getattr(lib, name)
+        f.argtypes = [ctypes.c_void_p]
+        f.restype = ctypes.c_int
+
+    return lib
+
+
+_lib = None
+
+
+def _library():
+    global _lib
+    if _lib is None:
+        _lib = _load_library()
+    return _lib
+
+
+def _check_buffer(name, a, dtype, ndim):
+    # refuse rather than silently copy: the point is zero-copy.
+    if not isinstance(a, np.ndarray):
+        raise TypeError('%s: expected numpy.ndarray, got %s' % (name, type(a).__name__))
+    if a.dtype != dtype:
+        raise TypeError('%s: expected dtype %s, got %s' % (name, np.dtype(dtype), a.dtype))
+    if a.ndim != ndim:
+        raise ValueError('%s: expected %d dimensions, got %d' % (name, ndim, a.ndim))
+    if not a.flags['C_CONTIGUOUS']:
+        raise ValueError('%s: expected a C-contiguous array' % (name, ))
+
+
+class Plan(object):
+    """
+    A prepared range pattern. The ranges are copied into the plan once at
+    construction, so the array may be reused or freed afterwards.
+    Execute is safe to call from several threads at once.
+    """
+
+    def __init__(self, ranges, strategy='auto', dedup=True, jit_max_ranges=None, sliding=False,
+            accuracy='raw', tune=False, tune_cache=None, tune_logps=None):
+        """
+        With strategy 'auto' and tune=True the faster, bb and jit strategies
+        are timed on tune_logps (or synthetic data) and the fastest kept.
+        tune_cache names a file that remembers the choice per cpu and
+        pattern. sliding=True evaluates runs of consecutive equal-width
+        ranges as sliding windows; such a pattern is then always planned
+        as bb.
+        """
+        _check_buffer('ranges', ranges, np.int32, 2)
+        if ranges.shape[1] != 2:
+            raise ValueError('ranges: expected shape (n, 2), got %r' % (ranges.shape, ))
+        lib = _library()
+        options = _Options()
+        lib.lse_options_init(ctypes.byref(options))
+        options.strategy = STRATEGIES[strategy]
+        options.dedup = 1 if dedup else 0
+        options.sliding = 1 if sliding else 0
+        options.accuracy = ACCURACIES[accuracy]
+        if jit_max_ranges is not None:
+            options.jit_max_ranges = jit_max_ranges
+        options.tune = 1 if tune else 0
+        if tune_cache is not None:
+            options.tune_cache = os.fsencode(tune_cache)
+        if tune_logps is not None:
+            _check_buffer('tune_logps', tune_logps, np.float64, 1)
+            if ranges.shape[0] > 0 and tune_logps.shape[0] < int((ranges[:, 0] + ranges[:, 1]).max()):
+                raise ValueError('tune_logps: too short for ranges')
+            options.tune_logps = tune_logps.ctypes.data_as(_c_double_p)
+
+        n = ranges.shape[0]
+        self._plan = None
+        self._lib = lib
+        handle = lib.lse_plan_create(ranges.ctypes.data_as(_c_int_p), n, ctypes.byref(options))
+        if not handle:
+            errno = ctypes.get_errno()
+            raise OSError(errno, 'lse_plan_create: %s' % (os.strerror(errno), ))
+        self._plan = handle
+        self.n_ranges = n
+        # every range must lie inside logps: remember the furthest end
+        self._min_length = int((ranges[:, 0] + ranges[:, 1]).max()) if n > 0 else 0
+
+    def __del__(self):
+        if getattr(self, '_plan', None) is not None:
+            self._lib.lse_plan_destroy(self._plan)
+            self._plan = None
+
+    @property
+    def strategy(self):
+        code = self._lib.lse_plan_strategy(self._plan)
+        return [k for k, v in STRATEGIES.items() if v == code][0]
+
+    @property
+    def n_unique(self):
+        return self._lib.lse_plan_n_unique(self._plan)
+
+    def execute(self, logps, out=None):
+        """
+        Returns the sum of the log-sum-exp over all ranges. If out is given
+        (float64, shape (n,)), it is filled with the per-range results and
+        returned instead.
+        """
+        _check_buffer('logps', logps, np.float64, 1)
+        if logps.shape[0] < self._min_length:
+            raise ValueError('logps: ranges reach index %d but logps has length %d' % (
+                self._min_length, logps.shape[0]))
+        out_p = None
+        if out is not None:
+            _check_buffer('out', out, np.float64, 1)
+            if out.shape[0] != self.n_ranges:
+                raise ValueError('out: expected length %d, got %d' % (self.n_ranges, out.shape[0]))
+            out_p = out.ctypes.data_as(_c_double_p)
+        total = self._lib.lse_plan_execute(self._plan, logps.ctypes.data_as(_c_double_p), out_p)
+        return out if out is not None else total
+
+    def execute_multi(self, logps):
+        """
+        Evaluates the plan over the k columns of logps (float64, shape
+        (m, k), C-contiguous) at once. Returns the k totals.
+        """
+        _check_buffer('logps', logps, np.float64, 2)
+        if logps.shape[0] < self._min_length:
+            raise ValueError('logps: ranges reach row %d but logps has %d rows' % (
+                self._min_length, logps.shape[0]))
+        k = logps.shape[1]
+        totals = np.empty(k)
+        status = self._lib.lse_plan_execute_multi(self._plan, logps.ctypes.data_as(_c_double_p), k,
+            totals.ctypes.data_as(_c_double_p))
+        if status != 0:
+            errno = ctypes.get_errno()
+            raise OSError(errno, 'lse_plan_execute_multi: %s' % (os.strerror(errno), ))
+        return totals
+
+
+def log_sum_exp(logps, ranges, strategy='bb', per_range=False):
+    """
+    One-shot convenience wrapper. Prefer Plan when the same ranges are
+    evaluated more than once: planning (and jit) cost is paid per call here.
+    """
+    plan = Plan(ranges, strategy=strategy)
+    if per_range:
+        return plan.execute(logps, out=np.empty(ranges.shape[0], dtype=np.float64))
+    return plan.execute(logps)
@@ -0,0 +1,133 @@
+"""
+approx_tables -- generate the lookup tables and polynomial coefficients
+for the higher accuracy tiers of fast_exp and fast_log.
+
+purpose:
+
+Schraudolph's fast_exp writes x / ln2 straight into the exponent and
+mantissa bits of a double, so a mantissa m stands for 2^m where it
+should be 1 + m. Likewise fast_log reads the bits of x back as e + m
+where it should be e + log2(1 + m). The tiers in fast_approx.h correct
+this, and this script provides their constants:
+
+  table tier: one correction per bucket of the top APPROX_TABLE_BITS
+              mantissa bits, multiplicative for exp, additive for log.
+  poly tier:  a degree 4 polynomial for 2^f on [0, 1), fitted for
+              relative error. the log poly tier uses the atanh series
+              and needs no fitted constants.
+
+python3 scripts/approx_tables.py > approx_tables.h
+"""
+
+import math
+
+
+TABLE_BITS = 8
+SAMPLES_PER_BUCKET = 64
+POLY_DEGREE = 4
+POLY_NODES = 256
+
+
+def bucket_samples(j):
+    n = 1 << TABLE_BITS
+    return [(j + k / float(SAMPLES_PER_BUCKET)) / n for k in range(SAMPLES_PER_BUCKET + 1)]
+
+
+def exp_table():
+    # c_j * (1 + m) ~ 2^m for m in bucket j. the harmonic mean of the
+    # extreme ratios balances the largest relative errors either side.
+    table = []
+    for j in range(1 << TABLE_BITS):
+        r = [2.0 ** m / (1.0 + m) for m in bucket_samples(j)]
+        table.append(2.0 / (1.0 / min(r) + 1.0 / max(r)))
+    return table
+
+
+def log_table():
+    # m * ln2 + d_j ~ log(1 + m) for m in bucket j. the midrange balances
+    # the largest absolute errors either side.
+    table = []
+    for j in range(1 << TABLE_BITS):
+        d = [math.log1p(m) - m * math.log(2.0) for m in bucket_samples(j)]
+        table.append(0.5 * (min(d) + max(d)))
+    return table
+
+
+def solve(a, b):
+    # gaussian elimination with partial pivoting
+    n = len(b)
+    for i in range(n):
+        p = max(range(i, n), key=lambda r: abs(a[r][i]))
+        a[i], a[p] = a[p], a[i]
+        b[i], b[p] = b[p], b[i]
+        for r in range(i + 1, n):
+            f = a[r][i] / a[i][i]
+            for c in range(i, n):
+                a[r][c] -= f * a[i][c]
+            b[r] -= f * b[i]
+    x = [0.0] * n
+    for i in reversed(range(n)):
+        x[i] = (b[i] - sum(a[i][c] * x[c] for c in range(i + 1, n))) / a[i][i]
+    return x
+
+
+def exp2_poly():
+    # weighted least squares for relative error on chebyshev nodes, with
+    # p(0) pinned to 1 so that exp(0) is exact.
+    nodes = [0.5 - 0.5 * math.cos(math.pi * (k + 0.5) / POLY_NODES) for k in range(POLY_NODES)]
+    d = POLY_DEGREE
+    ata = [[0.0] * d for _ in range(d)]
+    atb = [0.0] * d
+    for f in nodes:
+        y = 2.0 ** f
+        row = [f ** (k + 1) / y for k in range(d)]
+        rhs = (y - 1.0) / y
+        for r in range(d):
+            atb[r] += row[r] * rhs
+            for c in range(d):
+                ata[r][c] += row[r] * row[c]
+    return [1.0] + solve(ata, atb)
+
+
+def max_rel_error_exp2(coef):
+    worst = 0.0
+    for k in range(10001):
+        f = k / 10000.0
+        p = 0.0
+        for c in reversed(coef):
+            p = p * f + c
+        worst = max(worst, abs(p / 2.0 ** f - 1.0))
+    return worst
+
+
+def print_table(name, values):
+    print('static const double %s[%d] = {' % (name, len(values)))
+    for i in range(0, len(values), 4):
+        print('    ' + ', '.join('%.17g' % v for v in values[i:i + 4]) + ',')
+    print('};')
+
+
+def main():
+    coef = exp2_poly()
+    print('// generated by scripts/approx_tables.py -- do not edit')
+    print()
+    print('#ifndef _LSEA_APPROX_TABLES')
+    print('#define _LSEA_APPROX_TABLES 1')
+    print()
+    print('#define APPROX_TABLE_BITS %d' % (TABLE_BITS, ))
+    print()
+    print('// 2^f ~ sum_k APPROX_EXP2_Pk f^k on [0, 1). max relative error %.2g' % (max_rel_error_exp2(coef), ))
+    for k, c in enumerate(coef):
+        print('#define APPROX_EXP2_P%d (%.17g)' % (k, c))
+    print()
+    print('// exp: 2^m ~ APPROX_EXP_TABLE[j] * (1 + m) for m in [j, j + 1) / 2^APPROX_TABLE_BITS')
+    print_table('APPROX_EXP_TABLE', exp_table())
+    print()
+    print('// log: log(1 + m) ~ m * ln2 + APPROX_LOG_TABLE[j] for m in [j, j + 1) / 2^APPROX_TABLE_BITS')
+    print_table('APPROX_LOG_TABLE', log_table())
+    print()
+    print('#endif')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,180 @@
+"""
+generate gnu assembler code for the table and poly accuracy tiers of the
+jit. these replace CODE_ACC_FAST_EXP_HEADER, CODE_ACC_FAST_EXP_CYCLE and
+CODE_FAST_LOG in jit_logsumexp.c, and compute bit-identical results to
+fast_exp_table / fast_exp_poly / fast_log_table / fast_log_poly in
+fast_approx.h.
+
+register conventions follow jit_logsumexp.c:
+  xmm0 -- accumulates overall result
+  xmm1 -- per reduction, acc_max
+  xmm2 -- per reduction, acc
+  xmm3 -- a[i] on entry to a cycle
+  r8 -- APPROX_EXP_TABLE, r9 -- APPROX_LOG_TABLE (set once per function)
+  rcx -- scratch for loading constants
+
+the exp headers load constants into registers that the cycles keep;
+everything else from xmm3 up is scratch.
+"""
+
+import math
+import struct
+
+import approx_tables
+
+
+APPROX_LN2 = 0.6931471805599453
+APPROX_S = float(1 << 52)
+APPROX_A = APPROX_S / APPROX_LN2
+APPROX_B = float((1 << 52) * 1023)
+APPROX_A_INV = 1.0 / APPROX_A
+APPROX_LOG2E = 1.4426950408889634
+APPROX_SQRT2 = 1.4142135623730951
+FAST_EXP_MIN_ARG = -706.0
+TWO_POW_52 = float(1 << 52)
+TABLE_SHIFT = 52 - approx_tables.TABLE_BITS
+TABLE_MASK = (1 << approx_tables.TABLE_BITS) - 1
+NEG_INF = float('-inf')
+
+
+def bits(x):
+    return '0x%016x' % (struct.unpack('<Q', struct.pack('<d', x))[0], )
+
+
+def load_constant(x, xmm):
+    print('movabs $%s,%%rcx' % (bits(x), ))
+    print('vmovq %%rcx,%%xmm%d' % (xmm, ))
+
+
+def codegen_exp_header_table():
+    print('vxorpd %xmm2,%xmm2,%xmm2')
+    load_constant(APPROX_A, 4)
+    load_constant(APPROX_B, 5)
+    load_constant(FAST_EXP_MIN_ARG, 6)
+
+
+def codegen_exp_cycle_table():
+    print('vsubsd %xmm1,%xmm3,%xmm3')          # x = a[i] - acc_max
+    print('vmovapd %xmm4,%xmm7')
+    print('vfmadd213sd %xmm5,%xmm3,%xmm7')     # a * x + b
+    print('vcmplesd %xmm3,%xmm6,%xmm3')        # x >= min_arg
+    print('vcvttsd2si %xmm7,%rcx')
+    print('mov %rcx,%rax')
+    print('shr $%d,%%rax' % (TABLE_SHIFT, ))
+    print('and $%d,%%eax' % (TABLE_MASK, ))
+    print('vmovq %rcx,%xmm7')
+    print('vmulsd (%r8,%rax,8),%xmm7,%xmm7')
+    print('vandpd %xmm7,%xmm3,%xmm3')
+    print('vaddsd %xmm3,%xmm2,%xmm2')
+
+
+def codegen_log_table():
+    print('vxorpd %xmm7,%xmm7,%xmm7')
+    load_constant(NEG_INF, 4)
+    load_constant(APPROX_A_INV, 5)
+    load_constant(-APPROX_A_INV * APPROX_B, 6)
+    print('vmovq %xmm2,%rax')
+    print('vcvtsi2sd %rax,%xmm7,%xmm3')
+    print('vfmadd213sd %xmm6,%xmm5,%xmm3')
+    print('shr $%d,%%rax' % (TABLE_SHIFT, ))
+    print('and $%d,%%eax' % (TABLE_MASK, ))
+    print('vaddsd (%r9,%rax,8),%xmm3,%xmm3')
+    codegen_log_footer()
+
+
+def codegen_log_footer():
+    # xmm3 = log(acc), xmm7 = 0, xmm4 = -inf
+    print('vcmpltsd %xmm2,%xmm7,%xmm2')        # acc > 0
+    print('vblendvpd %xmm2,%xmm3,%xmm4,%xmm2')
+    print('vaddsd %xmm2,%xmm1,%xmm2')          # fast_log(acc) + acc_max
+    print('vaddsd %xmm2,%xmm0,%xmm0')          # result += ...
+
+
+def codegen_exp_header_poly():
+    p = approx_tables.exp2_poly()
+    print('vxorpd %xmm2,%xmm2,%xmm2')
+    load_constant(APPROX_LOG2E, 4)
+    load_constant(FAST_EXP_MIN_ARG, 5)
+    load_constant(p[4], 6)
+    load_constant(p[3], 8)
+    load_constant(p[2], 9)
+    load_constant(p[1], 10)
+    load_constant(p[0], 11)
+    load_constant(TWO_POW_52 + 1023.0, 12)
+
+
+def codegen_exp_cycle_poly():
+    print('vsubsd %xmm1,%xmm3,%xmm3')          # x = a[i] - acc_max
+    print('vmaxsd %xmm5,%xmm3,%xmm7')          # max(x, min_arg)
+    print('vmulsd %xmm4,%xmm7,%xmm7')          # t
+    print('vroundsd $9,%xmm7,%xmm7,%xmm13')    # n = floor(t)
+    print('vsubsd %xmm13,%xmm7,%xmm7')         # f = t - n
+    print('vmovapd %xmm6,%xmm14')
+    print('vfmadd213sd %xmm8,%xmm7,%xmm14')
+    print('vfmadd213sd %xmm9,%xmm7,%xmm14')
+    print('vfmadd213sd %xmm10,%xmm7,%xmm14')
+    print('vfmadd213sd %xmm11,%xmm7,%xmm14')   # p = 2^f
+    print('vaddsd %xmm12,%xmm13,%xmm13')
+    print('vpsllq $52,%xmm13,%xmm13')          # 2^n
+    print('vmulsd %xmm13,%xmm14,%xmm14')
+    print('vcmplesd %xmm3,%xmm5,%xmm3')        # x >= min_arg
+    print('vandpd %xmm14,%xmm3,%xmm3')
+    print('vaddsd %xmm3,%xmm2,%xmm2')
+
+
+def codegen_log_poly():
+    print('vxorpd %xmm7,%xmm7,%xmm7')
+    load_constant(NEG_INF, 4)
+    print('vmovq %xmm2,%rax')
+    print('mov %rax,%r10')
+    print('shr $52,%r10')
+    print('sub $1023,%r10')                    # e
+    print('movabs $0x000fffffffffffff,%rdx')
+    print('and %rdx,%rax')
+    print('movabs $%s,%%rdx' % (bits(1.0), ))
+    print('or %rdx,%rax')
+    print('vmovq %rax,%xmm3')                  # y in [1, 2)
+    load_constant(APPROX_SQRT2, 5)
+    print('vcmpltsd %xmm3,%xmm5,%xmm5')        # y > sqrt2
+    load_constant(0.5, 6)
+    print('vmulsd %xmm6,%xmm3,%xmm6')
+    print('vblendvpd %xmm5,%xmm6,%xmm3,%xmm3')
+    print('vmovq %xmm5,%rdx')
+    print('and $1,%edx')
+    print('add %rdx,%r10')
+    print('vcvtsi2sd %r10,%xmm7,%xmm5')        # e as double
+    load_constant(1.0, 6)
+    print('vsubsd %xmm6,%xmm3,%xmm13')
+    print('vaddsd %xmm6,%xmm3,%xmm3')
+    print('vdivsd %xmm3,%xmm13,%xmm13')        # s
+    print('vmulsd %xmm13,%xmm13,%xmm14')       # s^2
+    load_constant(2.0 / 7.0, 3)
+    load_constant(2.0 / 5.0, 6)
+    print('vfmadd213sd %xmm6,%xmm14,%xmm3')
+    load_constant(2.0 / 3.0, 6)
+    print('vfmadd213sd %xmm6,%xmm14,%xmm3')
+    load_constant(2.0, 6)
+    print('vfmadd213sd %xmm6,%xmm14,%xmm3')
+    print('vmulsd %xmm13,%xmm3,%xmm3')
+    load_constant(APPROX_LN2, 6)
+    print('vfmadd231sd %xmm6,%xmm5,%xmm3')     # e * ln2 + p
+    codegen_log_footer()
+
+
+def main():
+    sections = [
+        ('CODE_ACC_FAST_EXP_HEADER_TABLE', codegen_exp_header_table),
+        ('CODE_ACC_FAST_EXP_CYCLE_TABLE', codegen_exp_cycle_table),
+        ('CODE_FAST_LOG_TABLE', codegen_log_table),
+        ('CODE_ACC_FAST_EXP_HEADER_POLY', codegen_exp_header_poly),
+        ('CODE_ACC_FAST_EXP_CYCLE_POLY', codegen_exp_cycle_poly),
+        ('CODE_FAST_LOG_POLY', codegen_log_poly),
+    ]
+    for name, codegen in sections:
+        print('.section %s' % (name, ))
+        codegen()
+        print()
+
+
+if __name__ == '__main__':
+    main()
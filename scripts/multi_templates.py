@@ -0,0 +1,188 @@
+"""
+generate gnu assembler code for the multi-vector jit. each range is
+evaluated over 4 data vectors at once, one per lane of a ymm register,
+and the results are bit-identical to fast_exp_raw_pd / fast_log_raw_pd in
+simd_approx.h.
+
+the data vectors are interleaved: element i of vector v is at
+logps[i * k + v]. the generated function is called once per group of 4
+vectors, with rdi pointing at the group's first lane.
+
+register conventions:
+  rdi -- pointer to the current range, group lane 0
+  rsi -- pointer to the group's 4 totals
+  ymm0 -- accumulates the 4 totals
+  ymm1 -- per reduction, max then shift
+  ymm2 -- per reduction, acc
+  ymm3 -- a[i] on entry to a cycle
+  ymm4 -- APPROX_A, ymm5 -- APPROX_B - APPROX_C, ymm6 -- FAST_EXP_MIN_ARG
+  ymm8 -- -inf, ymm9 -- 0.0, ymm10 -- 2^-32, ymm13 -- 2^32
+  ymm14 -- 2^52, ymm15 -- 0xffffffff in each lane
+  rcx -- scratch for loading constants
+everything else is scratch.
+
+loads of a[i] carry a 32 bit displacement i * k * sizeof(double), which
+depends on k and is patched in by jit_logsumexp.c: it is always the last
+4 bytes of the instruction.
+
+the exp cycle and the log are emitted once per function, as subroutines
+after the final ret, and called per element and per range. inlining them
+made the code of a few thousand ranges outgrow the instruction cache.
+"""
+
+import struct
+
+
+APPROX_LN2 = 0.6931471805599453
+APPROX_S = float(1 << 52)
+APPROX_A = APPROX_S / APPROX_LN2
+# APPROX_B and APPROX_C are integers in fast_approx.h: combine them
+# before rounding to double, as C does.
+APPROX_B_INT = (1 << 52) * 1023
+APPROX_C_INT = 60801 * (1 << 32)
+APPROX_A_INV = 1.0 / APPROX_A
+FAST_EXP_MIN_ARG = -706.0
+TWO_POW_32 = float(1 << 32)
+TWO_POW_M32 = 1.0 / TWO_POW_32
+TWO_POW_52 = float(1 << 52)
+NEG_INF = float('-inf')
+
+# placeholder that forces a 32 bit displacement
+DISP32 = '0x7ffffff8'
+
+CMP_EQ_OQ = 0x00
+CMP_GE_OQ = 0x1d
+CMP_GT_OQ = 0x1e
+ROUND_FLOOR = 0x01
+
+
+def bits(x):
+    return '0x%016x' % (struct.unpack('<Q', struct.pack('<d', x))[0], )
+
+
+def broadcast_bits(b, ymm):
+    print('movabs $%s,%%rcx' % (b, ))
+    print('vmovq %%rcx,%%xmm%d' % (ymm, ))
+    print('vbroadcastsd %%xmm%d,%%ymm%d' % (ymm, ymm))
+
+
+def broadcast_constant(x, ymm):
+    broadcast_bits(bits(x), ymm)
+
+
+def codegen_header():
+    print('vxorpd %ymm0,%ymm0,%ymm0')
+    broadcast_constant(APPROX_A, 4)
+    broadcast_constant(float(APPROX_B_INT - APPROX_C_INT), 5)
+    broadcast_constant(FAST_EXP_MIN_ARG, 6)
+    broadcast_constant(NEG_INF, 8)
+    print('vxorpd %ymm9,%ymm9,%ymm9')
+    broadcast_constant(TWO_POW_M32, 10)
+    broadcast_constant(TWO_POW_32, 13)
+    broadcast_constant(TWO_POW_52, 14)
+    broadcast_bits('0x00000000ffffffff', 15)
+
+
+def codegen_load_a_ymm1():
+    print('vmovupd %s(%%rdi),%%ymm1' % (DISP32, ))
+
+
+def codegen_max_a_ymm1():
+    print('vmaxpd %s(%%rdi),%%ymm1,%%ymm1' % (DISP32, ))
+
+
+def codegen_load_a_ymm3():
+    print('vmovupd %s(%%rdi),%%ymm3' % (DISP32, ))
+
+
+def codegen_singleton():
+    # width 1: the lse is a[0], already in ymm1
+    print('vaddpd %ymm1,%ymm0,%ymm0')
+
+
+def codegen_shift():
+    # lanes whose terms are all -inf: shift by 0 so exp gives 0, not nan
+    print('vcmppd $0x%02x,%%ymm8,%%ymm1,%%ymm3' % (CMP_EQ_OQ, ))
+    print('vandnpd %ymm1,%ymm3,%ymm1')
+    print('vxorpd %ymm2,%ymm2,%ymm2')
+
+
+def codegen_exp_cycle():
+    print('vsubpd %ymm1,%ymm3,%ymm3')          # x = a[i] - shift
+    print('vmovapd %ymm5,%ymm7')
+    print('vfmadd231pd %ymm4,%ymm3,%ymm7')     # y = a * x + (b - c)
+    print('vmaxpd %ymm9,%ymm7,%ymm7')          # negative or nan y -> 0
+    # truncate y to int64 through exact 32 bit halves
+    print('vmulpd %ymm10,%ymm7,%ymm11')
+    print('vroundpd $0x%02x,%%ymm11,%%ymm11' % (ROUND_FLOOR, ))   # y_hi
+    print('vmovapd %ymm7,%ymm12')
+    print('vfnmadd231pd %ymm13,%ymm11,%ymm12')  # y - y_hi * 2^32
+    print('vroundpd $0x%02x,%%ymm12,%%ymm12' % (ROUND_FLOOR, ))   # y_lo
+    print('vaddpd %ymm14,%ymm11,%ymm11')
+    print('vpsllq $32,%ymm11,%ymm11')
+    print('vaddpd %ymm14,%ymm12,%ymm12')
+    print('vpand %ymm15,%ymm12,%ymm12')
+    print('vpor %ymm12,%ymm11,%ymm7')
+    print('vcmppd $0x%02x,%%ymm6,%%ymm3,%%ymm3' % (CMP_GE_OQ, ))  # x >= min_arg
+    print('vandpd %ymm7,%ymm3,%ymm3')
+    print('vaddpd %ymm3,%ymm2,%ymm2')          # acc += fast_exp(x)
+    print('ret')
+
+
+def codegen_log():
+    # convert the bits of acc to double through exact 32 bit halves
+    print('vpsrlq $32,%ymm2,%ymm11')
+    print('vpor %ymm14,%ymm11,%ymm11')
+    print('vsubpd %ymm14,%ymm11,%ymm11')       # hi
+    print('vpand %ymm15,%ymm2,%ymm12')
+    print('vpor %ymm14,%ymm12,%ymm12')
+    print('vsubpd %ymm14,%ymm12,%ymm12')       # lo
+    print('vfmadd132pd %ymm13,%ymm12,%ymm11')  # hi * 2^32 + lo
+    broadcast_constant(APPROX_A_INV, 3)
+    broadcast_constant(APPROX_A_INV * float(- APPROX_B_INT + APPROX_C_INT), 7)
+    print('vfmadd132pd %ymm3,%ymm7,%ymm11')
+    print('vcmppd $0x%02x,%%ymm9,%%ymm2,%%ymm12' % (CMP_GT_OQ, ))  # acc > 0
+    print('vblendvpd %ymm12,%ymm11,%ymm8,%ymm2')
+    print('vaddpd %ymm1,%ymm2,%ymm2')          # fast_log(acc) + shift
+    print('vaddpd %ymm2,%ymm0,%ymm0')
+    print('ret')
+
+
+def codegen_footer():
+    print('vmovupd %ymm0,(%rsi)')
+    print('vzeroupper')
+    print('ret')
+
+
+def main():
+    print('.section CODE_MULTI_HEADER')
+    codegen_header()
+    print()
+    print('.section CODE_MULTI_LOAD_A_YMM1')
+    codegen_load_a_ymm1()
+    print()
+    print('.section CODE_MULTI_MAX_A_YMM1')
+    codegen_max_a_ymm1()
+    print()
+    print('.section CODE_MULTI_LOAD_A_YMM3')
+    codegen_load_a_ymm3()
+    print()
+    print('.section CODE_MULTI_SINGLETON')
+    codegen_singleton()
+    print()
+    print('.section CODE_MULTI_SHIFT')
+    codegen_shift()
+    print()
+    print('.section CODE_MULTI_EXP_CYCLE')
+    codegen_exp_cycle()
+    print()
+    print('.section CODE_MULTI_LOG')
+    codegen_log()
+    print()
+    print('.section CODE_MULTI_FOOTER')
+    codegen_footer()
+    print()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,72 @@
+"""
+generate gnu assembler code for the fused log-sum-exp / softmax jit.
+
+register conventions follow jit_logsumexp.c:
+  rdi -- pointer to the current range in logps
+  rsi -- pointer to the current range in the softmax output
+  xmm2 -- per reduction, accumulates acc
+  xmm3 -- fast_exp(a[i] - acc_max) after CODE_ACC_FAST_EXP_CYCLE
+  xmm13 -- per reduction, 1 / acc
+  xmm14 -- scratch
+"""
+
+SIZEOF_DOUBLE = 8
+MAX_WIDTH = 10
+
+ONE = '0x3ff0000000000000'
+NEG_INF = '0xfff0000000000000'
+# 1/acc must stay finite when every term underflowed and acc == 0.
+TINY_ACC = '0x01a56e1fc2f8f359' # 1e-300
+
+
+def codegen_store_e(i):
+    # out[i] = xmm3
+    print('vmovsd %%xmm3,0x%02x(%%rsi)' % (SIZEOF_DOUBLE * i, ))
+
+
+def codegen_scale_out(i):
+    # out[i] *= 1 / acc
+    print('vmulsd 0x%02x(%%rsi),%%xmm13,%%xmm14' % (SIZEOF_DOUBLE * i, ))
+    print('vmovsd %%xmm14,0x%02x(%%rsi)' % (SIZEOF_DOUBLE * i, ))
+
+
+def codegen_inv_acc():
+    # xmm13 = 1 / max(acc, tiny)
+    print('movabs $%s,%%rcx' % (ONE, ))
+    print('vmovq %rcx,%xmm13')
+    print('movabs $%s,%%rcx' % (TINY_ACC, ))
+    print('vmovq %rcx,%xmm14')
+    print('vmaxsd %xmm14,%xmm2,%xmm14')
+    print('vdivsd %xmm14,%xmm13,%xmm13')
+
+
+def codegen_singleton():
+    # width 1: weight is 1 unless a[0] is -inf. assumes xmm3 = a[0].
+    print('movabs $%s,%%rcx' % (ONE, ))
+    print('vmovq %rcx,%xmm4')
+    print('movabs $%s,%%rcx' % (NEG_INF, ))
+    print('vmovq %rcx,%xmm5')
+    print('vcmpltsd %xmm3,%xmm5,%xmm5')
+    print('vandpd %xmm4,%xmm5,%xmm5')
+    print('vmovsd %xmm5,(%rsi)')
+
+
+def main():
+    for i in range(MAX_WIDTH):
+        print('.section CODE_STORE_E_%d' % (i, ))
+        codegen_store_e(i)
+        print()
+    for i in range(MAX_WIDTH):
+        print('.section CODE_SCALE_OUT_%d' % (i, ))
+        codegen_scale_out(i)
+        print()
+    print('.section CODE_INV_ACC')
+    codegen_inv_acc()
+    print()
+    print('.section CODE_SOFTMAX_SINGLETON')
+    codegen_singleton()
+    print()
+
+
+if __name__ == '__main__':
+    main()
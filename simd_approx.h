@@ -0,0 +1,260 @@
+#ifndef _LSEA_SIMD_APPROX
+#define _LSEA_SIMD_APPROX 1
+
+// 4-wide AVX2 versions of fast_exp and fast_log from fast_approx.h, for
+// every accuracy tier. results are bit-identical to the scalar versions.
+//
+// LSEA_HAVE_SIMD is defined when the target supports AVX2 and FMA; callers
+// should keep a scalar path for when it is not.
+//
+// exact_exp_pd and exact_log_pd are 4-wide glibc precision exp and log.
+// with glibc they call libmvec (LSEA_HAVE_LIBMVEC, off with
+// -DLSEA_NO_LIBMVEC); otherwise they call exp and log lane by lane.
+
+#include "fast_approx.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#define LSEA_HAVE_SIMD 1
+
+#include <immintrin.h>
+
+
+#define SIMD_TWO_POW_32 (4294967296.0)
+#define SIMD_TWO_POW_52 (4503599627370496.0)
+#define SIMD_TWO_POW_M32 (1.0 / SIMD_TWO_POW_32)
+
+
+static inline __m256i simd_truncate_pd_epi64(__m256d y) {
+    // precondition: 0 <= y < 2^63
+#if defined(__AVX512DQ__) && defined(__AVX512VL__)
+    return _mm256_cvttpd_epi64(y);
+#else
+    // AVX2 has no double -> int64 conversion. split y into high and low
+    // 32 bit halves; both splits are exact, so this matches (long int)y.
+    __m256d magic, y_hi, y_lo;
+    __m256i hi, lo;
+    magic = _mm256_set1_pd(SIMD_TWO_POW_52);
+    y_hi = _mm256_floor_pd(_mm256_mul_pd(y, _mm256_set1_pd(SIMD_TWO_POW_M32)));
+    y_lo = _mm256_fnmadd_pd(y_hi, _mm256_set1_pd(SIMD_TWO_POW_32), y);
+    y_lo = _mm256_floor_pd(y_lo);
+    // adding 2^52 lands an integer < 2^32 in the low mantissa bits
+    hi = _mm256_castpd_si256(_mm256_add_pd(y_hi, magic));
+    lo = _mm256_castpd_si256(_mm256_add_pd(y_lo, magic));
+    hi = _mm256_slli_epi64(hi, 32);
+    lo = _mm256_and_si256(lo, _mm256_set1_epi64x(0xffffffffl));
+    return _mm256_or_si256(hi, lo);
+#endif
+}
+
+
+static inline __m256d simd_convert_epi64_pd(__m256i x) {
+    // precondition: 0 <= x < 2^63
+#if defined(__AVX512DQ__) && defined(__AVX512VL__)
+    return _mm256_cvtepi64_pd(x);
+#else
+    // rebuild from exact 32 bit halves, rounding once in the final fma
+    __m256i magic_bits;
+    __m256d magic, hi, lo;
+    magic = _mm256_set1_pd(SIMD_TWO_POW_52);
+    magic_bits = _mm256_castpd_si256(magic);
+    hi = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(x, 32), magic_bits));
+    lo = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_and_si256(x, _mm256_set1_epi64x(0xffffffffl)), magic_bits));
+    hi = _mm256_sub_pd(hi, magic);
+    lo = _mm256_sub_pd(lo, magic);
+    return _mm256_fmadd_pd(hi, _mm256_set1_pd(SIMD_TWO_POW_32), lo);
+#endif
+}
+
+
+static inline __m256d fast_exp_raw_pd(__m256d x) {
+    __m256d y, z, ok;
+    y = _mm256_fmadd_pd(_mm256_set1_pd(APPROX_A), x, _mm256_set1_pd(APPROX_B - APPROX_C));
+    // y is negative or nan for x < FAST_EXP_MIN_ARG; those lanes are masked
+    y = _mm256_max_pd(y, _mm256_setzero_pd());
+    z = _mm256_castsi256_pd(simd_truncate_pd_epi64(y));
+    ok = _mm256_cmp_pd(x, _mm256_set1_pd(FAST_EXP_MIN_ARG), _CMP_GE_OQ);
+    return _mm256_and_pd(z, ok);
+}
+
+
+static inline __m256i simd_table_index(__m256i i) {
+    // top APPROX_TABLE_BITS mantissa bits
+    return _mm256_and_si256(_mm256_srli_epi64(i, APPROX_MANTISSA_BITS - APPROX_TABLE_BITS),
+        _mm256_set1_epi64x(APPROX_TABLE_MASK));
+}
+
+
+static inline __m256d fast_exp_table_pd(__m256d x) {
+    __m256d y, z, ok;
+    __m256i i;
+    y = _mm256_fmadd_pd(_mm256_set1_pd(APPROX_A), x, _mm256_set1_pd(APPROX_B));
+    y = _mm256_max_pd(y, _mm256_setzero_pd());
+    i = simd_truncate_pd_epi64(y);
+    z = _mm256_mul_pd(_mm256_castsi256_pd(i), _mm256_i64gather_pd(APPROX_EXP_TABLE, simd_table_index(i), 8));
+    ok = _mm256_cmp_pd(x, _mm256_set1_pd(FAST_EXP_MIN_ARG), _CMP_GE_OQ);
+    return _mm256_and_pd(z, ok);
+}
+
+
+static inline __m256d fast_exp_poly_pd(__m256d x) {
+    __m256d t, n, f, p, scale, ok;
+    // max(x, min) picks min for nan x, as fmax does
+    t = _mm256_mul_pd(_mm256_max_pd(x, _mm256_set1_pd(FAST_EXP_MIN_ARG)), _mm256_set1_pd(APPROX_LOG2E));
+    n = _mm256_floor_pd(t);
+    f = _mm256_sub_pd(t, n);
+    p = _mm256_fmadd_pd(_mm256_set1_pd(APPROX_EXP2_P4), f, _mm256_set1_pd(APPROX_EXP2_P3));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(APPROX_EXP2_P2));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(APPROX_EXP2_P1));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(APPROX_EXP2_P0));
+    // n + 1023 lands in the low mantissa bits after adding 2^52
+    scale = _mm256_add_pd(n, _mm256_set1_pd(SIMD_TWO_POW_52 + 1023.0));
+    scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(scale), APPROX_MANTISSA_BITS));
+    ok = _mm256_cmp_pd(x, _mm256_set1_pd(FAST_EXP_MIN_ARG), _CMP_GE_OQ);
+    return _mm256_and_pd(_mm256_mul_pd(p, scale), ok);
+}
+
+
+static inline __m256d fast_log_raw_pd(__m256d x) {
+    // precondition: x >= 0.0
+    __m256d z, ok;
+    z = simd_convert_epi64_pd(_mm256_castpd_si256(x));
+    z = _mm256_fmadd_pd(_mm256_set1_pd(APPROX_A_INV), z,
+        _mm256_set1_pd(APPROX_A_INV * (- APPROX_B + APPROX_C)));
+    ok = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return _mm256_blendv_pd(_mm256_set1_pd(-INFINITY), z, ok);
+}
+
+
+static inline __m256d fast_log_table_pd(__m256d x) {
+    // precondition: x >= 0.0
+    __m256d z, ok;
+    __m256i i;
+    i = _mm256_castpd_si256(x);
+    z = _mm256_fmadd_pd(_mm256_set1_pd(APPROX_A_INV), simd_convert_epi64_pd(i),
+        _mm256_set1_pd(- APPROX_A_INV * APPROX_B));
+    z = _mm256_add_pd(z, _mm256_i64gather_pd(APPROX_LOG_TABLE, simd_table_index(i), 8));
+    ok = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return _mm256_blendv_pd(_mm256_set1_pd(-INFINITY), z, ok);
+}
+
+
+static inline __m256d fast_log_poly_pd(__m256d x) {
+    // precondition: x >= 0.0
+    __m256d magic, e, y, big, one, s, s2, p, z, ok;
+    __m256i i;
+    i = _mm256_castpd_si256(x);
+    magic = _mm256_set1_pd(SIMD_TWO_POW_52);
+    // biased exponent < 2^11: exact through the 2^52 trick
+    e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(i, APPROX_MANTISSA_BITS), _mm256_castpd_si256(magic)));
+    e = _mm256_sub_pd(e, _mm256_set1_pd(SIMD_TWO_POW_52 + 1023.0));
+    one = _mm256_set1_pd(1.0);
+    y = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_and_si256(i, _mm256_set1_epi64x((1l << APPROX_MANTISSA_BITS) - 1)), _mm256_castpd_si256(one)));
+    big = _mm256_cmp_pd(y, _mm256_set1_pd(APPROX_SQRT2), _CMP_GT_OQ);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+    y = _mm256_blendv_pd(y, _mm256_mul_pd(y, _mm256_set1_pd(0.5)), big);
+    s = _mm256_div_pd(_mm256_sub_pd(y, one), _mm256_add_pd(y, one));
+    s2 = _mm256_mul_pd(s, s);
+    p = _mm256_fmadd_pd(_mm256_set1_pd(2.0 / 7.0), s2, _mm256_set1_pd(2.0 / 5.0));
+    p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(2.0 / 3.0));
+    p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(2.0));
+    p = _mm256_mul_pd(p, s);
+    z = _mm256_fmadd_pd(e, _mm256_set1_pd(APPROX_LN2), p);
+    ok = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return _mm256_blendv_pd(_mm256_set1_pd(-INFINITY), z, ok);
+}
+
+
+static inline __m256d fast_exp_pd(__m256d x) {
+#if APPROX_TIER == APPROX_TIER_TABLE
+    return fast_exp_table_pd(x);
+#elif APPROX_TIER == APPROX_TIER_POLY
+    return fast_exp_poly_pd(x);
+#else
+    return fast_exp_raw_pd(x);
+#endif
+}
+
+
+static inline __m256d fast_log_pd(__m256d x) {
+#if APPROX_TIER == APPROX_TIER_TABLE
+    return fast_log_table_pd(x);
+#elif APPROX_TIER == APPROX_TIER_POLY
+    return fast_log_poly_pd(x);
+#else
+    return fast_log_raw_pd(x);
+#endif
+}
+
+
+static inline __m256d fast_exp_tier_pd(__m256d x, int tier) {
+    return (tier == APPROX_TIER_POLY) ? fast_exp_poly_pd(x) :
+        (tier == APPROX_TIER_TABLE) ? fast_exp_table_pd(x) : fast_exp_raw_pd(x);
+}
+
+
+static inline __m256d fast_log_tier_pd(__m256d x, int tier) {
+    return (tier == APPROX_TIER_POLY) ? fast_log_poly_pd(x) :
+        (tier == APPROX_TIER_TABLE) ? fast_log_table_pd(x) : fast_log_raw_pd(x);
+}
+
+
+#if defined(__GLIBC__) && !defined(LSEA_NO_LIBMVEC)
+
+#define LSEA_HAVE_LIBMVEC 1
+
+// libmvec AVX2 variants of exp and log, max error 4 ulp. math.h only
+// declares them under -ffast-math, and libm.so links libmvec as needed.
+__m256d _ZGVdN4v_exp(__m256d x);
+__m256d _ZGVdN4v_log(__m256d x);
+
+
+static inline __m256d exact_exp_pd(__m256d x) {
+    return _ZGVdN4v_exp(x);
+}
+
+
+static inline __m256d exact_log_pd(__m256d x) {
+    return _ZGVdN4v_log(x);
+}
+
+#else
+
+static inline __m256d exact_exp_pd(__m256d x) {
+    double t[4];
+    _mm256_storeu_pd(t, x);
+    return _mm256_set_pd(exp(t[3]), exp(t[2]), exp(t[1]), exp(t[0]));
+}
+
+
+static inline __m256d exact_log_pd(__m256d x) {
+    double t[4];
+    _mm256_storeu_pd(t, x);
+    return _mm256_set_pd(log(t[3]), log(t[2]), log(t[1]), log(t[0]));
+}
+
+#endif
+
+
+static inline double simd_hsum_pd(__m256d x) {
+    __m128d lo, hi;
+    lo = _mm256_castpd256_pd128(x);
+    hi = _mm256_extractf128_pd(x, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+
+static inline double simd_hmax_pd(__m256d x) {
+    __m128d lo, hi;
+    lo = _mm256_castpd256_pd128(x);
+    hi = _mm256_extractf128_pd(x, 1);
+    lo = _mm_max_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_max_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+#endif
+
+#endif
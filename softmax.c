@@ -0,0 +1,203 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "types.h"
+#include "fast_approx.h"
+#include "simd_approx.h"
+#include "softmax.h"
+#include "lse_instrument.h"
+
+
+static inline double faster_log_sum_exp_softmax_n(const double *a, int n, int kind, double *out) {
+    // preconditions:
+    // -inf <= a[i] <= 0.0 for all i = 0, ..., n-1
+    //
+    // called with constant n and kind from the bb kernel, so each call
+    // site specialises like faster_log_sum_exp_N.
+    double a_max, acc, e, lse, inv;
+    int i;
+    a_max = -INFINITY;
+    for (i = 0; i < n; ++i) {
+        a_max = fmax(a[i], a_max);
+    }
+    if (a_max <= -INFINITY) {
+        // empty distribution: no weight anywhere
+        for (i = 0; i < n; ++i) {
+            out[i] = (kind == SOFTMAX_WEIGHTS) ? 0.0 : -INFINITY;
+        }
+        return a_max;
+    }
+    if (n <= 1) {
+        out[0] = (kind == SOFTMAX_WEIGHTS) ? 1.0 : 0.0;
+        return a_max;
+    }
+    acc = 0.0;
+    for (i = 0; i < n; ++i) {
+        e = fast_exp(a[i] - a_max);
+        acc += e;
+        if (kind == SOFTMAX_WEIGHTS) {
+            out[i] = e;
+        }
+    }
+    lse = fast_log(acc) + a_max;
+    if (kind == SOFTMAX_WEIGHTS) {
+        // normalise by acc itself rather than exp(lse - a_max), so the
+        // weights sum to 1 regardless of fast_log error
+        inv = 1.0 / acc;
+        for (i = 0; i < n; ++i) {
+            out[i] *= inv;
+        }
+    } else {
+        for (i = 0; i < n; ++i) {
+            out[i] = a[i] - lse;
+        }
+    }
+    return lse;
+}
+
+
+static inline double softmax_bb(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        int kind, double *out, double *lse_out) {
+    const int *b = buckets->start;
+    double acc = 0.0, lse;
+    int i, w;
+
+    // width 0 ranges have no outputs
+    for (i = b[0]; i < b[1]; ++i) {
+        acc += -INFINITY;
+        if (lse_out != NULL) {
+            lse_out[i] = -INFINITY;
+        }
+    }
+
+#define SOFTMAX_BB_BUCKET(N) \
+    for (i = b[N]; i < b[N + 1]; ++i) { \
+        lse = faster_log_sum_exp_softmax_n(&(logps[ranges[i].offset]), N, kind, out); \
+        out += N; \
+        acc += lse; \
+        if (lse_out != NULL) { \
+            lse_out[i] = lse; \
+        } \
+    }
+
+    SOFTMAX_BB_BUCKET(1)
+    SOFTMAX_BB_BUCKET(2)
+    SOFTMAX_BB_BUCKET(3)
+    SOFTMAX_BB_BUCKET(4)
+    SOFTMAX_BB_BUCKET(5)
+    SOFTMAX_BB_BUCKET(6)
+    SOFTMAX_BB_BUCKET(7)
+    SOFTMAX_BB_BUCKET(8)
+    SOFTMAX_BB_BUCKET(9)
+    SOFTMAX_BB_BUCKET(10)
+
+#undef SOFTMAX_BB_BUCKET
+
+    // wider ranges: same code, unspecialised
+    for (i = b[MAX_BB_WIDTH + 1]; i < b[MAX_BB_WIDTH + 2]; ++i) {
+        w = ranges[i].width;
+        lse = faster_log_sum_exp_softmax_n(&(logps[ranges[i].offset]), w, kind, out);
+        out += w;
+        acc += lse;
+        if (lse_out != NULL) {
+            lse_out[i] = lse;
+        }
+    }
+    return acc;
+}
+
+
+double faster_log_sum_exp_softmax_bb(range_t *ranges, const range_buckets_t *buckets, double *logps,
+        int kind, double *out, double *lse_out) {
+    // hoist kind out of the loops
+    double total;
+    LSE_INSTRUMENT_START(t0);
+    if (kind == SOFTMAX_WEIGHTS) {
+        total = softmax_bb(ranges, buckets, logps, SOFTMAX_WEIGHTS, out, lse_out);
+    } else {
+        total = softmax_bb(ranges, buckets, logps, SOFTMAX_LOG_PROBS, out, lse_out);
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_SOFTMAX_BB, t0);
+    return total;
+}
+
+
+#ifdef LSEA_HAVE_SIMD
+
+static inline double softmax_simd_12(const double *a, int n, int kind, double *out) {
+    // ranges of up to 12 elements: the values and their exps stay in three
+    // registers from load to store.
+    // preconditions: 2 <= n <= 12
+    __m256i lane, m0, m1, m2;
+    __m256d ninf, x0, x1, x2, v_max, e0, e1, e2, v;
+    double a_max, acc, lse;
+
+    lane = _mm256_set_epi64x(3, 2, 1, 0);
+    m0 = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), lane);
+    m1 = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - 4), lane);
+    m2 = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - 8), lane);
+    ninf = _mm256_set1_pd(-INFINITY);
+
+    // masked lanes load as 0.0; make them -inf so they drop out of max and sum
+    x0 = _mm256_blendv_pd(ninf, _mm256_maskload_pd(a, m0), _mm256_castsi256_pd(m0));
+    x1 = _mm256_blendv_pd(ninf, _mm256_maskload_pd(a + 4, m1), _mm256_castsi256_pd(m1));
+    x2 = _mm256_blendv_pd(ninf, _mm256_maskload_pd(a + 8, m2), _mm256_castsi256_pd(m2));
+
+    a_max = simd_hmax_pd(_mm256_max_pd(_mm256_max_pd(x0, x1), x2));
+    if (a_max <= -INFINITY) {
+        v = (kind == SOFTMAX_WEIGHTS) ? _mm256_setzero_pd() : ninf;
+        _mm256_maskstore_pd(out, m0, v);
+        _mm256_maskstore_pd(out + 4, m1, v);
+        _mm256_maskstore_pd(out + 8, m2, v);
+        return a_max;
+    }
+
+    v_max = _mm256_set1_pd(a_max);
+    e0 = fast_exp_pd(_mm256_sub_pd(x0, v_max));
+    e1 = fast_exp_pd(_mm256_sub_pd(x1, v_max));
+    e2 = fast_exp_pd(_mm256_sub_pd(x2, v_max));
+    acc = simd_hsum_pd(_mm256_add_pd(_mm256_add_pd(e0, e1), e2));
+    lse = fast_log(acc) + a_max;
+
+    if (kind == SOFTMAX_WEIGHTS) {
+        v = _mm256_set1_pd(1.0 / acc);
+        _mm256_maskstore_pd(out, m0, _mm256_mul_pd(e0, v));
+        _mm256_maskstore_pd(out + 4, m1, _mm256_mul_pd(e1, v));
+        _mm256_maskstore_pd(out + 8, m2, _mm256_mul_pd(e2, v));
+    } else {
+        v = _mm256_set1_pd(lse);
+        _mm256_maskstore_pd(out, m0, _mm256_sub_pd(x0, v));
+        _mm256_maskstore_pd(out + 4, m1, _mm256_sub_pd(x1, v));
+        _mm256_maskstore_pd(out + 8, m2, _mm256_sub_pd(x2, v));
+    }
+    return lse;
+}
+
+#endif
+
+
+double faster_log_sum_exp_softmax_simd(range_t *ranges, int n, double *logps,
+        int kind, double *out, double *lse_out) {
+    double acc = 0.0, lse;
+    int i, w;
+    LSE_INSTRUMENT_START(t0);
+    for (i = 0; i < n; ++i) {
+        w = ranges[i].width;
+#ifdef LSEA_HAVE_SIMD
+        if (w >= 2 && w <= 12) {
+            lse = softmax_simd_12(&(logps[ranges[i].offset]), w, kind, out);
+        } else {
+            lse = faster_log_sum_exp_softmax_n(&(logps[ranges[i].offset]), w, kind, out);
+        }
+#else
+        lse = faster_log_sum_exp_softmax_n(&(logps[ranges[i].offset]), w, kind, out);
+#endif
+        out += w;
+        acc += lse;
+        if (lse_out != NULL) {
+            lse_out[i] = lse;
+        }
+    }
+    LSE_INSTRUMENT_LATENCY(LSE_INSTRUMENT_SITE_SOFTMAX_SIMD, t0);
+    return acc;
+}
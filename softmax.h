@@ -0,0 +1,30 @@
+#ifndef _LSEA_SOFTMAX
+#define _LSEA_SOFTMAX 1
+
+// fused range log-sum-exp and softmax.
+//
+// besides returning the summed log-sum-exp, these kernels write one output
+// per element of each range, reusing the max and exps of the forward pass:
+//
+//     SOFTMAX_WEIGHTS      out[k] = exp(a[k] - lse)   (gradient of lse wrt a[k])
+//     SOFTMAX_LOG_PROBS    out[k] = a[k] - lse        (normalised log-probabilities)
+//
+// outputs for range i start at the sum of the widths of ranges 0 .. i-1.
+// if lse_out is not NULL, lse_out[i] receives the log-sum-exp of range i.
+
+#include "types.h"
+
+
+#define SOFTMAX_WEIGHTS 1
+#define SOFTMAX_LOG_PROBS 2
+
+
+// pre-req: buckets from sort_ranges_bucketed for these ranges
+double faster_log_sum_exp_softmax_bb(range_t *ranges, const range_buckets_t *buckets, double *logps,
+    int kind, double *out, double *lse_out);
+
+// one range at a time, vectorised within the range
+double faster_log_sum_exp_softmax_simd(range_t *ranges, int n, double *logps,
+    int kind, double *out, double *lse_out);
+
+#endif
@@ -1,5 +1,8 @@
 #ifndef _LSEA_TYPES
 #define _LSEA_TYPES 1
+
+#include <stddef.h>
+
 typedef struct {
     int offset;
     int width;
@@ -10,10 +13,130 @@ typedef struct {
 typedef double (*reduction_func_t)(double *, range_t *, int);
 
 
+// double *data, double *out -> double result
+// fused reductions also write per-element outputs for each range to out.
+typedef double (*fused_reduction_func_t)(double *, double *);
+
+
+// double *data, double *out
+// multi-vector reductions read 4 interleaved data vectors, element i of
+// vector v at data[i * k + v] for a k fixed at jit time, and write their
+// 4 totals to out.
+typedef void (*multi_reduction_func_t)(double *, double *);
+
+
 typedef struct {
     reduction_func_t f;
     void *m;
     size_t size;
 } jit_reduction_func_t;
 
+
+// widest range handled by the width-specialised bb kernels
+#define MAX_BB_WIDTH 10
+
+
+// boundaries of the width buckets of a sorted range pattern.
+// ranges of width w <= MAX_BB_WIDTH occupy [start[w], start[w+1]).
+// any wider ranges occupy [start[MAX_BB_WIDTH+1], start[MAX_BB_WIDTH+2]).
+typedef struct {
+    int start[MAX_BB_WIDTH + 3];
+} range_buckets_t;
+
+
+// a range pattern tiled by offset, for data larger than the caches.
+// ranges are ordered by tile (offset >> shift), then width, then offset,
+// and the ranges of tile t occupy the width buckets tiles->buckets[t].
+// every width of one tile is evaluated before moving to the next tile.
+typedef struct {
+    int shift;                  // tiles are 1 << shift elements
+    int n_tiles;
+    range_buckets_t *buckets;   // n_tiles entries, indices into the whole pattern
+} range_tiles_t;
+
+
+// compact encoding of a sorted range pattern.
+// ranges are grouped by width, so the width is implied by the bucket.
+// within each bucket, offsets are stored as varint-coded deltas from
+// the previous offset in that bucket (the first from offset 0).
+typedef struct {
+    int count[MAX_BB_WIDTH + 1];    // count[w] = number of ranges of width w
+    unsigned char *deltas;          // concatenated delta streams, bucket 1 first
+    size_t size;                    // bytes used by deltas
+} compact_ranges_t;
+
+
+// a range pattern compiled to bytecode for a threaded interpreter. each
+// range is an opcode byte then the zigzag varint delta of its offset from
+// the previous range's offset. the opcode is the width for widths 1 to
+// MAX_BB_WIDTH; any other width is BYTECODE_OP_WIDE followed by a varint
+// width. BYTECODE_OP_HALT ends the program.
+#define BYTECODE_OP_HALT 0
+#define BYTECODE_OP_WIDE (MAX_BB_WIDTH + 1)
+
+typedef struct {
+    unsigned char *code;
+    size_t size;        // bytes used by code, including the halt
+} bytecode_t;
+
+
+// result of the sampling estimator faster_log_sum_exp_bb_sample
+typedef struct {
+    double estimate;    // of the total faster_log_sum_exp_bb_buckets returns
+    double half_width;  // the total lies in estimate +- half_width at the requested confidence
+    int n_sampled;      // ranges evaluated
+    int n_ranges;       // ranges of width 1 to MAX_BB_WIDTH
+} sample_estimate_t;
+
+
+// maxima of the data over aligned blocks of 1 << BLOCK_MAX_SHIFT elements.
+// a range of width <= MAX_BB_WIDTH meets at most two blocks.
+#define BLOCK_MAX_SHIFT 4
+
+typedef struct {
+    int n_blocks;
+    double *max;    // max[k] = max of data[k << BLOCK_MAX_SHIFT ...] over one block
+} block_maxima_t;
+
+
+// exp-domain copy of the data, scaled per block: data[i] is represented as
+// log(e[i]) + bm.max[i >> BLOCK_MAX_SHIFT].
+typedef struct {
+    block_maxima_t bm;
+    double *e;
+} exp_cache_t;
+
+
+
+// the values of a sorted range pattern copied out of logps into a padded,
+// transposed layout, so kernels read them with aligned vector loads and no
+// gathers. the ranges of width w are packed in groups of SOA_LANES: element
+// k of the j-th range of group g is values[start[w] + (g * w + k) *
+// SOA_LANES + j]. the lanes past the last range of a bucket hold -inf.
+#define SOA_LANES 8
+
+typedef struct {
+    int count[MAX_BB_WIDTH + 1];        // count[w] = number of ranges of width w
+    size_t start[MAX_BB_WIDTH + 1];    // first value of bucket w
+    size_t size;                        // doubles in values
+    double *values;                     // 32-byte aligned
+} soa_logps_t;
+
+
+// logps quantised to fixed point with one scale per aligned block of
+// 1 << BLOCK_MAX_SHIFT elements: element i stands for codes[i] * scale[i >>
+// BLOCK_MAX_SHIFT]. codes lie in [-QUANT_MAX_CODE(bits), 0]; the one code
+// below that range, QUANT_NINF_CODE(bits), stands for -inf. a larger code
+// is a larger value within a block, so max can run on the codes.
+#define QUANT_MAX_CODE(bits) ((1 << ((bits) - 1)) - 1)
+#define QUANT_NINF_CODE(bits) (-(1 << ((bits) - 1)))
+
+typedef struct {
+    int bits;       // 8 or 16
+    int m;
+    int n_blocks;
+    void *codes;    // m int8_t or int16_t codes
+    double *scale;
+} quant_logps_t;
+
 #endif